@@ -56,6 +56,14 @@
 #define MAX_DEPTH 31
 
 #define MAX_REFERENCE 32
+// a per-thread ref map larger than this (about 96k) is released after packing
+#define MAX_REFMAP_KEEP (1 << 12)
+
+#if defined(_MSC_VER)
+#	define SERI_THREAD_LOCAL __declspec(thread)
+#else
+#	define SERI_THREAD_LOCAL __thread
+#endif
 
 struct block {
 	struct block * next;
@@ -74,6 +82,25 @@ struct reference {
 	uint8_t * address;
 };
 
+// open addressing { object -> id, address }, a slot is live when its gen
+// equals the map's gen, so reusing the map does not need to clear it.
+struct refslot {
+	const void * object;
+	uint8_t * address;
+	int id;
+	unsigned gen;
+};
+
+struct refmap {
+	struct refslot * slot;
+	int cap;
+	int count;
+	unsigned gen;
+	int busy;
+};
+
+static SERI_THREAD_LOCAL struct refmap g_refmap;
+
 struct write_block {
 	struct block * head;
 	struct block * current;
@@ -81,6 +108,8 @@ struct write_block {
 	int ptr;
 	struct stack s;
 	struct reference r[MAX_REFERENCE];
+	struct refmap * refs;
+	struct refmap local;
 };
 
 struct read_block {
@@ -143,11 +172,16 @@ wb_init(struct write_block *wb , struct block *b) {
 	wb->current = wb->head;
 	wb->ptr = 0;
 	init_stack(&wb->s);
+	wb->refs = NULL;
+	memset(&wb->local, 0, sizeof(wb->local));
 }
 
 static void
 wb_free(struct write_block *wb) {
 	struct block *blk = wb->head;
+	if (blk == NULL) {
+		return;
+	}
 	blk = blk->next;	// the first block is on stack
 	while (blk) {
 		struct block * next = blk->next;
@@ -332,6 +366,105 @@ wb_table_metapairs(lua_State *L, struct write_block *wb, int index) {
 	wb_nil(wb);
 }
 
+static inline uint32_t
+refmap_hash(const void *obj) {
+	return (uint32_t)((((uint64_t)(uintptr_t)obj >> 3) * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+}
+
+static void
+refmap_grow(lua_State *L, struct refmap *m) {
+	int cap = m->cap ? m->cap * 2 : 256;
+	struct refslot *slot = calloc(cap, sizeof(struct refslot));
+	if (slot == NULL) {
+		luaL_error(L, "Out of memory for table refs");
+	}
+	unsigned mask = cap - 1;
+	int i;
+	for (i=0;i<m->cap;i++) {
+		struct refslot *old = &m->slot[i];
+		if (old->gen == m->gen) {
+			unsigned h = refmap_hash(old->object) & mask;
+			while (slot[h].gen == m->gen) {
+				h = (h + 1) & mask;
+			}
+			slot[h] = *old;
+		}
+	}
+	free(m->slot);
+	m->slot = slot;
+	m->cap = cap;
+}
+
+static struct refmap *
+refmap_acquire(void) {
+	struct refmap *m = &g_refmap;
+	if (m->busy) {
+		return NULL;
+	}
+	m->busy = 1;
+	return m;
+}
+
+static void
+refmap_reset(struct refmap *m) {
+	m->count = 0;
+	if (++m->gen == 0) {
+		if (m->slot) {
+			memset(m->slot, 0, m->cap * sizeof(struct refslot));
+		}
+		m->gen = 1;
+	}
+}
+
+static void
+refmap_release(struct write_block *b) {
+	struct refmap *m = b->refs;
+	if (m == NULL) {
+		return;
+	}
+	b->refs = NULL;
+	if (m == &g_refmap) {
+		m->busy = 0;
+		if (m->cap <= MAX_REFMAP_KEEP) {
+			return;
+		}
+	}
+	free(m->slot);
+	m->slot = NULL;
+	m->cap = 0;
+}
+
+static void
+refmap_insert(lua_State *L, struct refmap *m, const void *obj, int id, uint8_t *addr) {
+	if ((m->count + 1) * 2 > m->cap) {
+		refmap_grow(L, m);
+	}
+	unsigned mask = m->cap - 1;
+	unsigned h = refmap_hash(obj) & mask;
+	while (m->slot[h].gen == m->gen) {
+		h = (h + 1) & mask;
+	}
+	struct refslot *slot = &m->slot[h];
+	slot->object = obj;
+	slot->address = addr;
+	slot->id = id;
+	slot->gen = m->gen;
+	m->count++;
+}
+
+static struct refslot *
+refmap_find(struct refmap *m, const void *obj) {
+	unsigned mask = m->cap - 1;
+	unsigned h = refmap_hash(obj) & mask;
+	while (m->slot[h].gen == m->gen) {
+		if (m->slot[h].object == obj) {
+			return &m->slot[h];
+		}
+		h = (h + 1) & mask;
+	}
+	return NULL;
+}
+
 static inline void
 mark_table(lua_State *L, struct write_block *b, int index) {
 	const void * obj = lua_topointer(L, index);
@@ -339,29 +472,23 @@ mark_table(lua_State *L, struct write_block *b, int index) {
 	int id = s->objectid++;
 	void *addr = wb_address(b);
 	if (id == MAX_REFERENCE) {
-		lua_createtable(L, 0, MAX_REFERENCE+1);
-		lua_replace(L, s->ref_index);
-		lua_createtable(L, MAX_REFERENCE+1, 0);
-		lua_replace(L, s->ref_index+1);
+		struct refmap *m = refmap_acquire();
+		if (m == NULL) {
+			// nested pack (from a __pairs metamethod) while the thread's map is in use
+			m = &b->local;
+		}
+		b->refs = m;
+		refmap_reset(m);
 		int i;
 		for (i=0;i<MAX_REFERENCE;i++) {
-			lua_pushinteger(L, i+1);
-			lua_rawsetp(L, s->ref_index, b->r[i].object);
-			if (b->r[i].address) {
-				lua_pushlightuserdata(L, (void *)b->r[i].address);
-				lua_rawseti(L, s->ref_index+1, i+1);
-			}
+			refmap_insert(L, m, b->r[i].object, i+1, b->r[i].address);
 		}
 	}
 	if (id < MAX_REFERENCE) {
 		b->r[id].object = obj;
 		b->r[id].address = addr;
 	} else {
-		++id;
-		lua_pushinteger(L, id);
-		lua_rawsetp(L, s->ref_index, obj);
-		lua_pushlightuserdata(L, addr);
-		lua_rawseti(L, s->ref_index + 1, id);
+		refmap_insert(L, b->refs, obj, id+1, addr);
 	}
 }
 
@@ -406,7 +533,7 @@ change_mark(uint8_t *tag) {
 }
 
 static inline int
-lookup_ref(lua_State *L, struct write_block *b, const void *obj) {
+lookup_ref(struct write_block *b, const void *obj) {
 	if (b->s.objectid <= MAX_REFERENCE) {
 		int i;
 		for (i=0;i<b->s.objectid;i++) {
@@ -420,29 +547,22 @@ lookup_ref(lua_State *L, struct write_block *b, const void *obj) {
 		}
 		return 0;
 	} else {
-		if (lua_rawgetp(L, b->s.ref_index, obj) != LUA_TNUMBER) {
-			lua_pop(L, 1);
+		struct refslot *slot = refmap_find(b->refs, obj);
+		if (slot == NULL) {
 			return 0;
 		}
-		int id = lua_tointeger(L, -1);
-		lua_pop(L, 1);
-		if (lua_rawgeti(L, b->s.ref_index + 1, id) == LUA_TLIGHTUSERDATA) {
-			uint8_t * tag = (uint8_t *)lua_touserdata(L, -1);
-			lua_pop(L, 1);
-			change_mark(tag);
-			lua_pushnil(L);
-			lua_rawseti(L, b->s.ref_index + 1, id);
-		} else {
-			lua_pop(L, 1);
+		if (slot->address) {
+			change_mark(slot->address);
+			slot->address = NULL;
 		}
-		return id;
+		return slot->id;
 	}
 }
 
 static int
 ref_object(lua_State *L, struct write_block *b, int index) {
 	const void * obj = lua_topointer(L, index);
-	int id = lookup_ref(L, b, obj);
+	int id = lookup_ref(b, obj);
 	if (id > 0) {
 		uint8_t n = COMBINE_TYPE(TYPE_REF, EXTEND_NUMBER);
 		wb_push(b, &n, 1);
@@ -486,6 +606,7 @@ pack_one(lua_State *L, struct write_block *b, int index) {
 	case LUA_TFUNCTION: {
 		lua_CFunction func = lua_tocfunction(L,index);
 		if (func == NULL || lua_getupvalue(L, index, 1) != NULL) {
+			wb_free(b);
 			luaL_error(L, "Only light C function can be serialized");
 		}
 		wb_pointer(b, (void *)func, TYPE_USERDATA_CFUNCTION);
@@ -511,17 +632,15 @@ pack_one(lua_State *L, struct write_block *b, int index) {
 	}
 }
 
-static void
-pack_from(lua_State *L, struct write_block *b, int from) {
-	int top = lua_gettop(L);
-	int n = top - from;
+static int
+pack_from(lua_State *L) {
+	struct write_block *b = lua_touserdata(L, 1);
+	int n = lua_gettop(L);
 	int i;
-	lua_pushnil(L);	// slot for table ref lookup { pointer -> id }
-	lua_pushnil(L);	// slot for table refs array { address, ... }
-	b->s.ref_index = top + 1;
-	for (i=1;i<=n;i++) {
-		pack_one(L, b , from + i);
+	for (i=2;i<=n;i++) {
+		pack_one(L, b, i);
 	}
+	return 0;
 }
 
 static inline void
@@ -846,7 +965,34 @@ seri_pack(lua_State *L, int from, int *sz) {
 	struct write_block wb;
 	wb_init(&wb, &temp);
 
-	pack_from(L,&wb,from);
+	int n = lua_gettop(L) - from;
+	int i;
+	for (i=1;i<=n;i++) {
+		if (lua_type(L, from + i) == LUA_TTABLE)
+			break;
+	}
+	if (i > n) {
+		// no table, so no ref map and the only errors free the blocks themselves
+		for (i=1;i<=n;i++) {
+			pack_one(L, &wb, from + i);
+		}
+		goto _packed;
+	}
+
+	// pack in a protected call, so the blocks and the ref map are released on error
+	luaL_checkstack(L, n + 2, NULL);
+	lua_pushcfunction(L, pack_from);
+	lua_pushlightuserdata(L, &wb);
+	for (i=1;i<=n;i++) {
+		lua_pushvalue(L, from + i);
+	}
+	int err = lua_pcall(L, n + 1, 0, 0);
+	refmap_release(&wb);
+	if (err != LUA_OK) {
+		wb_free(&wb);
+		lua_error(L);
+	}
+_packed:
 	assert(wb.head == &temp);
 
 	void * buffer = seri(&temp, wb.len);
@@ -860,6 +1006,14 @@ seri_pack(lua_State *L, int from, int *sz) {
 	return buffer;
 }
 
+void
+seri_threadexit(void) {
+	struct refmap *m = &g_refmap;
+	free(m->slot);
+	m->slot = NULL;
+	m->cap = 0;
+}
+
 void *
 seri_packstring(const char * str, int sz) {
 	struct block temp;
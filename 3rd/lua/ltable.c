@@ -642,6 +642,29 @@ void luaH_free (lua_State *L, Table *t) {
 }
 
 
+/*
+** Remove all entries of a table but keep its array and hash parts, so it
+** can be refilled without allocating.
+*/
+void luaH_clear (Table *t) {
+  unsigned int asize = luaH_realasize(t);
+  unsigned int i;
+  for (i = 0; i < asize; i++)
+    setempty(&t->array[i]);
+  if (!isdummy(t)) {
+    unsigned int size = sizenode(t);
+    for (i = 0; i < size; i++) {
+      Node *n = gnode(t, i);
+      gnext(n) = 0;
+      setnilkey(n);
+      setempty(gval(n));
+    }
+    t->lastfree = gnode(t, size);  /* all positions are free */
+  }
+  invalidateTMcache(t);
+}
+
+
 static Node *getfreepos (Table *t) {
   if (!isdummy(t)) {
     while (t->lastfree > t->node) {
@@ -0,0 +1,202 @@
+#include <bee/filewatch/content_filter.h>
+#include <bee/nonstd/filesystem.h>
+#include <bee/utility/content_hash.h>
+#include <bee/thread/setname.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace bee::filewatch {
+    // Two seconds covers the coarsest common timestamp granularity (FAT).
+    static constexpr int64_t kRacyWindow = std::chrono::duration_cast<fs::file_time_type::duration>(std::chrono::seconds(2)).count();
+
+    static bool hash_file(const fs::path& path, uint64_t& result) noexcept {
+#if defined(_WIN32)
+        FILE* f = _wfopen(path.c_str(), L"rb");
+#else
+        FILE* f = fopen(path.c_str(), "rb");
+#endif
+        if (!f) {
+            return false;
+        }
+        static constexpr size_t kChunk = 64 * 1024;
+        std::vector<unsigned char> buf(kChunk);
+        uint64_t h = 0;
+        size_t n;
+        while ((n = fread(buf.data(), 1, kChunk, f)) > 0) {
+            h = content_hash(buf.data(), n, h);
+        }
+        bool ok = !ferror(f);
+        fclose(f);
+        result = h;
+        return ok;
+    }
+
+    content_filter::content_filter() noexcept = default;
+
+    content_filter::~content_filter() {
+        stop();
+    }
+
+    void content_filter::set_ready(std::function<void()> f) {
+        m_ready = std::move(f);
+    }
+
+    bool content_filter::start() noexcept {
+        if (!m_thread) {
+            // nothing was observed while stopped, so the cache may be stale
+            m_cache.clear();
+            m_quit   = false;
+            m_thread = thread_create(worker, this);
+        }
+        return m_thread != nullptr;
+    }
+
+    void content_filter::stop() noexcept {
+        if (!m_thread) {
+            return;
+        }
+        m_quit = true;
+        m_wakeup.release();
+        thread_wait(m_thread);
+        m_thread = nullptr;
+    }
+
+    // Stops the worker and passes the events it did not get to through
+    // unfiltered, so turning the filter off never loses an event.
+    void content_filter::flush() noexcept {
+        stop();
+        std::unique_lock<std::mutex> lk(m_mutex);
+        while (!m_input.empty()) {
+            m_output.emplace(std::move(m_input.front()));
+            m_input.pop();
+        }
+    }
+
+    bool content_filter::running() const noexcept {
+        return m_thread != nullptr;
+    }
+
+    void content_filter::push(notify&& n) {
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_input.emplace(std::move(n));
+        }
+        m_wakeup.release();
+    }
+
+    std::optional<notify> content_filter::select() {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        if (m_output.empty()) {
+            return std::nullopt;
+        }
+        auto n = std::move(m_output.front());
+        m_output.pop();
+        return n;
+    }
+
+    uint64_t content_filter::hashed() const noexcept {
+        return m_hashed.load(std::memory_order_relaxed);
+    }
+
+    uint64_t content_filter::suppressed() const noexcept {
+        return m_suppressed.load(std::memory_order_relaxed);
+    }
+
+    void content_filter::invalidate(const std::string& path) {
+        m_cache.erase(path);
+        const size_t len = path.size();
+        for (auto it = m_cache.begin(); it != m_cache.end();) {
+            const auto& key = it->first;
+            if (key.size() > len && key.compare(0, len, path) == 0 && (key[len] == '/' || key[len] == '\\')) {
+                it = m_cache.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    bool content_filter::changed(const std::string& path) {
+        std::error_code ec;
+        fs::path p     = fs::u8path(path);
+        auto status    = fs::status(p, ec);
+        if (ec || !fs::is_regular_file(status)) {
+            m_cache.erase(path);
+            return true;
+        }
+        uint64_t size = (uint64_t)fs::file_size(p, ec);
+        if (ec) {
+            return true;
+        }
+        int64_t mtime = (int64_t)fs::last_write_time(p, ec).time_since_epoch().count();
+        if (ec) {
+            return true;
+        }
+        // Size and mtime only prove the content unchanged for files last
+        // written well before they were hashed: a same-size rewrite within
+        // the file system's timestamp granularity keeps both.
+        const int64_t now = (int64_t)fs::file_time_type::clock::now().time_since_epoch().count();
+        auto it           = m_cache.find(path);
+        if (it != m_cache.end() && it->second.size == size && it->second.mtime == mtime && mtime < it->second.filled - kRacyWindow) {
+            return false;
+        }
+        uint64_t h;
+        if (!hash_file(p, h)) {
+            m_cache.erase(path);
+            return true;
+        }
+        m_hashed.fetch_add(1, std::memory_order_relaxed);
+        if (it == m_cache.end()) {
+            m_cache.emplace(path, entry { size, mtime, h, now });
+            return true;
+        }
+        bool same         = it->second.size == size && it->second.hash == h;
+        it->second.size   = size;
+        it->second.mtime  = mtime;
+        it->second.hash   = h;
+        it->second.filled = now;
+        return !same;
+    }
+
+    void content_filter::worker(void* ud) noexcept {
+        auto& self = *static_cast<content_filter*>(ud);
+        thread_setname("bee.filewatch.hash");
+        while (!self.m_quit) {
+            std::optional<notify> n;
+            {
+                std::unique_lock<std::mutex> lk(self.m_mutex);
+                if (!self.m_input.empty()) {
+                    n.emplace(std::move(self.m_input.front()));
+                    self.m_input.pop();
+                }
+            }
+            if (!n) {
+                self.m_wakeup.acquire();
+                continue;
+            }
+            bool pass = true;
+            if (n->flags == notify::flag::overflow) {
+                self.m_cache.clear();
+            }
+            else if (n->flags == notify::flag::rename) {
+                self.invalidate(n->path);
+            }
+            else {
+                pass = self.changed(n->path);
+            }
+            if (!pass) {
+                self.m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            {
+                std::unique_lock<std::mutex> lk(self.m_mutex);
+                self.m_output.emplace(std::move(*n));
+            }
+            if (self.m_ready) {
+                self.m_ready();
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <bee/filewatch/filewatch.h>
+#include <bee/nonstd/semaphore.h>
+#include <bee/thread/simplethread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+
+namespace bee::filewatch {
+    // Drops modify events for regular files whose content did not change. Events
+    // are queued to a worker thread that keeps size, mtime and a content hash per
+    // file; rename events pass through and invalidate the cache. Order is kept.
+    class content_filter {
+    public:
+        content_filter() noexcept;
+        ~content_filter();
+        // Called on the worker thread whenever select() has a new event.
+        // Set it before start().
+        void set_ready(std::function<void()> f);
+        bool start() noexcept;
+        void stop() noexcept;
+        void flush() noexcept;
+        bool running() const noexcept;
+        void push(notify&& n);
+        std::optional<notify> select();
+        uint64_t hashed() const noexcept;
+        uint64_t suppressed() const noexcept;
+
+    private:
+        struct entry {
+            uint64_t size;
+            int64_t mtime;
+            uint64_t hash;
+            int64_t filled;
+        };
+        static void worker(void* ud) noexcept;
+        bool changed(const std::string& path);
+        void invalidate(const std::string& path);
+
+    private:
+        std::mutex m_mutex;
+        std::queue<notify> m_input;
+        std::queue<notify> m_output;
+        std::binary_semaphore m_wakeup { 0 };
+        std::atomic<bool> m_quit { false };
+        thread_handle m_thread = nullptr;
+        std::function<void()> m_ready;
+        std::unordered_map<std::string, entry> m_cache;
+        std::atomic<uint64_t> m_hashed { 0 };
+        std::atomic<uint64_t> m_suppressed { 0 };
+    };
+}
@@ -8,9 +8,11 @@
 
 #if defined(_WIN32)
 #    include <list>
+#    include <vector>
 #elif defined(__APPLE__)
 #    include <CoreServices/CoreServices.h>
 
+#    include <condition_variable>
 #    include <set>
 #elif defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
 #    include <map>
@@ -27,6 +29,7 @@ namespace bee::filewatch {
         enum class flag {
             modify,
             rename,
+            overflow,
         };
         flag flags;
         std::string path;
@@ -56,6 +59,11 @@ namespace bee::filewatch {
         bool set_filter(filter f = DefaultFilter);
         void update();
         std::optional<notify> select();
+        // Blocks until update() may find new events, wakeup() is called or
+        // timeout milliseconds pass; a negative timeout does not expire.
+        // Call wakeup() after add() so a waiting thread sees the new paths.
+        void wait(int timeout) noexcept;
+        void wakeup() noexcept;
 
     private:
 #if defined(_WIN32)
@@ -78,14 +86,19 @@ namespace bee::filewatch {
         bool m_recursive = true;
 #if defined(_WIN32)
         std::list<task> m_tasks;
+        std::vector<void*> m_handles;
+        void* m_wakeup;
 #elif defined(__APPLE__)
         std::mutex m_mutex;
+        std::condition_variable m_cond;
+        bool m_woken = false;
         std::set<std::string> m_paths;
         FSEventStreamRef m_stream;
         dispatch_queue_t m_fsevent_queue;
 #elif defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
         std::map<int, std::string> m_fd_path;
         int m_inotify_fd;
+        int m_wakeup[2];
         bool m_follow_symlinks = false;
         filter m_filter        = DefaultFilter;
 #endif
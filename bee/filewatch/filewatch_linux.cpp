@@ -2,6 +2,7 @@
 #include <bee/filewatch/filewatch.h>
 #include <bee/nonstd/filesystem.h>
 #include <bee/nonstd/unreachable.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <sys/inotify.h>
 #include <unistd.h>
@@ -18,12 +19,20 @@ namespace bee::filewatch {
     watch::watch() noexcept
         : m_notify()
         , m_fd_path()
-        , m_inotify_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+        , m_inotify_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+        , m_wakeup { -1, -1 } {
         assert(m_inotify_fd != -1);
+        if (pipe2(m_wakeup, O_NONBLOCK | O_CLOEXEC) != 0) {
+            m_wakeup[0] = m_wakeup[1] = -1;
+        }
     }
 
     watch::~watch() {
         stop();
+        if (m_wakeup[0] != -1) {
+            close(m_wakeup[0]);
+            close(m_wakeup[1]);
+        }
     }
 
     void watch::stop() noexcept {
@@ -116,7 +125,8 @@ namespace bee::filewatch {
     void watch::event_update(void* e) {
         inotify_event* event = (inotify_event*)e;
         if (event->mask & IN_Q_OVERFLOW) {
-            // TODO?
+            m_notify.emplace(notify::flag::overflow, std::string());
+            return;
         }
 
         auto filename = m_fd_path[event->wd];
@@ -151,4 +161,30 @@ namespace bee::filewatch {
         m_notify.pop();
         return n;
     }
+
+    void watch::wait(int timeout) noexcept {
+        struct pollfd fds[2];
+        nfds_t n = 0;
+        if (m_inotify_fd != -1) {
+            fds[n++] = { m_inotify_fd, POLLIN, 0 };
+        }
+        if (m_wakeup[0] != -1) {
+            fds[n++] = { m_wakeup[0], POLLIN, 0 };
+        }
+        if (n == 0 || poll(fds, n, timeout) <= 0) {
+            return;
+        }
+        if (m_wakeup[0] != -1 && (fds[n - 1].revents & POLLIN)) {
+            char buf[64];
+            while (read(m_wakeup[0], buf, sizeof buf) > 0) {
+            }
+        }
+    }
+
+    void watch::wakeup() noexcept {
+        if (m_wakeup[1] != -1) {
+            char c = 0;
+            (void)!write(m_wakeup[1], &c, 1);
+        }
+    }
 }
@@ -1,6 +1,8 @@
 #include <bee/filewatch/filewatch.h>
 #include <bee/nonstd/unreachable.h>
 
+#include <chrono>
+
 namespace bee::filewatch {
     const char* watch::type() noexcept {
         return "fsevent";
@@ -116,13 +118,17 @@ namespace bee::filewatch {
             if (!m_recursive && path[0] != '\0' && strchr(path + 1, '/') != NULL) {
                 continue;
             }
-            if (flags[i] & (kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemRemoved | kFSEventStreamEventFlagItemRenamed)) {
+            if (flags[i] & (kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagUserDropped | kFSEventStreamEventFlagKernelDropped)) {
+                m_notify.emplace(notify::flag::overflow, path);
+            }
+            else if (flags[i] & (kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemRemoved | kFSEventStreamEventFlagItemRenamed)) {
                 m_notify.emplace(notify::flag::rename, path);
             }
             else if (flags[i] & (kFSEventStreamEventFlagItemFinderInfoMod | kFSEventStreamEventFlagItemModified | kFSEventStreamEventFlagItemInodeMetaMod | kFSEventStreamEventFlagItemChangeOwner | kFSEventStreamEventFlagItemXattrMod)) {
                 m_notify.emplace(notify::flag::modify, path);
             }
         }
+        m_cond.notify_all();
     }
 
     std::optional<notify> watch::select() {
@@ -134,4 +140,24 @@ namespace bee::filewatch {
         m_notify.pop();
         return n;
     }
+
+    void watch::wait(int timeout) noexcept {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto ready = [this] { return !m_notify.empty() || m_woken; };
+        if (timeout < 0) {
+            m_cond.wait(lock, ready);
+        }
+        else {
+            m_cond.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+        }
+        m_woken = false;
+    }
+
+    void watch::wakeup() noexcept {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_woken = true;
+        }
+        m_cond.notify_all();
+    }
 }
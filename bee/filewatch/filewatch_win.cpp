@@ -107,7 +107,6 @@ namespace bee::filewatch {
         }
         if (dwErrorCode != 0) {
             if (dwErrorCode == ERROR_NOTIFY_ENUM_DIR) {
-                // TODO notify overflow
                 return result::zero;
             }
             cancel();
@@ -131,10 +130,14 @@ namespace bee::filewatch {
 
     watch::watch() noexcept
         : m_notify()
-        , m_tasks() {}
+        , m_tasks()
+        , m_wakeup(CreateEventW(NULL, FALSE, FALSE, NULL)) {}
 
     watch::~watch() {
         stop();
+        if (m_wakeup) {
+            CloseHandle(m_wakeup);
+        }
     }
 
     void watch::stop() noexcept {
@@ -177,6 +180,8 @@ namespace bee::filewatch {
             task.cancel();
             return false;
         case task::result::zero:
+            // The kernel buffer overflowed and its contents were discarded.
+            m_notify.emplace(notify::flag::overflow, win::w2u(task.path()));
             return task.start(m_recursive);
         case task::result::success:
             break;
@@ -217,6 +222,12 @@ namespace bee::filewatch {
                 iter = m_tasks.erase(iter);
             }
         }
+        // wait() runs without the caller's lock, so it waits on this
+        // snapshot rather than on m_tasks
+        m_handles.clear();
+        for (auto& task : m_tasks) {
+            m_handles.push_back(task.hEvent);
+        }
     }
 
     std::optional<notify> watch::select() {
@@ -227,4 +238,32 @@ namespace bee::filewatch {
         m_notify.pop();
         return n;
     }
+
+    void watch::wait(int timeout) noexcept {
+        HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+        DWORD n = 0;
+        if (m_wakeup) {
+            handles[n++] = m_wakeup;
+        }
+        for (HANDLE h : m_handles) {
+            if (n == MAXIMUM_WAIT_OBJECTS) {
+                // the remaining directories are checked every 10ms
+                if (timeout < 0 || timeout > 10) {
+                    timeout = 10;
+                }
+                break;
+            }
+            handles[n++] = h;
+        }
+        if (n == 0) {
+            return;
+        }
+        WaitForMultipleObjects(n, handles, FALSE, timeout < 0 ? INFINITE : (DWORD)timeout);
+    }
+
+    void watch::wakeup() noexcept {
+        if (m_wakeup) {
+            SetEvent(m_wakeup);
+        }
+    }
 }
@@ -0,0 +1,450 @@
+#include <bee/log/sink.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+
+#if defined(_WIN32)
+#    include <Windows.h>
+#else
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <limits.h>
+#    include <sys/stat.h>
+#    include <sys/uio.h>
+#    include <unistd.h>
+#endif
+
+namespace bee::log {
+    // Single producer (the owning thread), single consumer (the writer).
+    // head and tail only grow; the buffer holds whole lines, so whatever lies
+    // between them can be written out as is.
+    struct producer {
+        explicit producer(size_t cap)
+            : buf(new char[cap])
+            , cap(cap) {}
+        std::unique_ptr<char[]> buf;
+        size_t cap;
+        alignas(64) std::atomic<size_t> head { 0 };
+        std::atomic<uint64_t> lines { 0 };
+        std::atomic<uint64_t> dropped { 0 };
+        std::atomic<bool> orphaned { false };
+        alignas(64) std::atomic<size_t> tail { 0 };
+    };
+
+    struct local_producers {
+        std::vector<std::pair<const sink*, producer*>> list;
+        ~local_producers() {
+            for (auto& [_, p] : list) {
+                p->orphaned.store(true, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local local_producers t_producers;
+
+    struct registry {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<sink>, std::less<>> sinks;
+        // closed sinks replaced by a new open, loggers may still point to them
+        std::vector<std::unique_ptr<sink>> retired;
+    };
+    static registry& get_registry() {
+        static registry r;
+        return r;
+    }
+
+    static size_t round_capacity(size_t n) noexcept {
+        size_t cap = 4096;
+        while (cap < n && cap < ((size_t)1 << 30)) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+#if defined(_WIN32)
+    static file_handle open_file(const fs::path& path, bool append, uint64_t& size, std::error_code& ec) noexcept {
+        HANDLE h = ::CreateFileW(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE) {
+            ec = std::error_code(::GetLastError(), std::system_category());
+            return {};
+        }
+        LARGE_INTEGER li;
+        size = ::GetFileSizeEx(h, &li) ? (uint64_t)li.QuadPart : 0;
+        return { h };
+    }
+
+    struct span {
+        const char* data;
+        size_t len;
+    };
+
+    static bool write_spans(file_handle fd, std::vector<span>& spans) noexcept {
+        for (auto& s : spans) {
+            while (s.len > 0) {
+                DWORD n = 0;
+                if (!::WriteFile(fd.value(), s.data, (DWORD)(std::min)(s.len, (size_t)1 << 30), &n, NULL)) {
+                    return false;
+                }
+                s.data += n;
+                s.len -= n;
+            }
+        }
+        return true;
+    }
+
+    static void sync_file(file_handle fd) noexcept {
+        ::FlushFileBuffers(fd.value());
+    }
+
+    static void close_file(file_handle& fd) noexcept {
+        if (fd) {
+            ::CloseHandle(fd.value());
+            fd = {};
+        }
+    }
+#else
+    static file_handle open_file(const fs::path& path, bool append, uint64_t& size, std::error_code& ec) noexcept {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+        if (fd == -1) {
+            ec = std::error_code(errno, std::system_category());
+            return {};
+        }
+        struct stat st;
+        size = ::fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+        return { fd };
+    }
+
+    using span = struct iovec;
+
+    // writev, continuing after short writes and in IOV_MAX sized pieces.
+    static bool write_spans(file_handle fd, std::vector<span>& spans) noexcept {
+        size_t i = 0;
+        while (i < spans.size()) {
+            int cnt   = (int)(std::min)(spans.size() - i, (size_t)IOV_MAX);
+            ssize_t n = ::writev(fd.value(), &spans[i], cnt);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            while (n > 0 && i < spans.size()) {
+                if ((size_t)n >= spans[i].iov_len) {
+                    n -= (ssize_t)spans[i].iov_len;
+                    i++;
+                }
+                else {
+                    spans[i].iov_base = (char*)spans[i].iov_base + n;
+                    spans[i].iov_len -= (size_t)n;
+                    n = 0;
+                }
+            }
+            while (i < spans.size() && spans[i].iov_len == 0) {
+                i++;
+            }
+        }
+        return true;
+    }
+
+    static void sync_file(file_handle fd) noexcept {
+#    if defined(__APPLE__)
+        ::fcntl(fd.value(), F_FULLFSYNC);
+#    else
+        ::fdatasync(fd.value());
+#    endif
+    }
+
+    static void close_file(file_handle& fd) noexcept {
+        if (fd) {
+            ::close(fd.value());
+            fd = {};
+        }
+    }
+#endif
+
+    static fs::path backup_path(const fs::path& path, int n) {
+        fs::path r = path;
+        r += "." + std::to_string(n);
+        return r;
+    }
+
+    sink* sink::open(std::string_view name, options&& opts, std::error_code& ec) {
+        auto& r = get_registry();
+        std::unique_lock<std::mutex> lk(r.mutex);
+        auto it = r.sinks.find(name);
+        if (it != r.sinks.end() && !it->second->closed()) {
+            ec = std::make_error_code(std::errc::file_exists);
+            return nullptr;
+        }
+        uint64_t size  = 0;
+        file_handle fd = open_file(opts.path, true, size, ec);
+        if (!fd) {
+            return nullptr;
+        }
+        opts.buffer_size = round_capacity(opts.buffer_size);
+        auto s           = std::make_unique<sink>(std::move(opts), fd, size);
+        sink* ptr        = s.get();
+        if (it != r.sinks.end()) {
+            // wait for the old writer, so its last lines land before the new ones
+            it->second->close();
+            r.retired.emplace_back(std::move(it->second));
+            it->second = std::move(s);
+        }
+        else {
+            r.sinks.emplace(std::string { name }, std::move(s));
+        }
+        return ptr;
+    }
+
+    sink* sink::find(std::string_view name) noexcept {
+        auto& r = get_registry();
+        std::unique_lock<std::mutex> lk(r.mutex);
+        auto it = r.sinks.find(name);
+        if (it == r.sinks.end() || it->second->closed()) {
+            return nullptr;
+        }
+        return it->second.get();
+    }
+
+    sink::sink(options&& opts, file_handle fd, uint64_t size) noexcept
+        : opts_(std::move(opts))
+        , fd_(fd)
+        , size_(size)
+        , opened_(std::chrono::steady_clock::now())
+        , synced_(opened_)
+        , thread_(&sink::run, this) {}
+
+    sink::~sink() noexcept {
+        close();
+        // threads that are still alive keep pointers to their buffers
+        for (auto& p : producers_) {
+            if (!p->orphaned.load(std::memory_order_acquire)) {
+                (void)p.release();
+            }
+        }
+    }
+
+    producer* sink::local() {
+        for (auto& [s, p] : t_producers.list) {
+            if (s == this) {
+                return p;
+            }
+        }
+        auto p = std::make_unique<producer>(opts_.buffer_size);
+        t_producers.list.reserve(t_producers.list.size() + 1);
+        std::unique_lock<std::mutex> lk(mutex_);
+        producers_.reserve(producers_.size() + 1);
+        t_producers.list.emplace_back(this, p.get());
+        producers_.emplace_back(std::move(p));
+        return producers_.back().get();
+    }
+
+    void sink::wakeup() noexcept {
+        if (!wake_pending_.exchange(true, std::memory_order_acq_rel)) {
+            wake_.release();
+        }
+    }
+
+    bool sink::write(const char* data, size_t len) noexcept {
+        if (closed_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        producer* p;
+        try {
+            p = local();
+        } catch (...) {
+            return false;
+        }
+        // the counters are only written by this thread, so no locked add is needed
+        const size_t head = p->head.load(std::memory_order_relaxed);
+        const size_t tail = p->tail.load(std::memory_order_acquire);
+        if (len > p->cap - (head - tail)) {
+            p->dropped.store(p->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            wakeup();
+            return false;
+        }
+        const size_t off   = head & (p->cap - 1);
+        const size_t first = (std::min)(len, p->cap - off);
+        memcpy(p->buf.get() + off, data, first);
+        memcpy(p->buf.get(), data + first, len - first);
+        p->head.store(head + len, std::memory_order_release);
+        p->lines.store(p->lines.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (head + len - tail > p->cap / 2) {
+            wakeup();
+        }
+        return true;
+    }
+
+    void sink::rotate() noexcept {
+        if (opts_.fsync != fsync_mode::none) {
+            sync_file(fd_);
+        }
+        close_file(fd_);
+        std::error_code ec;
+        if (opts_.rotate_files > 0) {
+            for (int i = opts_.rotate_files - 1; i >= 1; --i) {
+                fs::rename(backup_path(opts_.path, i), backup_path(opts_.path, i + 1), ec);
+            }
+            fs::rename(opts_.path, backup_path(opts_.path, 1), ec);
+        }
+        uint64_t size;
+        fd_     = open_file(opts_.path, false, size, ec);
+        size_   = 0;
+        opened_ = std::chrono::steady_clock::now();
+        rotations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool sink::drain() noexcept {
+        struct pending {
+            producer* p;
+            size_t head;
+            bool orphaned;
+        };
+        std::vector<pending> list;
+        std::vector<span> spans;
+        size_t total = 0;
+        try {
+            std::unique_lock<std::mutex> lk(mutex_);
+            list.reserve(producers_.size());
+            spans.reserve(producers_.size() * 2);
+            for (auto& p : producers_) {
+                bool orphaned    = p->orphaned.load(std::memory_order_acquire);
+                const size_t h   = p->head.load(std::memory_order_acquire);
+                const size_t t   = p->tail.load(std::memory_order_relaxed);
+                const size_t len = h - t;
+                list.push_back({ p.get(), h, orphaned });
+                if (len == 0) {
+                    continue;
+                }
+                const size_t off   = t & (p->cap - 1);
+                const size_t first = (std::min)(len, p->cap - off);
+                spans.push_back({ p->buf.get() + off, first });
+                if (len > first) {
+                    spans.push_back({ p->buf.get(), len - first });
+                }
+                total += len;
+            }
+        } catch (...) {
+            return false;
+        }
+        if (size_ > 0) {
+            const bool by_size = opts_.rotate_bytes > 0 && size_ + total > opts_.rotate_bytes;
+            const bool by_time = opts_.rotate_interval > 0 && std::chrono::steady_clock::now() - opened_ >= std::chrono::seconds(opts_.rotate_interval);
+            if (by_size || by_time) {
+                rotate();
+            }
+        }
+        if (total > 0) {
+            if (fd_) {
+                write_spans(fd_, spans);
+                if (opts_.fsync == fsync_mode::batch) {
+                    sync_file(fd_);
+                }
+            }
+            size_ += total;
+            bytes_.fetch_add(total, std::memory_order_relaxed);
+        }
+        bool has_orphan = false;
+        for (auto& e : list) {
+            e.p->tail.store(e.head, std::memory_order_release);
+            has_orphan |= e.orphaned;
+        }
+        if (has_orphan) {
+            // a thread that has exited will not write again; fold its counters
+            // into the sink and free its buffer.
+            std::unique_lock<std::mutex> lk(mutex_);
+            for (auto& e : list) {
+                if (!e.orphaned) {
+                    continue;
+                }
+                auto it = std::find_if(producers_.begin(), producers_.end(), [&](auto& p) { return p.get() == e.p; });
+                if (it == producers_.end()) {
+                    continue;
+                }
+                retired_lines_ += e.p->lines.load(std::memory_order_relaxed);
+                retired_drop_ += e.p->dropped.load(std::memory_order_relaxed);
+                producers_.erase(it);
+            }
+        }
+        return total > 0;
+    }
+
+    void sink::run() noexcept {
+        for (;;) {
+            if (opts_.flush_interval > 0) {
+                wake_.try_acquire_for(std::chrono::milliseconds(opts_.flush_interval));
+            }
+            else {
+                wake_.acquire();
+            }
+            wake_pending_.store(false, std::memory_order_release);
+            const bool quit = closed_.load(std::memory_order_acquire);
+            uint64_t request;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                request = flush_request_;
+            }
+            bool written = drain();
+            if (written && opts_.fsync == fsync_mode::interval && fd_) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - synced_ >= std::chrono::milliseconds(opts_.fsync_interval)) {
+                    sync_file(fd_);
+                    synced_ = now;
+                }
+            }
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                flush_done_ = request;
+            }
+            flushed_.notify_all();
+            if (quit) {
+                break;
+            }
+        }
+        if (fd_ && opts_.fsync != fsync_mode::none) {
+            sync_file(fd_);
+        }
+        close_file(fd_);
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            stopped_ = true;
+        }
+        flushed_.notify_all();
+    }
+
+    void sink::flush() noexcept {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (stopped_) {
+            return;
+        }
+        const uint64_t request = ++flush_request_;
+        lk.unlock();
+        wakeup();
+        lk.lock();
+        flushed_.wait(lk, [&] { return flush_done_ >= request || stopped_; });
+    }
+
+    void sink::close() noexcept {
+        closed_.store(true, std::memory_order_release);
+        std::unique_lock<std::mutex> lk(close_mutex_);
+        if (thread_.joinable()) {
+            wakeup();
+            thread_.join();
+        }
+    }
+
+    log::stats sink::stats() const noexcept {
+        log::stats s;
+        std::unique_lock<std::mutex> lk(mutex_);
+        s.lines   = retired_lines_;
+        s.dropped = retired_drop_;
+        for (auto& p : producers_) {
+            s.lines += p->lines.load(std::memory_order_relaxed);
+            s.dropped += p->dropped.load(std::memory_order_relaxed);
+        }
+        s.bytes     = bytes_.load(std::memory_order_relaxed);
+        s.rotations = rotations_.load(std::memory_order_relaxed);
+        return s;
+    }
+}
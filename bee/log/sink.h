@@ -0,0 +1,103 @@
+#pragma once
+
+#include <bee/nonstd/filesystem.h>
+#include <bee/nonstd/semaphore.h>
+#include <bee/utility/file_handle.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace bee::log {
+    enum class fsync_mode {
+        none,
+        batch,
+        interval,
+    };
+
+    struct options {
+        fs::path path;
+        uint64_t rotate_bytes = 0;
+        int rotate_interval   = 0; // seconds
+        int rotate_files      = 1;
+        size_t buffer_size    = 1 << 20; // per writing thread
+        int flush_interval    = 100;     // milliseconds, 0: only on flush or a half full buffer
+        fsync_mode fsync      = fsync_mode::none;
+        int fsync_interval    = 0; // milliseconds
+        bool timestamp        = true;
+    };
+
+    struct stats {
+        uint64_t lines     = 0;
+        uint64_t bytes     = 0;
+        uint64_t dropped   = 0;
+        uint32_t rotations = 0;
+    };
+
+    struct producer;
+
+    // A named log file fed through one lock-free buffer per writing thread and
+    // drained in batches by a background thread. Sinks live until the process
+    // exits; after close() the writer is stopped, writes are dropped and the
+    // name can be opened again.
+    class sink {
+    public:
+        static sink* open(std::string_view name, options&& opts, std::error_code& ec);
+        static sink* find(std::string_view name) noexcept;
+
+        sink(options&& opts, file_handle fd, uint64_t size) noexcept;
+        ~sink() noexcept;
+        sink(const sink&)            = delete;
+        sink& operator=(const sink&) = delete;
+
+        // data must hold whole lines. Returns false, dropping them, when the
+        // calling thread's buffer is full or the sink is closed.
+        bool write(const char* data, size_t len) noexcept;
+        void flush() noexcept;
+        void close() noexcept;
+        bool closed() const noexcept {
+            return closed_.load(std::memory_order_acquire);
+        }
+        log::stats stats() const noexcept;
+        const options& opts() const noexcept {
+            return opts_;
+        }
+
+    private:
+        producer* local();
+        void run() noexcept;
+        bool drain() noexcept;
+        void rotate() noexcept;
+        void wakeup() noexcept;
+
+    private:
+        options opts_;
+        file_handle fd_;
+        uint64_t size_;
+        std::chrono::steady_clock::time_point opened_;
+        std::chrono::steady_clock::time_point synced_;
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<producer>> producers_;
+        std::condition_variable flushed_;
+        uint64_t flush_request_ = 0;
+        uint64_t flush_done_    = 0;
+        bool stopped_           = false;
+        uint64_t retired_lines_ = 0;
+        uint64_t retired_drop_  = 0;
+        std::atomic<uint64_t> bytes_ { 0 };
+        std::atomic<uint32_t> rotations_ { 0 };
+        std::atomic<bool> closed_ { false };
+        std::atomic<bool> wake_pending_ { false };
+        std::binary_semaphore wake_ { 0 };
+        std::mutex close_mutex_;
+        std::thread thread_;
+    };
+}
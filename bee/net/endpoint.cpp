@@ -195,6 +195,9 @@ namespace bee::net {
     unsigned short endpoint::family() const noexcept {
         return addr()->sa_family;
     }
+    bool endpoint::is_unix() const noexcept {
+        return family() == AF_UNIX;
+    }
     bool endpoint::valid() const noexcept {
         return addrlen() != 0;
     }
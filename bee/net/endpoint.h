@@ -34,6 +34,7 @@ namespace bee::net {
         const sockaddr* addr() const noexcept;
         socklen_t addrlen() const noexcept;
         unsigned short family() const noexcept;
+        bool is_unix() const noexcept;
         bool valid() const noexcept;
         sockaddr* out_addr() noexcept;
         socklen_t* out_addrlen() noexcept;
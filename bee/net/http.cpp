@@ -0,0 +1,557 @@
+#include <bee/net/http.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define BEE_HTTP_SSE2 1
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+#    endif
+#endif
+
+namespace bee::net::http {
+    static constexpr bool is_tchar(unsigned char c) noexcept {
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            return true;
+        }
+        for (const char* p = "!#$%&'*+-.^_`|~"; *p; ++p) {
+            if (c == (unsigned char)*p) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct tchar_table {
+        bool v[256];
+        constexpr tchar_table() noexcept
+            : v() {
+            for (int i = 0; i < 256; ++i) {
+                v[i] = is_tchar((unsigned char)i);
+            }
+        }
+    };
+    static constexpr tchar_table tchar;
+
+#if defined(BEE_HTTP_SSE2)
+    static inline int first_bit(int mask) noexcept {
+#    if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long idx;
+        _BitScanForward(&idx, (unsigned long)mask);
+        return (int)idx;
+#    else
+        return __builtin_ctz((unsigned int)mask);
+#    endif
+    }
+#endif
+
+    // Returns the first control character other than HTAB, i.e. the end of a field value.
+    static const char* find_ctl(const char* p, const char* end) noexcept {
+#if defined(BEE_HTTP_SSE2)
+        const __m128i c1f = _mm_set1_epi8(0x1f);
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i del = _mm_set1_epi8(0x7f);
+        while (end - p >= 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)p);
+            __m128i ctl     = _mm_cmpeq_epi8(_mm_min_epu8(v, c1f), v);
+            ctl             = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), ctl);
+            ctl             = _mm_or_si128(ctl, _mm_cmpeq_epi8(v, del));
+            if (int mask = _mm_movemask_epi8(ctl)) {
+                return p + first_bit(mask);
+            }
+            p += 16;
+        }
+#endif
+        for (; p != end; ++p) {
+            const unsigned char c = (unsigned char)*p;
+            if ((c < 0x20 && c != '\t') || c == 0x7f) {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    // Returns the first byte that cannot appear in a request-target (SP, CTL or DEL).
+    static const char* find_nonvchar(const char* p, const char* end) noexcept {
+#if defined(BEE_HTTP_SSE2)
+        const __m128i c20 = _mm_set1_epi8(0x20);
+        const __m128i del = _mm_set1_epi8(0x7f);
+        while (end - p >= 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)p);
+            __m128i bad     = _mm_cmpeq_epi8(_mm_min_epu8(v, c20), v);
+            bad             = _mm_or_si128(bad, _mm_cmpeq_epi8(v, del));
+            if (int mask = _mm_movemask_epi8(bad)) {
+                return p + first_bit(mask);
+            }
+            p += 16;
+        }
+#endif
+        for (; p != end; ++p) {
+            const unsigned char c = (unsigned char)*p;
+            if (c <= 0x20 || c == 0x7f) {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    static const char* find_token_end(const char* p, const char* end) noexcept {
+        while (p != end && tchar.v[(unsigned char)*p]) {
+            ++p;
+        }
+        return p;
+    }
+
+    static constexpr unsigned char lower(unsigned char c) noexcept {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    static bool iequals(std::string_view a, std::string_view b) noexcept {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (lower((unsigned char)a[i]) != lower((unsigned char)b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static int hexdigit(char c) noexcept {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        c = (char)lower((unsigned char)c);
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+
+    static std::string_view trim(std::string_view s) noexcept {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    template <typename F>
+    static void foreach_token(std::string_view s, F f) {
+        while (!s.empty()) {
+            size_t pos = s.find(',');
+            f(trim(s.substr(0, pos)));
+            if (pos == std::string_view::npos) {
+                break;
+            }
+            s.remove_prefix(pos + 1);
+        }
+    }
+
+    static bool parse_uint(std::string_view s, uint64_t& v) noexcept {
+        if (s.empty() || s.size() > 19) {
+            return false;
+        }
+        v = 0;
+        for (char c : s) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            v = v * 10 + (uint64_t)(c - '0');
+        }
+        return true;
+    }
+
+    parser::parser(const options& opts) noexcept
+        : m_opts(opts) {}
+
+    void parser::feed(const char* data, size_t len) {
+        compact();
+        m_buf.append(data, len);
+    }
+
+    size_t parser::buffered() const noexcept {
+        return m_buf.size() - m_pos;
+    }
+
+    std::string_view parser::error() const noexcept {
+        return m_error ? std::string_view { m_error } : std::string_view {};
+    }
+
+    parser::result parser::fail(const char* msg) noexcept {
+        m_error = msg;
+        return result::error;
+    }
+
+    void parser::compact() noexcept {
+        if (m_pos == m_buf.size()) {
+            m_buf.clear();
+            m_pos  = 0;
+            m_scan = 0;
+        }
+        else if (m_pos >= 4096 && m_pos * 2 >= m_buf.size()) {
+            m_buf.erase(0, m_pos);
+            m_scan = m_scan > m_pos ? m_scan - m_pos : 0;
+            m_pos  = 0;
+        }
+    }
+
+    parser::result parser::next(request& req) {
+        if (m_error) {
+            return result::error;
+        }
+        if (m_state == state::head) {
+            auto r = parse_head();
+            if (r != result::ok) {
+                return r;
+            }
+        }
+        if (m_state != state::head) {
+            auto r = m_state == state::body_length ? parse_body() : parse_chunked();
+            if (r != result::ok) {
+                return r;
+            }
+        }
+        req   = std::move(m_req);
+        m_req = request {};
+        compact();
+        return result::ok;
+    }
+
+    parser::result parser::parse_head() {
+        const char* buf  = m_buf.data();
+        const size_t len = m_buf.size();
+        while (m_pos < len && (buf[m_pos] == '\r' || buf[m_pos] == '\n')) {
+            ++m_pos;
+        }
+        // Find the blank line that terminates the head, resuming where the last call stopped.
+        size_t head_end = 0;
+        size_t i        = std::max(m_scan, m_pos);
+        for (;;) {
+            const void* nl = i < len ? memchr(buf + i, '\n', len - i) : nullptr;
+            if (!nl) {
+                m_scan = len;
+                break;
+            }
+            i = (size_t)((const char*)nl - buf);
+            if (i + 1 >= len) {
+                m_scan = i;
+                break;
+            }
+            if (buf[i + 1] == '\n') {
+                head_end = i + 2;
+                break;
+            }
+            if (buf[i + 1] == '\r') {
+                if (i + 2 >= len) {
+                    m_scan = i;
+                    break;
+                }
+                if (buf[i + 2] == '\n') {
+                    head_end = i + 3;
+                    break;
+                }
+            }
+            ++i;
+        }
+        if (head_end == 0) {
+            if (len - m_pos > m_opts.max_header_size) {
+                return fail("header too large");
+            }
+            return result::incomplete;
+        }
+        if (head_end - m_pos > m_opts.max_header_size) {
+            return fail("header too large");
+        }
+
+        const char* p   = buf + m_pos;
+        const char* end = buf + head_end;
+        request& req    = m_req;
+
+        const char* method = p;
+        p                  = find_token_end(p, end);
+        if (p == method || *p != ' ') {
+            return fail("invalid method");
+        }
+        req.method.assign(method, p - method);
+        ++p;
+        const char* path = p;
+        p                = find_nonvchar(p, end);
+        if (p == path || *p != ' ') {
+            return fail("invalid request target");
+        }
+        req.path.assign(path, p - path);
+        ++p;
+        if (end - p < 9 || memcmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' || p[7] > '9') {
+            return fail("invalid version");
+        }
+        req.minor_version = p[7] - '0';
+        p += 8;
+        if (*p == '\r') {
+            ++p;
+        }
+        if (*p != '\n') {
+            return fail("invalid version");
+        }
+        ++p;
+
+        for (;;) {
+            if (*p == '\r') {
+                ++p;
+            }
+            if (*p == '\n') {
+                break;
+            }
+            const char* name = p;
+            p                = find_token_end(p, end);
+            if (p == name || *p != ':') {
+                return fail("invalid header name");
+            }
+            std::string_view key { name, (size_t)(p - name) };
+            ++p;
+            while (*p == ' ' || *p == '\t') {
+                ++p;
+            }
+            const char* value = p;
+            p                 = find_ctl(p, end);
+            std::string_view val { value, (size_t)(p - value) };
+            if (*p == '\r') {
+                ++p;
+            }
+            if (*p != '\n') {
+                return fail("invalid header value");
+            }
+            ++p;
+            if (req.headers.size() >= m_opts.max_headers) {
+                return fail("too many headers");
+            }
+            req.headers.emplace_back(key, trim(val));
+        }
+        m_pos  = head_end;
+        m_scan = head_end;
+
+        bool has_length = false;
+        bool chunked    = false;
+        bool has_te     = false;
+        uint64_t length = 0;
+        req.keepalive   = req.minor_version >= 1;
+        for (auto& [key, val] : req.headers) {
+            if (iequals(key, "content-length")) {
+                uint64_t n;
+                if (!parse_uint(val, n) || (has_length && n != length)) {
+                    return fail("invalid content-length");
+                }
+                has_length = true;
+                length     = n;
+            }
+            else if (iequals(key, "transfer-encoding")) {
+                has_te = true;
+                foreach_token(val, [&](std::string_view coding) {
+                    chunked = iequals(coding, "chunked");
+                });
+            }
+            else if (iequals(key, "connection")) {
+                foreach_token(val, [&](std::string_view opt) {
+                    if (iequals(opt, "close")) {
+                        req.keepalive = false;
+                    }
+                    else if (iequals(opt, "keep-alive")) {
+                        req.keepalive = true;
+                    }
+                });
+            }
+        }
+        if (has_te) {
+            if (!chunked) {
+                return fail("unsupported transfer-encoding");
+            }
+            if (has_length) {
+                return fail("both content-length and transfer-encoding");
+            }
+            m_state = state::chunk_size;
+        }
+        else if (has_length && length > 0) {
+            if (length > m_opts.max_body_size) {
+                return fail("body too large");
+            }
+            m_remain = length;
+            m_state  = state::body_length;
+        }
+        return result::ok;
+    }
+
+    parser::result parser::parse_body() {
+        const size_t avail = m_buf.size() - m_pos;
+        const size_t n     = (size_t)std::min<uint64_t>(avail, m_remain);
+        m_req.body.append(m_buf.data() + m_pos, n);
+        m_pos += n;
+        m_remain -= n;
+        if (m_remain > 0) {
+            return result::incomplete;
+        }
+        m_state = state::head;
+        m_scan  = m_pos;
+        return result::ok;
+    }
+
+    parser::result parser::parse_chunked() {
+        const char* buf  = m_buf.data();
+        const size_t len = m_buf.size();
+        for (;;) {
+            switch (m_state) {
+            case state::chunk_size: {
+                const void* nl = m_pos < len ? memchr(buf + m_pos, '\n', len - m_pos) : nullptr;
+                if (!nl) {
+                    if (len - m_pos > 1024) {
+                        return fail("invalid chunk size");
+                    }
+                    return result::incomplete;
+                }
+                const char* p   = buf + m_pos;
+                const char* end = (const char*)nl;
+                uint64_t size   = 0;
+                int digits      = 0;
+                for (; p != end; ++p, ++digits) {
+                    const int v = hexdigit(*p);
+                    if (v < 0) {
+                        break;
+                    }
+                    if (digits >= 16) {
+                        return fail("invalid chunk size");
+                    }
+                    size = size * 16 + (uint64_t)v;
+                }
+                if (digits == 0) {
+                    return fail("invalid chunk size");
+                }
+                while (p != end && (*p == ' ' || *p == '\t')) {
+                    ++p;
+                }
+                if (p != end && *p != ';' && !(*p == '\r' && p + 1 == end)) {
+                    return fail("invalid chunk size");
+                }
+                m_pos = (size_t)(end - buf) + 1;
+                if (size == 0) {
+                    m_remain = 0;
+                    m_state  = state::trailer;
+                    break;
+                }
+                if (size > m_opts.max_body_size - std::min(m_opts.max_body_size, m_req.body.size())) {
+                    return fail("body too large");
+                }
+                m_remain = size;
+                m_state  = state::chunk_data;
+                break;
+            }
+            case state::chunk_data: {
+                const size_t n = (size_t)std::min<uint64_t>(len - m_pos, m_remain);
+                m_req.body.append(buf + m_pos, n);
+                m_pos += n;
+                m_remain -= n;
+                if (m_remain > 0) {
+                    return result::incomplete;
+                }
+                m_state = state::chunk_crlf;
+                break;
+            }
+            case state::chunk_crlf:
+                if (m_pos >= len) {
+                    return result::incomplete;
+                }
+                if (buf[m_pos] == '\r') {
+                    if (m_pos + 1 >= len) {
+                        return result::incomplete;
+                    }
+                    if (buf[m_pos + 1] != '\n') {
+                        return fail("invalid chunk");
+                    }
+                    m_pos += 2;
+                }
+                else if (buf[m_pos] == '\n') {
+                    m_pos += 1;
+                }
+                else {
+                    return fail("invalid chunk");
+                }
+                m_state = state::chunk_size;
+                break;
+            case state::trailer: {
+                const void* nl = m_pos < len ? memchr(buf + m_pos, '\n', len - m_pos) : nullptr;
+                if (!nl) {
+                    if (m_remain + (len - m_pos) > m_opts.max_header_size) {
+                        return fail("header too large");
+                    }
+                    return result::incomplete;
+                }
+                const size_t next = (size_t)((const char*)nl - buf) + 1;
+                const size_t line = next - m_pos;
+                m_remain += line;
+                if (m_remain > m_opts.max_header_size) {
+                    return fail("header too large");
+                }
+                m_pos = next;
+                if (line == 1 || (line == 2 && buf[next - 2] == '\r')) {
+                    m_state = state::head;
+                    m_scan  = m_pos;
+                    return result::ok;
+                }
+                break;
+            }
+            default:
+                return fail("invalid state");
+            }
+        }
+    }
+
+    std::string_view reason_phrase(int status) noexcept {
+        switch (status) {
+        case 100: return "Continue";
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 409: return "Conflict";
+        case 411: return "Length Required";
+        case 413: return "Content Too Large";
+        case 414: return "URI Too Long";
+        case 415: return "Unsupported Media Type";
+        case 426: return "Upgrade Required";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        case 505: return "HTTP Version Not Supported";
+        default: return "";
+        }
+    }
+
+    bool valid_token(std::string_view s) noexcept {
+        return !s.empty() && find_token_end(s.data(), s.data() + s.size()) == s.data() + s.size();
+    }
+
+    bool valid_field_value(std::string_view s) noexcept {
+        return find_ctl(s.data(), s.data() + s.size()) == s.data() + s.size();
+    }
+}
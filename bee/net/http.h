@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bee::net::http {
+    struct request {
+        std::string method;
+        std::string path;
+        int minor_version = 1;
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        bool keepalive = true;
+    };
+
+    class parser {
+    public:
+        enum class result {
+            ok,
+            incomplete,
+            error,
+        };
+        struct options {
+            size_t max_header_size = 64 * 1024;
+            size_t max_headers     = 100;
+            size_t max_body_size   = 16 * 1024 * 1024;
+        };
+
+        parser() noexcept = default;
+        explicit parser(const options& opts) noexcept;
+        void feed(const char* data, size_t len);
+        result next(request& req);
+        size_t buffered() const noexcept;
+        std::string_view error() const noexcept;
+
+    private:
+        enum class state {
+            head,
+            body_length,
+            chunk_size,
+            chunk_data,
+            chunk_crlf,
+            trailer,
+        };
+        result fail(const char* msg) noexcept;
+        result parse_head();
+        result parse_body();
+        result parse_chunked();
+        void compact() noexcept;
+
+    private:
+        options m_opts;
+        std::string m_buf;
+        size_t m_pos        = 0;
+        size_t m_scan       = 0;
+        state m_state       = state::head;
+        uint64_t m_remain   = 0;
+        request m_req;
+        const char* m_error = nullptr;
+    };
+
+    std::string_view reason_phrase(int status) noexcept;
+    bool valid_token(std::string_view s) noexcept;
+    bool valid_field_value(std::string_view s) noexcept;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <bee/net/fd.h>
+#include <bee/net/socket.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bee::net {
+    struct poller_event {
+        fd_t fd;
+        int events;
+    };
+
+    class poller {
+    public:
+        enum class backend {
+            epoll,
+            io_uring,
+        };
+        static constexpr int read  = 1;
+        static constexpr int write = 2;
+
+        static std::unique_ptr<poller> create(backend prefer) noexcept;
+        ~poller() noexcept;
+        poller(const poller&)            = delete;
+        poller& operator=(const poller&) = delete;
+
+        backend type() const noexcept;
+        bool add(fd_t fd, int events) noexcept;
+        bool del(fd_t fd) noexcept;
+        int wait(std::vector<poller_event>& out, int timeout) noexcept;
+
+        // Data ops. With io_uring, the first recv or accept on a registered
+        // fd arms a multishot recv (into a kernel-provided buffer ring) or a
+        // multishot accept, and later calls take what wait() has collected.
+        // send queues the data; queued sends go out in one submission with
+        // the next wait(). serves() is false for the epoll backend, kernels
+        // without these ops and unregistered fds; use net::socket then.
+        // A served socket keeps a kernel reference while its multishot op
+        // is armed, so del() it before closing it.
+        bool serves(fd_t fd) const noexcept;
+        socket::status recv(fd_t fd, int& rc, char* buf, int len) noexcept;
+        socket::status send(fd_t fd, int& rc, const char* buf, int len) noexcept;
+        socket::fdstat accept(fd_t fd, fd_t& newfd) noexcept;
+
+    private:
+        struct entry {
+            int events     = 0;
+            uint32_t gen   = 0; // bumped on every add, tags poll requests
+            uint32_t reg   = 0; // fixed while registered, tags data ops
+            bool armed     = false;
+            uint8_t mode   = 0; // data op: none, recv or accept
+            bool op_armed  = false;
+            bool sending   = false;
+            bool eof       = false;
+            bool ready     = false;
+            int error      = 0;
+            uint32_t stamp = 0;
+            size_t slot    = 0;
+            size_t rpos    = 0;
+            std::string rbuf;
+            std::string sbuf;
+            std::deque<fd_t> accepted;
+        };
+        struct uring;
+        struct bufring;
+        poller() noexcept;
+        bool init_epoll() noexcept;
+        bool init_uring() noexcept;
+        bool init_bufring() noexcept;
+        int wait_epoll(std::vector<poller_event>& out, int timeout) noexcept;
+        int wait_uring(std::vector<poller_event>& out, int timeout) noexcept;
+        bool arm(fd_t fd, entry& e) noexcept;
+        bool submit_send(fd_t fd, entry& e) noexcept;
+        void cancel(fd_t fd, entry& e) noexcept;
+        void complete(const void* cqe, std::vector<poller_event>& out) noexcept;
+        void report(std::vector<poller_event>& out, fd_t fd, entry& e, int events) noexcept;
+        void drain() noexcept;
+
+    private:
+        backend m_backend = backend::epoll;
+        int m_fd          = -1;
+        std::unique_ptr<uring> m_uring;
+        std::unique_ptr<bufring> m_bufring;
+        std::unordered_map<fd_t, entry> m_entries;
+        std::vector<fd_t> m_rearm;
+        std::vector<fd_t> m_sendq;
+        std::vector<fd_t> m_ready;
+        // sends in flight, keyed by user_data; they outlive del()
+        std::unordered_map<uint64_t, std::pair<std::string, size_t>> m_inflight;
+        // generations are poller-wide so a completion for a removed fd
+        // never matches a later registration of the same fd number
+        uint32_t m_gen   = 0;
+        uint32_t m_stamp = 0;
+        bool m_dataops   = true;
+    };
+}
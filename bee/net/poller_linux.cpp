@@ -0,0 +1,968 @@
+#include <bee/net/poller.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#endif
+#if defined(IORING_FEAT_EXT_ARG) && defined(__NR_io_uring_setup)
+#    define BEE_IO_URING 1
+#    if defined(IORING_RECV_MULTISHOT)
+#        define BEE_IO_URING_DATAOPS 1
+#    endif
+#endif
+
+namespace bee::net {
+    static constexpr int kEpollEvents = 256;
+
+    static int to_events(uint32_t mask, int registered) noexcept {
+        int events = 0;
+        if (mask & (POLLIN | POLLHUP | POLLERR)) {
+            events |= poller::read;
+        }
+        if (mask & (POLLOUT | POLLHUP | POLLERR)) {
+            events |= poller::write;
+        }
+        return events & registered;
+    }
+
+#if defined(BEE_IO_URING)
+    static constexpr unsigned kUringEntries = 256;
+    // collected data and connections above these pause the multishot op
+    static constexpr size_t kRecvMax   = 1 << 20;
+    static constexpr size_t kAcceptMax = 256;
+    // send() returns wait once this much is queued for one fd
+    static constexpr size_t kSendMax = 1 << 20;
+
+    enum : uint8_t {
+        op_poll = 1,
+        op_recv,
+        op_accept,
+        op_send,
+    };
+
+    enum : uint8_t {
+        mode_none = 0,
+        mode_recv,
+        mode_accept,
+    };
+
+    static int uring_setup(unsigned entries, io_uring_params* p) noexcept {
+        return (int)syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz) noexcept {
+        return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+    }
+
+    struct poller::uring {
+        void* sq_ptr = MAP_FAILED;
+        void* cq_ptr = MAP_FAILED;
+        size_t sq_size = 0;
+        size_t cq_size = 0;
+        io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+        size_t sqes_size   = 0;
+        unsigned* sq_head  = nullptr;
+        unsigned* sq_tail  = nullptr;
+        unsigned* sq_array = nullptr;
+        unsigned sq_mask   = 0;
+        unsigned sq_entries = 0;
+        unsigned* cq_head  = nullptr;
+        unsigned* cq_tail  = nullptr;
+        unsigned cq_mask   = 0;
+        io_uring_cqe* cqes = nullptr;
+        unsigned pending   = 0;
+
+        io_uring_sqe* get_sqe(int fd) noexcept {
+            unsigned tail = *sq_tail;
+            if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+                int r = uring_enter(fd, pending, 0, 0, NULL, 0);
+                if (r < 0) {
+                    return nullptr;
+                }
+                pending -= std::min((unsigned)r, pending);
+                if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+                    return nullptr;
+                }
+            }
+            unsigned idx  = tail & sq_mask;
+            io_uring_sqe* sqe = &sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sq_array[idx] = idx;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            pending++;
+            return sqe;
+        }
+
+        ~uring() {
+            if (sqes != MAP_FAILED) {
+                munmap(sqes, sqes_size);
+            }
+            if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+                munmap(cq_ptr, cq_size);
+            }
+            if (sq_ptr != MAP_FAILED) {
+                munmap(sq_ptr, sq_size);
+            }
+        }
+    };
+
+#    if defined(BEE_IO_URING_DATAOPS)
+    // Buffers the kernel picks from for multishot recv. A buffer goes back
+    // to the ring as soon as its data is copied out.
+    struct poller::bufring {
+        static constexpr unsigned entries = 64;
+        static constexpr unsigned size    = 16384;
+        static constexpr uint16_t group   = 0;
+        io_uring_buf_ring* ring = (io_uring_buf_ring*)MAP_FAILED;
+        size_t ring_size        = entries * sizeof(io_uring_buf);
+        char* data              = nullptr;
+        uint16_t tail           = 0;
+
+        const char* buffer(uint16_t bid) const noexcept {
+            return data + (size_t)bid * size;
+        }
+        // The entries start at the ring itself; the header's flexible
+        // array member is shifted by 8 bytes when compiled as C++.
+        void put(uint16_t bid) noexcept {
+            io_uring_buf& b = reinterpret_cast<io_uring_buf*>(ring)[tail & (entries - 1)];
+            b.addr          = (uint64_t)(uintptr_t)buffer(bid);
+            b.len           = size;
+            b.bid           = bid;
+            ++tail;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+        ~bufring() {
+            if (ring != MAP_FAILED) {
+                munmap(ring, ring_size);
+            }
+            delete[] data;
+        }
+    };
+#    else
+    struct poller::bufring {};
+#    endif
+
+    // user_data: op in the top byte, a 24-bit generation, then the fd;
+    // 0 marks completions of cancel requests.
+    static uint64_t make_userdata(uint8_t op, uint32_t gen, fd_t fd) noexcept {
+        return ((uint64_t)op << 56) | ((uint64_t)gen << 32) | (uint32_t)fd;
+    }
+
+    static uint32_t to_poll32(int events) noexcept {
+        uint32_t mask = ((events & poller::read) ? POLLIN : 0) | ((events & poller::write) ? POLLOUT : 0);
+#    if __BYTE_ORDER == __BIG_ENDIAN
+        mask = (mask << 16) | (mask >> 16);
+#    endif
+        return mask;
+    }
+#else
+    struct poller::uring {};
+    struct poller::bufring {};
+#endif
+
+    poller::poller() noexcept {}
+
+    poller::~poller() noexcept {
+        drain();
+        m_uring.reset();
+        if (m_fd != -1) {
+            close(m_fd);
+        }
+        m_bufring.reset();
+    }
+
+    std::unique_ptr<poller> poller::create(backend prefer) noexcept {
+        std::unique_ptr<poller> p(new (std::nothrow) poller);
+        if (!p) {
+            return nullptr;
+        }
+        if (prefer == backend::io_uring && p->init_uring()) {
+            return p;
+        }
+        if (p->init_epoll()) {
+            return p;
+        }
+        return nullptr;
+    }
+
+    bool poller::init_epoll() noexcept {
+        m_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_fd == -1) {
+            return false;
+        }
+        m_backend = backend::epoll;
+        return true;
+    }
+
+    bool poller::init_uring() noexcept {
+#if defined(BEE_IO_URING)
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = uring_setup(kUringEntries, &p);
+        if (fd < 0) {
+            return false;
+        }
+        if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+            close(fd);
+            return false;
+        }
+        std::unique_ptr<uring> u(new (std::nothrow) uring);
+        if (!u) {
+            close(fd);
+            return false;
+        }
+        u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            u->sq_size = u->cq_size = std::max(u->sq_size, u->cq_size);
+        }
+        u->sq_ptr = mmap(0, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (u->sq_ptr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            u->cq_ptr = u->sq_ptr;
+        }
+        else {
+            u->cq_ptr = mmap(0, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (u->cq_ptr == MAP_FAILED) {
+                close(fd);
+                return false;
+            }
+        }
+        u->sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        u->sqes      = (io_uring_sqe*)mmap(0, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (u->sqes == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        char* sq       = (char*)u->sq_ptr;
+        char* cq       = (char*)u->cq_ptr;
+        u->sq_head     = (unsigned*)(sq + p.sq_off.head);
+        u->sq_tail     = (unsigned*)(sq + p.sq_off.tail);
+        u->sq_mask     = *(unsigned*)(sq + p.sq_off.ring_mask);
+        u->sq_entries  = *(unsigned*)(sq + p.sq_off.ring_entries);
+        u->sq_array    = (unsigned*)(sq + p.sq_off.array);
+        u->cq_head     = (unsigned*)(cq + p.cq_off.head);
+        u->cq_tail     = (unsigned*)(cq + p.cq_off.tail);
+        u->cq_mask     = *(unsigned*)(cq + p.cq_off.ring_mask);
+        u->cqes        = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        m_fd           = fd;
+        m_uring        = std::move(u);
+        m_backend      = backend::io_uring;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Registered on first use, so pollers that only wait do not pay for it.
+    // Kernels before 5.19 refuse the registration and the data ops are off.
+    bool poller::init_bufring() noexcept {
+#if defined(BEE_IO_URING_DATAOPS)
+        std::unique_ptr<bufring> b(new (std::nothrow) bufring);
+        if (!b) {
+            return false;
+        }
+        b->ring = (io_uring_buf_ring*)mmap(0, b->ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (b->ring == MAP_FAILED) {
+            return false;
+        }
+        b->data = new (std::nothrow) char[(size_t)bufring::entries * bufring::size];
+        if (!b->data) {
+            return false;
+        }
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr    = (uint64_t)(uintptr_t)b->ring;
+        reg.ring_entries = bufring::entries;
+        reg.bgid         = bufring::group;
+        if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            return false;
+        }
+        for (unsigned i = 0; i < bufring::entries; ++i) {
+            b->put((uint16_t)i);
+        }
+        m_bufring = std::move(b);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    poller::backend poller::type() const noexcept {
+        return m_backend;
+    }
+
+    static uint32_t next_gen(uint32_t& gen) noexcept {
+        gen = (gen + 1) & 0xFFFFFF;
+        if (gen == 0) {
+            gen = 1;
+        }
+        return gen;
+    }
+
+    bool poller::add(fd_t fd, int events) noexcept {
+        if (m_backend == backend::epoll) {
+            struct epoll_event ev;
+            ev.events  = ((events & read) ? (uint32_t)EPOLLIN : 0) | ((events & write) ? (uint32_t)EPOLLOUT : 0);
+            ev.data.fd = fd;
+            auto it    = m_entries.find(fd);
+            if (it != m_entries.end()) {
+                if (epoll_ctl(m_fd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+                    it->second.events = events;
+                    return true;
+                }
+                if (errno != ENOENT) {
+                    return false;
+                }
+            }
+            if (epoll_ctl(m_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                return false;
+            }
+            m_entries[fd].events = events;
+            return true;
+        }
+        auto [it, created] = m_entries.try_emplace(fd);
+        auto& e            = it->second;
+        if (created) {
+            e.reg = next_gen(m_gen);
+        }
+        // a data op stays armed, only the poll request is replaced
+        cancel(fd, e);
+        e.gen    = next_gen(m_gen);
+        e.events = events;
+        m_rearm.push_back(fd);
+        return true;
+    }
+
+    bool poller::del(fd_t fd) noexcept {
+        auto it = m_entries.find(fd);
+        if (it == m_entries.end()) {
+            return true;
+        }
+        if (m_backend == backend::epoll) {
+            m_entries.erase(it);
+            epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
+            return true;
+        }
+        auto& e = it->second;
+        cancel(fd, e);
+        if (e.op_armed) {
+#if defined(BEE_IO_URING)
+            if (auto sqe = m_uring->get_sqe(m_fd)) {
+                sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+                sqe->fd        = -1;
+                sqe->addr      = make_userdata(e.mode == mode_recv ? op_recv : op_accept, e.reg, fd);
+                sqe->user_data = 0;
+            }
+#endif
+        }
+        for (fd_t newfd : e.accepted) {
+            socket::close(newfd);
+        }
+        m_entries.erase(it);
+        return true;
+    }
+
+    // Removes the armed poll request of e.
+    void poller::cancel(fd_t fd, entry& e) noexcept {
+#if defined(BEE_IO_URING)
+        if (e.armed) {
+            if (auto sqe = m_uring->get_sqe(m_fd)) {
+                sqe->opcode    = IORING_OP_POLL_REMOVE;
+                sqe->fd        = -1;
+                sqe->addr      = make_userdata(op_poll, e.gen, fd);
+                sqe->user_data = 0;
+            }
+            e.armed = false;
+        }
+#else
+        (void)fd;
+        (void)e;
+#endif
+    }
+
+    int poller::wait(std::vector<poller_event>& out, int timeout) noexcept {
+        out.clear();
+        if (m_backend == backend::epoll) {
+            return wait_epoll(out, timeout);
+        }
+        return wait_uring(out, timeout);
+    }
+
+    int poller::wait_epoll(std::vector<poller_event>& out, int timeout) noexcept {
+        struct epoll_event evs[kEpollEvents];
+        int n;
+        if (timeout < 0) {
+            do
+                n = epoll_wait(m_fd, evs, kEpollEvents, -1);
+            while (n == -1 && errno == EINTR);
+        }
+        else {
+            n = epoll_wait(m_fd, evs, kEpollEvents, timeout);
+            if (n == -1 && errno == EINTR) {
+                n = 0;
+            }
+        }
+        if (n < 0) {
+            return -1;
+        }
+        for (int i = 0; i < n; ++i) {
+            auto it = m_entries.find(evs[i].data.fd);
+            if (it == m_entries.end()) {
+                continue;
+            }
+            if (int events = to_events(evs[i].events, it->second.events)) {
+                out.push_back({ evs[i].data.fd, events });
+            }
+        }
+        return (int)out.size();
+    }
+
+    void poller::report(std::vector<poller_event>& out, fd_t fd, entry& e, int events) noexcept {
+        events &= e.events;
+        if (!events) {
+            return;
+        }
+        if (e.stamp == m_stamp) {
+            out[e.slot].events |= events;
+            return;
+        }
+        e.stamp = m_stamp;
+        e.slot  = out.size();
+        out.push_back({ fd, events });
+    }
+
+#if defined(BEE_IO_URING)
+    // Anything collected for a data op that the caller has not taken yet.
+    static bool has_pending(int mode, size_t rpos, size_t rlen, bool eof, int error, bool accepted) noexcept {
+        return mode != mode_none && (rpos < rlen || eof || error != 0 || accepted);
+    }
+
+    // Poll events for e; reads come from the data op and writes are
+    // reported when the send queue drains.
+    static int poll_mask(int events, uint8_t mode, bool sending) noexcept {
+        if (mode != mode_none) {
+            events &= ~poller::read;
+        }
+        if (sending) {
+            events &= ~poller::write;
+        }
+        return events;
+    }
+
+    bool poller::arm(fd_t fd, entry& e) noexcept {
+        auto& u  = *m_uring;
+        int mask = poll_mask(e.events, e.mode, e.sending || !e.sbuf.empty());
+        if (mask && !e.armed) {
+            auto sqe = u.get_sqe(m_fd);
+            if (!sqe) {
+                return false;
+            }
+            sqe->opcode        = IORING_OP_POLL_ADD;
+            sqe->fd            = fd;
+            sqe->poll32_events = to_poll32(mask);
+            sqe->user_data     = make_userdata(op_poll, e.gen, fd);
+            e.armed            = true;
+        }
+#    if defined(BEE_IO_URING_DATAOPS)
+        if (e.mode == mode_none || e.op_armed || e.eof || e.error) {
+            return true;
+        }
+        if (e.mode == mode_recv ? e.rbuf.size() - e.rpos >= kRecvMax : e.accepted.size() >= kAcceptMax) {
+            return true;
+        }
+        auto sqe = u.get_sqe(m_fd);
+        if (!sqe) {
+            return false;
+        }
+        sqe->fd = fd;
+        if (e.mode == mode_recv) {
+            sqe->opcode    = IORING_OP_RECV;
+            sqe->ioprio    = IORING_RECV_MULTISHOT;
+            sqe->flags     = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = bufring::group;
+            sqe->user_data = make_userdata(op_recv, e.reg, fd);
+        }
+        else {
+            sqe->opcode       = IORING_OP_ACCEPT;
+            sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+            sqe->user_data    = make_userdata(op_accept, e.reg, fd);
+        }
+        e.op_armed = true;
+#    endif
+        return true;
+    }
+
+    bool poller::submit_send(fd_t fd, entry& e) noexcept {
+        auto sqe = m_uring->get_sqe(m_fd);
+        if (!sqe) {
+            return false;
+        }
+        uint64_t ud = make_userdata(op_send, e.reg, fd);
+        auto& data  = m_inflight[ud];
+        data.first.swap(e.sbuf);
+        data.second = 0;
+        e.sbuf.clear();
+        e.sending      = true;
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = fd;
+        sqe->addr      = (uint64_t)(uintptr_t)data.first.data();
+        sqe->len       = (uint32_t)data.first.size();
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = ud;
+        return true;
+    }
+
+    void poller::complete(const void* p, std::vector<poller_event>& out) noexcept {
+        const io_uring_cqe& cqe = *(const io_uring_cqe*)p;
+        if (cqe.user_data == 0) {
+            return;
+        }
+        const uint8_t op   = (uint8_t)(cqe.user_data >> 56);
+        const uint32_t gen = (uint32_t)(cqe.user_data >> 32) & 0xFFFFFF;
+        const fd_t fd      = (fd_t)(uint32_t)cqe.user_data;
+        const bool more    = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        auto it            = m_entries.find(fd);
+        entry* e           = nullptr;
+        if (it != m_entries.end() && (op == op_poll ? it->second.gen : it->second.reg) == gen) {
+            e = &it->second;
+        }
+        switch (op) {
+        case op_poll:
+            if (!e) {
+                return;
+            }
+            e->armed = false;
+            m_rearm.push_back(fd);
+            if (cqe.res == -ECANCELED) {
+                return;
+            }
+            {
+                int mask = poll_mask(e->events, e->mode, e->sending || !e->sbuf.empty());
+                report(out, fd, *e, cqe.res < 0 ? mask : to_events((uint32_t)cqe.res, mask));
+            }
+            return;
+#    if defined(BEE_IO_URING_DATAOPS)
+        case op_recv:
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                uint16_t bid = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                if (e && cqe.res > 0) {
+                    e->rbuf.append(m_bufring->buffer(bid), (size_t)cqe.res);
+                    socket::count_recv(fd, cqe.res);
+                }
+                m_bufring->put(bid);
+            }
+            if (!e) {
+                return;
+            }
+            if (cqe.res == 0) {
+                e->eof = true;
+            }
+            else if (cqe.res == -EINVAL && e->rbuf.empty() && !e->eof) {
+                // no multishot recv in this kernel, fall back to plain recv
+                m_dataops = false;
+                e->mode   = mode_none;
+            }
+            else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+                e->error = -cqe.res;
+            }
+            if (more && e->rbuf.size() - e->rpos >= kRecvMax) {
+                if (auto sqe = m_uring->get_sqe(m_fd)) {
+                    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+                    sqe->fd        = -1;
+                    sqe->addr      = cqe.user_data;
+                    sqe->user_data = 0;
+                }
+            }
+            break;
+        case op_accept:
+            if (cqe.res >= 0) {
+                if (!e) {
+                    close(cqe.res);
+                    return;
+                }
+                socket::reset_traffic(cqe.res);
+                e->accepted.push_back(cqe.res);
+                if (more && e->accepted.size() >= kAcceptMax) {
+                    if (auto sqe = m_uring->get_sqe(m_fd)) {
+                        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+                        sqe->fd        = -1;
+                        sqe->addr      = cqe.user_data;
+                        sqe->user_data = 0;
+                    }
+                }
+            }
+            else if (!e) {
+                return;
+            }
+            else if (cqe.res == -EINVAL && e->accepted.empty()) {
+                m_dataops = false;
+                e->mode   = mode_none;
+            }
+            else if (cqe.res != -ECANCELED) {
+                e->error = -cqe.res;
+            }
+            break;
+#    endif
+        case op_send: {
+            auto in = m_inflight.find(cqe.user_data);
+            if (in == m_inflight.end()) {
+                return;
+            }
+            auto& [data, off] = in->second;
+            if (e && cqe.res > 0) {
+                socket::count_send(fd, cqe.res);
+                off += (size_t)cqe.res;
+                if (off < data.size()) {
+                    // a short send on a stream socket, send the rest
+                    if (auto sqe = m_uring->get_sqe(m_fd)) {
+                        sqe->opcode    = IORING_OP_SEND;
+                        sqe->fd        = fd;
+                        sqe->addr      = (uint64_t)(uintptr_t)(data.data() + off);
+                        sqe->len       = (uint32_t)(data.size() - off);
+                        sqe->msg_flags = MSG_NOSIGNAL;
+                        sqe->user_data = cqe.user_data;
+                        return;
+                    }
+                    e->error = ENOMEM;
+                }
+            }
+            m_inflight.erase(in);
+            if (!e) {
+                return;
+            }
+            e->sending = false;
+            if (cqe.res < 0) {
+                e->error = -cqe.res;
+                e->sbuf.clear();
+            }
+            if (!e->sbuf.empty()) {
+                m_sendq.push_back(fd);
+                return;
+            }
+            m_rearm.push_back(fd);
+            report(out, fd, *e, write);
+            return;
+        }
+        default:
+            return;
+        }
+        // recv and accept
+        if (!more) {
+            e->op_armed = false;
+            m_rearm.push_back(fd);
+        }
+        if (has_pending(e->mode, e->rpos, e->rbuf.size(), e->eof, e->error, !e->accepted.empty())) {
+            if (!e->ready) {
+                e->ready = true;
+                m_ready.push_back(fd);
+            }
+            report(out, fd, *e, read);
+        }
+    }
+
+    int poller::wait_uring(std::vector<poller_event>& out, int timeout) noexcept {
+        auto& u = *m_uring;
+        next_gen(m_stamp);
+        for (fd_t fd : m_rearm) {
+            auto it = m_entries.find(fd);
+            if (it != m_entries.end() && !arm(fd, it->second)) {
+                return -1;
+            }
+        }
+        m_rearm.clear();
+        for (fd_t fd : m_sendq) {
+            auto it = m_entries.find(fd);
+            if (it == m_entries.end()) {
+                continue;
+            }
+            auto& e = it->second;
+            if (!e.sending && !e.sbuf.empty() && !submit_send(fd, e)) {
+                return -1;
+            }
+        }
+        m_sendq.clear();
+        // level triggered: data collected earlier and not taken yet
+        size_t keep = 0;
+        for (fd_t fd : m_ready) {
+            auto it = m_entries.find(fd);
+            if (it == m_entries.end()) {
+                continue;
+            }
+            auto& e = it->second;
+            if (!has_pending(e.mode, e.rpos, e.rbuf.size(), e.eof, e.error, !e.accepted.empty())) {
+                e.ready = false;
+                continue;
+            }
+            m_ready[keep++] = fd;
+            report(out, fd, e, read);
+        }
+        m_ready.resize(keep);
+        if (!out.empty()) {
+            timeout = 0;
+        }
+        bool ready = *u.cq_head != __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        if (!ready && timeout != 0) {
+            struct __kernel_timespec ts;
+            io_uring_getevents_arg arg;
+            memset(&arg, 0, sizeof(arg));
+            if (timeout > 0) {
+                ts.tv_sec  = timeout / 1000;
+                ts.tv_nsec = (timeout % 1000) * 1000000;
+                arg.ts     = (uint64_t)(uintptr_t)&ts;
+            }
+            int r;
+            do
+                r = uring_enter(m_fd, u.pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+            while (r < 0 && errno == EINTR && timeout < 0);
+            if (r >= 0) {
+                u.pending -= std::min((unsigned)r, u.pending);
+            }
+            else if (errno != ETIME && errno != EINTR) {
+                return -1;
+            }
+        }
+        else if (u.pending) {
+            int r = uring_enter(m_fd, u.pending, 0, 0, NULL, 0);
+            if (r < 0) {
+                return -1;
+            }
+            u.pending -= std::min((unsigned)r, u.pending);
+        }
+        unsigned head = *u.cq_head;
+        unsigned tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            complete(&u.cqes[head & u.cq_mask], out);
+        }
+        __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+        return (int)out.size();
+    }
+
+    // Cancels the data ops and sends still in flight and waits (bounded)
+    // for their completions, so the kernel is done with the buffers
+    // before they are freed.
+    void poller::drain() noexcept {
+        if (m_backend != backend::io_uring) {
+            return;
+        }
+        auto busy = [&] {
+            if (!m_inflight.empty()) {
+                return true;
+            }
+            for (auto& [fd, e] : m_entries) {
+                if (e.op_armed) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        if (!busy()) {
+            return;
+        }
+        auto& u = *m_uring;
+        for (auto& [fd, e] : m_entries) {
+            if (e.op_armed) {
+                if (auto sqe = u.get_sqe(m_fd)) {
+                    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+                    sqe->fd        = -1;
+                    sqe->addr      = make_userdata(e.mode == mode_recv ? op_recv : op_accept, e.reg, fd);
+                    sqe->user_data = 0;
+                }
+            }
+        }
+        for (auto& [ud, data] : m_inflight) {
+            if (auto sqe = u.get_sqe(m_fd)) {
+                sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+                sqe->fd        = -1;
+                sqe->addr      = ud;
+                sqe->user_data = 0;
+            }
+        }
+        std::vector<poller_event> out;
+        for (int i = 0; i < 100 && busy(); ++i) {
+            m_rearm.clear();
+            m_sendq.clear();
+            for (auto& [fd, e] : m_entries) {
+                e.mode = mode_none;
+                e.sbuf.clear();
+            }
+            if (wait_uring(out, 10) < 0) {
+                break;
+            }
+        }
+        for (auto& [fd, e] : m_entries) {
+            for (fd_t newfd : e.accepted) {
+                socket::close(newfd);
+            }
+        }
+    }
+#else
+    bool poller::arm(fd_t, entry&) noexcept {
+        return false;
+    }
+    bool poller::submit_send(fd_t, entry&) noexcept {
+        return false;
+    }
+    void poller::complete(const void*, std::vector<poller_event>&) noexcept {}
+    int poller::wait_uring(std::vector<poller_event>&, int) noexcept {
+        return -1;
+    }
+    void poller::drain() noexcept {}
+#endif
+
+    bool poller::serves(fd_t fd) const noexcept {
+#if defined(BEE_IO_URING_DATAOPS)
+        return m_backend == backend::io_uring && m_dataops && m_entries.find(fd) != m_entries.end();
+#else
+        (void)fd;
+        return false;
+#endif
+    }
+
+    socket::status poller::recv(fd_t fd, int& rc, char* buf, int len) noexcept {
+#if defined(BEE_IO_URING_DATAOPS)
+        auto it = m_entries.find(fd);
+        if (it == m_entries.end()) {
+            errno = EBADF;
+            return socket::status::failed;
+        }
+        auto& e = it->second;
+        if (e.mode == mode_none) {
+            if (!m_bufring && !init_bufring()) {
+                m_dataops = false;
+                return socket::recv(fd, rc, buf, len);
+            }
+            // what is already in the socket is read here, the multishot
+            // recv armed by the next wait collects the rest
+            e.mode = mode_recv;
+            cancel(fd, e);
+            e.gen = next_gen(m_gen);
+            m_rearm.push_back(fd);
+            auto status = socket::recv(fd, rc, buf, len);
+            if (status == socket::status::close) {
+                e.eof = true;
+            }
+            else if (status == socket::status::failed) {
+                e.error = errno;
+            }
+            return status;
+        }
+        if (e.mode != mode_recv) {
+            errno = EINVAL;
+            return socket::status::failed;
+        }
+        size_t avail = e.rbuf.size() - e.rpos;
+        if (avail > 0) {
+            rc = (int)std::min(avail, (size_t)len);
+            memcpy(buf, e.rbuf.data() + e.rpos, (size_t)rc);
+            e.rpos += (size_t)rc;
+            if (e.rpos == e.rbuf.size()) {
+                e.rbuf.clear();
+                e.rpos = 0;
+            }
+            else if (e.rpos >= 65536) {
+                e.rbuf.erase(0, e.rpos);
+                e.rpos = 0;
+            }
+            if (!e.op_armed) {
+                m_rearm.push_back(fd);
+            }
+            return socket::status::success;
+        }
+        if (e.error) {
+            errno = e.error;
+            return socket::status::failed;
+        }
+        if (e.eof) {
+            rc = 0;
+            return socket::status::close;
+        }
+        errno = EAGAIN;
+        return socket::status::wait;
+#else
+        return socket::recv(fd, rc, buf, len);
+#endif
+    }
+
+    socket::fdstat poller::accept(fd_t fd, fd_t& newfd) noexcept {
+#if defined(BEE_IO_URING_DATAOPS)
+        auto it = m_entries.find(fd);
+        if (it == m_entries.end()) {
+            errno = EBADF;
+            return socket::fdstat::failed;
+        }
+        auto& e = it->second;
+        if (e.mode == mode_none) {
+            e.mode = mode_accept;
+            cancel(fd, e);
+            e.gen = next_gen(m_gen);
+            m_rearm.push_back(fd);
+            return socket::accept(fd, newfd);
+        }
+        if (e.mode != mode_accept) {
+            errno = EINVAL;
+            return socket::fdstat::failed;
+        }
+        if (!e.accepted.empty()) {
+            newfd = e.accepted.front();
+            e.accepted.pop_front();
+            if (!e.op_armed) {
+                m_rearm.push_back(fd);
+            }
+            return socket::fdstat::success;
+        }
+        if (e.error) {
+            // errors such as EMFILE do not stop the listener, report once
+            errno   = e.error;
+            e.error = 0;
+            m_rearm.push_back(fd);
+            return socket::fdstat::failed;
+        }
+        errno = EAGAIN;
+        return socket::fdstat::wait;
+#else
+        return socket::accept(fd, newfd);
+#endif
+    }
+
+    socket::status poller::send(fd_t fd, int& rc, const char* buf, int len) noexcept {
+#if defined(BEE_IO_URING_DATAOPS)
+        auto it = m_entries.find(fd);
+        if (it == m_entries.end()) {
+            errno = EBADF;
+            return socket::status::failed;
+        }
+        auto& e = it->second;
+        if (e.error) {
+            errno = e.error;
+            return socket::status::failed;
+        }
+        if (e.sbuf.size() >= kSendMax) {
+            errno = EAGAIN;
+            return socket::status::wait;
+        }
+        if (e.sbuf.empty() && !e.sending) {
+            m_sendq.push_back(fd);
+        }
+        e.sbuf.append(buf, (size_t)len);
+        rc = len;
+        return socket::status::success;
+#else
+        return socket::send(fd, rc, buf, len);
+#endif
+    }
+}
@@ -0,0 +1,376 @@
+#if defined(_WIN32)
+#    include <winsock2.h>
+#else
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <poll.h>
+#    include <unistd.h>
+#endif
+
+#include <bee/net/relay.h>
+#include <bee/net/socket.h>
+#include <bee/thread/simplethread.h>
+
+#include <new>
+#include <utility>
+
+namespace bee::net {
+#if defined(_WIN32)
+    using pollfd_t = WSAPOLLFD;
+    static int poll_wait(pollfd_t* fds, size_t n) noexcept {
+        return ::WSAPoll(fds, (ULONG)n, -1);
+    }
+    static int last_error() noexcept {
+        return ::WSAGetLastError();
+    }
+#else
+    using pollfd_t = struct pollfd;
+    static int poll_wait(pollfd_t* fds, size_t n) noexcept {
+        return ::poll(fds, (nfds_t)n, -1);
+    }
+    static int last_error() noexcept {
+        return errno;
+    }
+#endif
+
+    static void close_fd(fd_t& fd) noexcept {
+        if (fd != retired_fd) {
+            socket::close(fd);
+            fd = retired_fd;
+        }
+    }
+
+    class relay_loop {
+    public:
+        static relay_loop* get() noexcept {
+            static relay_loop* loop = create();
+            return loop;
+        }
+        void add(std::shared_ptr<relay> r) {
+            {
+                std::unique_lock<std::mutex> lk(m_mutex);
+                m_pending.emplace_back(std::move(r));
+            }
+            wakeup();
+        }
+        void wakeup() noexcept {
+            char c = 0;
+            int rc;
+            socket::send(m_wakeup[1], rc, &c, 1);
+        }
+
+    private:
+        static relay_loop* create() noexcept {
+            relay_loop* loop = new relay_loop;
+            if (!socket::pair(loop->m_wakeup)) {
+                delete loop;
+                return nullptr;
+            }
+            if (!thread_create(main, loop)) {
+                socket::close(loop->m_wakeup[0]);
+                socket::close(loop->m_wakeup[1]);
+                delete loop;
+                return nullptr;
+            }
+            return loop;
+        }
+        static void main(void* ud) noexcept {
+            static_cast<relay_loop*>(ud)->run();
+        }
+        void drain_wakeup() noexcept {
+            char tmp[128];
+            int rc;
+            while (socket::recv(m_wakeup[0], rc, tmp, sizeof(tmp)) == socket::status::success) {
+            }
+        }
+        void run() noexcept {
+            std::vector<std::shared_ptr<relay>> relays;
+            std::vector<pollfd_t> fds;
+            std::vector<std::pair<relay*, relay::direction>> owners;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lk(m_mutex);
+                    for (auto& r : m_pending) {
+                        relays.emplace_back(std::move(r));
+                    }
+                    m_pending.clear();
+                }
+                fds.clear();
+                owners.clear();
+                fds.push_back({ m_wakeup[0], POLLIN, 0 });
+                for (size_t i = 0; i < relays.size();) {
+                    auto& r = *relays[i];
+                    if (r.m_cancelled) {
+                        r.finish(0);
+                    }
+                    if (r.done()) {
+                        relays[i] = std::move(relays.back());
+                        relays.pop_back();
+                        continue;
+                    }
+                    for (auto dir : { relay::direction::a2b, relay::direction::b2a }) {
+                        if (short events = r.events(dir)) {
+                            fds.push_back({ r.watch(dir), events, 0 });
+                            owners.emplace_back(&r, dir);
+                        }
+                    }
+                    ++i;
+                }
+                if (poll_wait(fds.data(), fds.size()) < 0) {
+                    continue;
+                }
+                if (fds[0].revents) {
+                    drain_wakeup();
+                }
+                for (size_t i = 1; i < fds.size(); ++i) {
+                    if (fds[i].revents) {
+                        auto [r, dir] = owners[i - 1];
+                        if (!r->done()) {
+                            r->step(dir);
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        fd_t m_wakeup[2] = { retired_fd, retired_fd };
+        std::mutex m_mutex;
+        std::vector<std::shared_ptr<relay>> m_pending;
+    };
+
+    relay::relay(fd_t a, fd_t b, const options& opts) noexcept
+        : m_fd { a, b }
+        , m_opts(opts) {
+        get(direction::a2b).src = a;
+        get(direction::a2b).dst = b;
+        get(direction::b2a).src = b;
+        get(direction::b2a).dst = a;
+    }
+
+    relay::~relay() noexcept {
+        for (auto& c : m_channel) {
+            close_fd(c.pipe[0]);
+            close_fd(c.pipe[1]);
+        }
+        close_fd(m_fd[0]);
+        close_fd(m_fd[1]);
+        close_fd(m_event[0]);
+        close_fd(m_event[1]);
+    }
+
+    bool relay::init() noexcept {
+        if (!socket::pair(m_event)) {
+            return false;
+        }
+#if defined(__linux__)
+        if (m_opts.splice && !m_opts.tap) {
+            for (auto& c : m_channel) {
+                if (!socket::pipe(c.pipe)) {
+                    close_fd(m_channel[0].pipe[0]);
+                    close_fd(m_channel[0].pipe[1]);
+                    m_opts.splice = false;
+                    break;
+                }
+            }
+        }
+        else {
+            m_opts.splice = false;
+        }
+#else
+        m_opts.splice = false;
+#endif
+        if (!m_opts.splice) {
+            for (auto& c : m_channel) {
+                c.buf.reset(new (std::nothrow) char[m_opts.bufsize]);
+                if (!c.buf) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<relay> relay::create(fd_t a, fd_t b, const options& opts) {
+        auto loop = relay_loop::get();
+        if (!loop) {
+            return nullptr;
+        }
+        auto r = std::make_shared<relay>(a, b, opts);
+        if (!r->init()) {
+            r->m_fd[0] = retired_fd;
+            r->m_fd[1] = retired_fd;
+            return nullptr;
+        }
+        loop->add(r);
+        return r;
+    }
+
+    fd_t relay::event() const noexcept {
+        return m_event[0];
+    }
+
+    bool relay::done() const noexcept {
+        return m_done;
+    }
+
+    int relay::error() const noexcept {
+        return m_error;
+    }
+
+    uint64_t relay::bytes(direction dir) const noexcept {
+        return get(dir).bytes;
+    }
+
+    void relay::clear_event() noexcept {
+        char tmp[128];
+        int rc;
+        while (socket::recv(m_event[0], rc, tmp, sizeof(tmp)) == socket::status::success) {
+        }
+        m_notified = false;
+    }
+
+    std::vector<relay::tap_chunk> relay::drain_tap() {
+        std::vector<tap_chunk> r;
+        std::unique_lock<std::mutex> lk(m_mutex);
+        r.swap(m_tap);
+        return r;
+    }
+
+    void relay::cancel() noexcept {
+        if (m_done || m_cancelled.exchange(true)) {
+            return;
+        }
+        if (auto loop = relay_loop::get()) {
+            loop->wakeup();
+        }
+    }
+
+    void relay::notify() noexcept {
+        if (!m_notified.exchange(true)) {
+            char c = 0;
+            int rc;
+            socket::send(m_event[1], rc, &c, 1);
+        }
+    }
+
+    void relay::finish(int err) noexcept {
+        for (auto& c : m_channel) {
+            close_fd(c.pipe[0]);
+            close_fd(c.pipe[1]);
+        }
+        close_fd(m_fd[0]);
+        close_fd(m_fd[1]);
+        m_error = err;
+        m_done  = true;
+        notify();
+    }
+
+    short relay::events(direction dir) const noexcept {
+        auto& c = get(dir);
+        if (c.closed) {
+            return 0;
+        }
+        return c.len > 0 ? POLLOUT : POLLIN;
+    }
+
+    fd_t relay::watch(direction dir) const noexcept {
+        auto& c = get(dir);
+        return c.len > 0 ? c.dst : c.src;
+    }
+
+    int relay::fill(direction dir) noexcept {
+        auto& c = get(dir);
+#if defined(__linux__)
+        if (m_opts.splice) {
+            ssize_t n = ::splice(c.src, NULL, c.pipe[1], NULL, m_opts.bufsize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            socket::count_recv(c.src, (int)n);
+            if (n > 0) {
+                c.len = (size_t)n;
+                return 1;
+            }
+            if (n == 0) {
+                c.eof = true;
+                return 1;
+            }
+            return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        }
+#endif
+        int rc;
+        switch (socket::recv(c.src, rc, c.buf.get(), (int)m_opts.bufsize)) {
+        case socket::status::success:
+            c.off = 0;
+            c.len = (size_t)rc;
+            if (m_opts.tap) {
+                std::unique_lock<std::mutex> lk(m_mutex);
+                m_tap.push_back({ dir, std::string { c.buf.get(), c.len } });
+                lk.unlock();
+                notify();
+            }
+            return 1;
+        case socket::status::close:
+            c.eof = true;
+            return 1;
+        case socket::status::wait:
+            return 0;
+        default:
+            return -1;
+        }
+    }
+
+    int relay::flush(channel& c) noexcept {
+#if defined(__linux__)
+        if (m_opts.splice) {
+            ssize_t n = ::splice(c.pipe[0], NULL, c.dst, NULL, c.len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            socket::count_send(c.dst, (int)n);
+            if (n > 0) {
+                c.len -= (size_t)n;
+                c.bytes += (uint64_t)n;
+                return 1;
+            }
+            return (n < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+        }
+#endif
+        int rc;
+        switch (socket::send(c.dst, rc, c.buf.get() + c.off, (int)c.len)) {
+        case socket::status::success:
+            c.off += (size_t)rc;
+            c.len -= (size_t)rc;
+            c.bytes += (uint64_t)rc;
+            return 1;
+        case socket::status::wait:
+            return 0;
+        default:
+            return -1;
+        }
+    }
+
+    bool relay::step(direction dir) noexcept {
+        auto& c = get(dir);
+        while (!c.closed) {
+            int r;
+            if (c.len > 0) {
+                r = flush(c);
+            }
+            else if (c.eof) {
+                socket::shutdown(c.dst, socket::shutdown_flag::write);
+                c.closed = true;
+                break;
+            }
+            else {
+                r = fill(dir);
+            }
+            if (r < 0) {
+                finish(last_error());
+                return false;
+            }
+            if (r == 0) {
+                return true;
+            }
+        }
+        if (m_channel[0].closed && m_channel[1].closed) {
+            finish(0);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <bee/net/fd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bee::net {
+    class relay {
+        friend class relay_loop;
+
+    public:
+        enum class direction {
+            a2b = 0,
+            b2a,
+        };
+        struct options {
+            bool tap       = false;
+            bool splice    = true;
+            size_t bufsize = 64 * 1024;
+        };
+        struct tap_chunk {
+            direction dir;
+            std::string data;
+        };
+
+        static std::shared_ptr<relay> create(fd_t a, fd_t b, const options& opts);
+        relay(fd_t a, fd_t b, const options& opts) noexcept;
+        ~relay() noexcept;
+        relay(const relay&)            = delete;
+        relay& operator=(const relay&) = delete;
+
+        fd_t event() const noexcept;
+        bool done() const noexcept;
+        int error() const noexcept;
+        uint64_t bytes(direction dir) const noexcept;
+        void clear_event() noexcept;
+        std::vector<tap_chunk> drain_tap();
+        void cancel() noexcept;
+
+    private:
+        struct channel {
+            fd_t src     = retired_fd;
+            fd_t dst     = retired_fd;
+            fd_t pipe[2] = { retired_fd, retired_fd };
+            std::unique_ptr<char[]> buf;
+            size_t off  = 0;
+            size_t len  = 0;
+            bool eof    = false;
+            bool closed = false;
+            std::atomic<uint64_t> bytes = 0;
+        };
+        bool init() noexcept;
+        bool step(direction dir) noexcept;
+        short events(direction dir) const noexcept;
+        fd_t watch(direction dir) const noexcept;
+        void finish(int err) noexcept;
+        void notify() noexcept;
+        int fill(direction dir) noexcept;
+        int flush(channel& c) noexcept;
+        channel& get(direction dir) noexcept {
+            return m_channel[static_cast<int>(dir)];
+        }
+        const channel& get(direction dir) const noexcept {
+            return m_channel[static_cast<int>(dir)];
+        }
+
+    private:
+        fd_t m_fd[2];
+        fd_t m_event[2] = { retired_fd, retired_fd };
+        channel m_channel[2];
+        options m_opts;
+        std::mutex m_mutex;
+        std::vector<tap_chunk> m_tap;
+        std::atomic<bool> m_done      = false;
+        std::atomic<bool> m_cancelled = false;
+        std::atomic<bool> m_notified  = false;
+        std::atomic<int> m_error      = 0;
+    };
+}
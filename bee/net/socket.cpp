@@ -17,9 +17,10 @@
 #    include <netinet/in.h>
 #    include <netinet/tcp.h>
 #    include <signal.h>
+#    include <sys/ioctl.h>
 #    include <unistd.h>
-#    if defined(__APPLE__)
-#        include <sys/ioctl.h>
+#    if defined(__linux__)
+#        include <linux/sockios.h>
 #    elif defined(__FreeBSD__)
 #        include <sys/socket.h>
 #    endif
@@ -30,6 +31,8 @@
 #include <bee/net/socket.h>
 #include <bee/nonstd/unreachable.h>
 
+#include <atomic>
+#include <new>
 #include <cassert>
 
 #define net_success(x) ((x) == 0)
@@ -245,7 +248,86 @@ namespace bee::net::socket {
     }
 #endif
 
+    struct traffic_slot {
+        std::atomic<bool> tracked;
+        std::atomic<uint64_t> bytes_sent;
+        std::atomic<uint64_t> bytes_recv;
+        std::atomic<uint64_t> send_calls;
+        std::atomic<uint64_t> recv_calls;
+    };
+
+    // Counters are indexed by fd in pages allocated on first use, so every
+    // fd is covered without a fixed-size table. Pages are never freed.
+    static constexpr size_t kTrafficPageBits = 10;
+    static constexpr size_t kTrafficPageSize = (size_t)1 << kTrafficPageBits;
+    static constexpr size_t kTrafficPages    = (size_t)1 << 14;
+    static std::atomic<traffic_slot*> g_traffic[kTrafficPages];
+
+    static traffic_slot* find_traffic(fd_t s, bool create) noexcept {
+#if defined(_WIN32)
+        const size_t idx = (size_t)s / 4;
+#else
+        const size_t idx = (size_t)s;
+#endif
+        const size_t page = idx >> kTrafficPageBits;
+        if (page >= kTrafficPages) {
+            return nullptr;
+        }
+        traffic_slot* slots = g_traffic[page].load(std::memory_order_acquire);
+        if (!slots) {
+            if (!create) {
+                return nullptr;
+            }
+            traffic_slot* fresh = new (std::nothrow) traffic_slot[kTrafficPageSize]();
+            if (!fresh) {
+                return nullptr;
+            }
+            if (g_traffic[page].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel)) {
+                slots = fresh;
+            }
+            else {
+                delete[] fresh;
+            }
+        }
+        return &slots[idx & (kTrafficPageSize - 1)];
+    }
+
+    void reset_traffic(fd_t s) noexcept {
+        if (auto slot = find_traffic(s, true)) {
+            slot->bytes_sent.store(0, std::memory_order_relaxed);
+            slot->bytes_recv.store(0, std::memory_order_relaxed);
+            slot->send_calls.store(0, std::memory_order_relaxed);
+            slot->recv_calls.store(0, std::memory_order_relaxed);
+            slot->tracked.store(true, std::memory_order_release);
+        }
+    }
+
+    static void untrack_traffic(fd_t s) noexcept {
+        if (auto slot = find_traffic(s, false)) {
+            slot->tracked.store(false, std::memory_order_release);
+        }
+    }
+
+    void count_send(fd_t s, int rc) noexcept {
+        if (auto slot = find_traffic(s, false)) {
+            slot->send_calls.fetch_add(1, std::memory_order_relaxed);
+            if (rc > 0) {
+                slot->bytes_sent.fetch_add((uint64_t)rc, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void count_recv(fd_t s, int rc) noexcept {
+        if (auto slot = find_traffic(s, false)) {
+            slot->recv_calls.fetch_add(1, std::memory_order_relaxed);
+            if (rc > 0) {
+                slot->bytes_recv.fetch_add((uint64_t)rc, std::memory_order_relaxed);
+            }
+        }
+    }
+
     bool close(fd_t s) noexcept {
+        untrack_traffic(s);
 #if defined _WIN32
         const int ok = ::closesocket(s);
 #else
@@ -325,6 +407,7 @@ namespace bee::net::socket {
             return retired_fd;
         }
 #endif
+        reset_traffic(fd);
         return fd;
     }
 
@@ -384,6 +467,18 @@ namespace bee::net::socket {
             return setoption(s, SOL_SOCKET, SO_SNDBUF, value);
         case option::rcvbuf:
             return setoption(s, SOL_SOCKET, SO_RCVBUF, value);
+        case option::nodelay:
+            return setoption(s, IPPROTO_TCP, TCP_NODELAY, value);
+        case option::busy_poll:
+#if defined(SO_BUSY_POLL)
+            return setoption(s, SOL_SOCKET, SO_BUSY_POLL, value);
+#elif defined(_WIN32)
+            ::WSASetLastError(WSAENOPROTOOPT);
+            return false;
+#else
+            errno = ENOPROTOOPT;
+            return false;
+#endif
         default:
             std::unreachable();
         }
@@ -459,8 +554,7 @@ namespace bee::net::socket {
 #endif
     }
 
-    fdstat accept(fd_t s, fd_t& newfd, fd_flags fd_flags) noexcept {
-        newfd = acceptEx(s, fd_flags, NULL, NULL);
+    static fdstat accept_result(fd_t newfd) noexcept {
         if (newfd == retired_fd) {
 #if defined _WIN32
             return fdstat::failed;
@@ -473,11 +567,23 @@ namespace bee::net::socket {
             }
 #endif
         }
+        reset_traffic(newfd);
         return fdstat::success;
     }
 
+    fdstat accept(fd_t s, fd_t& newfd, fd_flags fd_flags) noexcept {
+        newfd = acceptEx(s, fd_flags, NULL, NULL);
+        return accept_result(newfd);
+    }
+
+    fdstat accept(fd_t s, fd_t& newfd, endpoint& ep, fd_flags fd_flags) noexcept {
+        newfd = acceptEx(s, fd_flags, ep.out_addr(), ep.out_addrlen());
+        return accept_result(newfd);
+    }
+
     status recv(fd_t s, int& rc, char* buf, int len) noexcept {
         rc = ::recv(s, buf, len, 0);
+        count_recv(s, rc);
         if (rc == 0) {
             return status::close;
         }
@@ -493,6 +599,7 @@ namespace bee::net::socket {
         flags |= MSG_NOSIGNAL;
 #endif
         rc = ::send(s, buf, len, flags);
+        count_send(s, rc);
         if (rc < 0) {
             return wait_finish() ? status::wait : status::failed;
         }
@@ -502,6 +609,7 @@ namespace bee::net::socket {
     expected<endpoint, status> recvfrom(fd_t s, int& rc, char* buf, int len) {
         endpoint ep;
         rc = ::recvfrom(s, buf, len, 0, ep.out_addr(), ep.out_addrlen());
+        count_recv(s, rc);
         if (rc == 0) {
             return unexpected(status::close);
         }
@@ -518,6 +626,7 @@ namespace bee::net::socket {
         flags |= MSG_NOSIGNAL;
 #endif
         rc = ::sendto(s, buf, len, flags, ep.addr(), ep.addrlen());
+        count_send(s, rc);
         if (rc < 0) {
             return wait_finish() ? status::wait : status::failed;
         }
@@ -690,6 +799,8 @@ namespace bee::net::socket {
         }
         sv[0] = temp[0];
         sv[1] = temp[1];
+        reset_traffic(sv[0]);
+        reset_traffic(sv[1]);
         return true;
     fail:
         internal_close(temp[0]);
@@ -701,7 +812,12 @@ namespace bee::net::socket {
             flags |= SOCK_NONBLOCK;
         }
         const int ok = ::socketpair(PF_UNIX, flags, 0, sv);
-        return net_success(ok);
+        if (!net_success(ok)) {
+            return false;
+        }
+        reset_traffic(sv[0]);
+        reset_traffic(sv[1]);
+        return true;
 #endif
     }
 
@@ -742,6 +858,8 @@ namespace bee::net::socket {
         }
         sv[0] = temp[0];
         sv[1] = temp[1];
+        reset_traffic(sv[0]);
+        reset_traffic(sv[1]);
         return true;
     fail:
         internal_close(temp[0]);
@@ -766,6 +884,95 @@ namespace bee::net::socket {
         return retired_fd;
 #else
         return ::dup(s);
+#endif
+    }
+
+    bool gettraffic(fd_t s, traffic& t) noexcept {
+        auto slot = find_traffic(s, false);
+        if (!slot || !slot->tracked.load(std::memory_order_acquire)) {
+            return false;
+        }
+        t.bytes_sent = slot->bytes_sent.load(std::memory_order_relaxed);
+        t.bytes_recv = slot->bytes_recv.load(std::memory_order_relaxed);
+        t.send_calls = slot->send_calls.load(std::memory_order_relaxed);
+        t.recv_calls = slot->recv_calls.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    bool gettcpinfo(fd_t s, tcpinfo& info) noexcept {
+#if defined(__linux__)
+        struct tcp_info ti;
+        socklen_t len = sizeof(ti);
+        if (!net_success(::getsockopt(s, IPPROTO_TCP, TCP_INFO, &ti, &len))) {
+            return false;
+        }
+        info.rtt     = ti.tcpi_rtt;
+        info.rttvar  = ti.tcpi_rttvar;
+        info.cwnd    = ti.tcpi_snd_cwnd;
+        info.retrans = ti.tcpi_total_retrans;
+        info.unacked = ti.tcpi_unacked;
+        return true;
+#elif defined(__APPLE__)
+        struct tcp_connection_info ti;
+        socklen_t len = sizeof(ti);
+        if (!net_success(::getsockopt(s, IPPROTO_TCP, TCP_CONNECTION_INFO, &ti, &len))) {
+            return false;
+        }
+        info.rtt     = ti.tcpi_srtt * 1000;
+        info.rttvar  = ti.tcpi_rttvar * 1000;
+        info.cwnd    = ti.tcpi_snd_cwnd;
+        info.retrans = (uint32_t)ti.tcpi_txretransmitpackets;
+        info.unacked = 0;
+        return true;
+#elif defined(__FreeBSD__)
+        struct tcp_info ti;
+        socklen_t len = sizeof(ti);
+        if (!net_success(::getsockopt(s, IPPROTO_TCP, TCP_INFO, &ti, &len))) {
+            return false;
+        }
+        info.rtt     = ti.tcpi_rtt;
+        info.rttvar  = ti.tcpi_rttvar;
+        info.cwnd    = ti.tcpi_snd_cwnd;
+        info.retrans = ti.tcpi_snd_rexmitpack;
+        info.unacked = 0;
+        return true;
+#else
+        (void)s;
+        (void)info;
+        return false;
+#endif
+    }
+
+    bool getqueue(fd_t s, int& inq, int& outq) noexcept {
+#if defined(_WIN32)
+        u_long n = 0;
+        if (!net_success(::ioctlsocket(s, FIONREAD, &n))) {
+            return false;
+        }
+        inq  = (int)n;
+        outq = -1;
+        return true;
+#elif defined(__linux__)
+        if (!net_success(::ioctl(s, SIOCINQ, &inq))) {
+            return false;
+        }
+        if (!net_success(::ioctl(s, SIOCOUTQ, &outq))) {
+            return false;
+        }
+        return true;
+#else
+        if (!net_success(::ioctl(s, FIONREAD, &inq))) {
+            return false;
+        }
+#    if defined(SO_NWRITE)
+        socklen_t len = sizeof(outq);
+        if (!net_success(::getsockopt(s, SOL_SOCKET, SO_NWRITE, &outq, &len))) {
+            outq = -1;
+        }
+#    else
+        outq = -1;
+#    endif
+        return true;
 #endif
     }
 }
@@ -3,6 +3,7 @@
 #include <bee/net/fd.h>
 #include <bee/nonstd/expected.h>
 
+#include <cstdint>
 #include <optional>
 #include <system_error>
 
@@ -42,6 +43,8 @@ namespace bee::net::socket {
         reuseaddr = 0,
         sndbuf,
         rcvbuf,
+        nodelay,
+        busy_poll,
     };
 
     enum class fd_flags {
@@ -49,6 +52,21 @@ namespace bee::net::socket {
         nonblock,
     };
 
+    struct traffic {
+        uint64_t bytes_sent = 0;
+        uint64_t bytes_recv = 0;
+        uint64_t send_calls = 0;
+        uint64_t recv_calls = 0;
+    };
+
+    struct tcpinfo {
+        uint32_t rtt     = 0;
+        uint32_t rttvar  = 0;
+        uint32_t cwnd    = 0;
+        uint32_t retrans = 0;
+        uint32_t unacked = 0;
+    };
+
     bool initialize() noexcept;
     fd_t open(protocol protocol, fd_flags flags = fd_flags::nonblock);
     bool pair(fd_t sv[2], fd_flags flags = fd_flags::nonblock);
@@ -61,6 +79,7 @@ namespace bee::net::socket {
     bool listen(fd_t s, int backlog) noexcept;
     fdstat connect(fd_t s, const endpoint& ep);
     fdstat accept(fd_t s, fd_t& newfd, fd_flags flags = fd_flags::nonblock) noexcept;
+    fdstat accept(fd_t s, fd_t& newfd, endpoint& ep, fd_flags flags = fd_flags::nonblock) noexcept;
     status recv(fd_t s, int& rc, char* buf, int len) noexcept;
     status send(fd_t s, int& rc, const char* buf, int len) noexcept;
     expected<endpoint, status> recvfrom(fd_t s, int& rc, char* buf, int len);
@@ -70,4 +89,10 @@ namespace bee::net::socket {
     bool unlink(const endpoint& ep);
     std::error_code errcode(fd_t s) noexcept;
     fd_t dup(fd_t s) noexcept;
+    bool gettraffic(fd_t s, traffic& t) noexcept;
+    void count_send(fd_t s, int rc) noexcept;
+    void count_recv(fd_t s, int rc) noexcept;
+    void reset_traffic(fd_t s) noexcept;
+    bool gettcpinfo(fd_t s, tcpinfo& info) noexcept;
+    bool getqueue(fd_t s, int& inq, int& outq) noexcept;
 }
@@ -0,0 +1,214 @@
+#include <bee/subprocess/output_log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#    include <Windows.h>
+#else
+#    include <errno.h>
+#    include <unistd.h>
+#endif
+
+namespace bee::subprocess {
+    static FILE* open_log(const fs::path& path, bool append) noexcept {
+#if defined(_WIN32)
+        return _wfopen(path.c_str(), append ? L"ab" : L"wb");
+#else
+        return fopen(path.c_str(), append ? "ab" : "wb");
+#endif
+    }
+
+    static fs::path backup_path(const fs::path& path, int n) {
+        fs::path r = path;
+        r += "." + std::to_string(n);
+        return r;
+    }
+
+    std::shared_ptr<output_log> output_log::start(file_handle rd, options&& opts) noexcept {
+        FILE* f = open_log(opts.path, true);
+        if (!f) {
+            rd.close();
+            return nullptr;
+        }
+        std::shared_ptr<output_log> self;
+        try {
+            self = std::make_shared<output_log>(rd, f, std::move(opts));
+        } catch (...) {
+            fclose(f);
+            rd.close();
+            return nullptr;
+        }
+        try {
+            std::thread([self]() { self->run(); }).detach();
+        } catch (...) {
+            return nullptr;
+        }
+        return self;
+    }
+
+    output_log::output_log(file_handle rd, FILE* f, options&& opts) noexcept
+        : rd_(rd)
+        , file_(f)
+        , opts_(std::move(opts)) {
+        if (fseek(file_, 0, SEEK_END) == 0) {
+            long pos = ftell(file_);
+            size_    = pos > 0 ? (uint64_t)pos : 0;
+        }
+    }
+
+    output_log::~output_log() noexcept {
+        if (file_) {
+            fclose(file_);
+        }
+        rd_.close();
+    }
+
+    void output_log::run() noexcept {
+        char buf[64 * 1024];
+        for (;;) {
+#if defined(_WIN32)
+            DWORD n = 0;
+            if (!::ReadFile(rd_.value(), buf, sizeof(buf), &n, NULL) || n == 0) {
+                break;
+            }
+#else
+            ssize_t n = ::read(rd_.value(), buf, sizeof(buf));
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+#endif
+            append(buf, (size_t)n);
+        }
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+        rd_.close();
+        std::unique_lock<std::mutex> lk(mutex_);
+        finished_ = true;
+        finished_cv_.notify_all();
+    }
+
+    // Files never grow past rotate_bytes. A chunk that does not fit is split
+    // after its last line break that does, so lines are not cut in two unless
+    // a single line is longer than the limit.
+    void output_log::write(const char* data, size_t len) noexcept {
+        while (len > 0) {
+            size_t n = len;
+            if (opts_.rotate_bytes > 0) {
+                if (size_ >= opts_.rotate_bytes) {
+                    rotate();
+                }
+                size_t room = (size_t)(opts_.rotate_bytes - size_);
+                if (n > room) {
+                    const char* nl = nullptr;
+                    for (size_t i = room; i > 0; --i) {
+                        if (data[i - 1] == '\n') {
+                            nl = data + i;
+                            break;
+                        }
+                    }
+                    if (nl) {
+                        n = (size_t)(nl - data);
+                    }
+                    else if (size_ > 0) {
+                        rotate();
+                        continue;
+                    }
+                    else {
+                        n = room;
+                    }
+                }
+            }
+            if (file_) {
+                fwrite(data, 1, n, file_);
+            }
+            size_ += n;
+            data += n;
+            len -= n;
+        }
+        if (file_) {
+            fflush(file_);
+        }
+    }
+
+    void output_log::append(const char* data, size_t len) noexcept {
+        write(data, len);
+        bytes_.fetch_add(len, std::memory_order_relaxed);
+        const size_t cap = opts_.keep_tail;
+        if (cap == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (len >= cap) {
+            ring_.assign(data + len - cap, cap);
+            ring_pos_ = 0;
+            return;
+        }
+        if (ring_.size() < cap) {
+            size_t n = (std::min)(cap - ring_.size(), len);
+            ring_.append(data, n);
+            data += n;
+            len -= n;
+        }
+        while (len > 0) {
+            size_t n = (std::min)(cap - ring_pos_, len);
+            memcpy(ring_.data() + ring_pos_, data, n);
+            ring_pos_ = (ring_pos_ + n) % cap;
+            data += n;
+            len -= n;
+        }
+    }
+
+    void output_log::rotate() noexcept {
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+        std::error_code ec;
+        if (opts_.rotate_files > 0) {
+            for (int i = opts_.rotate_files - 1; i >= 1; --i) {
+                fs::rename(backup_path(opts_.path, i), backup_path(opts_.path, i + 1), ec);
+            }
+            fs::rename(opts_.path, backup_path(opts_.path, 1), ec);
+        }
+        file_ = open_log(opts_.path, false);
+        size_ = 0;
+        rotations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string output_log::tail() const {
+        std::unique_lock<std::mutex> lk(mutex_);
+        std::string r;
+        r.reserve(ring_.size());
+        r.append(ring_, ring_pos_, std::string::npos);
+        r.append(ring_, 0, ring_pos_);
+        return r;
+    }
+
+    uint64_t output_log::bytes() const noexcept {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+    uint32_t output_log::rotations() const noexcept {
+        return rotations_.load(std::memory_order_relaxed);
+    }
+
+    bool output_log::wait(int timeout) noexcept {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (timeout < 0) {
+            finished_cv_.wait(lk, [this] { return finished_; });
+        }
+        else {
+            finished_cv_.wait_for(lk, std::chrono::milliseconds(timeout), [this] { return finished_; });
+        }
+        return finished_;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <bee/nonstd/filesystem.h>
+#include <bee/utility/file_handle.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace bee::subprocess {
+    // Drains the read end of a child's output pipe on its own thread into a
+    // log file, rotating it by size, and keeps the last keep_tail bytes in
+    // memory. The thread holds a reference, so the log outlives its owner
+    // until the child closes the pipe.
+    class output_log : public std::enable_shared_from_this<output_log> {
+    public:
+        struct options {
+            fs::path path;
+            uint64_t rotate_bytes = 0;
+            size_t keep_tail      = 0;
+            int rotate_files      = 1;
+        };
+
+        static std::shared_ptr<output_log> start(file_handle rd, options&& opts) noexcept;
+        output_log(file_handle rd, FILE* f, options&& opts) noexcept;
+        ~output_log() noexcept;
+        output_log(const output_log&)            = delete;
+        output_log& operator=(const output_log&) = delete;
+
+        std::string tail() const;
+        uint64_t bytes() const noexcept;
+        uint32_t rotations() const noexcept;
+        bool wait(int timeout) noexcept;
+
+    private:
+        void run() noexcept;
+        void append(const char* data, size_t len) noexcept;
+        void write(const char* data, size_t len) noexcept;
+        void rotate() noexcept;
+
+    private:
+        file_handle rd_;
+        FILE* file_;
+        options opts_;
+        uint64_t size_ = 0;
+        std::atomic<uint64_t> bytes_ { 0 };
+        std::atomic<uint32_t> rotations_ { 0 };
+        mutable std::mutex mutex_;
+        std::condition_variable finished_cv_;
+        bool finished_ = false;
+        std::string ring_;
+        size_t ring_pos_ = 0;
+    };
+}
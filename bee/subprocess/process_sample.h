@@ -0,0 +1,24 @@
+#pragma once
+
+#include <bee/subprocess.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace bee::subprocess {
+    struct process_sample {
+        uint64_t user_time   = 0; // microseconds
+        uint64_t system_time = 0; // microseconds
+        uint64_t rss         = 0; // bytes
+        uint64_t read_bytes  = 0;
+        uint64_t write_bytes = 0;
+        uint32_t threads     = 0;
+        uint32_t processes   = 0;
+    };
+
+    // One entry per pid, std::nullopt when the process cannot be sampled. With
+    // tree, every descendant of a pid is added into its entry; the process table
+    // is walked once per call however many pids are given.
+    std::vector<std::optional<process_sample>> sample_processes(const std::vector<process_id>& pids, bool tree);
+}
@@ -0,0 +1,7 @@
+#include <bee/subprocess/process_sample.h>
+
+namespace bee::subprocess {
+    std::vector<std::optional<process_sample>> sample_processes(const std::vector<process_id>& pids, bool) {
+        return std::vector<std::optional<process_sample>>(pids.size());
+    }
+}
@@ -0,0 +1,208 @@
+#include <bee/subprocess/process_sample.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+namespace bee::subprocess {
+    struct proc_stat {
+        pid_t ppid       = 0;
+        uint64_t utime   = 0;
+        uint64_t stime   = 0;
+        uint64_t rss     = 0;
+        uint32_t threads = 0;
+    };
+
+    static bool read_file(const char* path, char* buf, size_t size) noexcept {
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+        ssize_t n;
+        do
+            n = ::read(fd, buf, size - 1);
+        while (n == -1 && errno == EINTR);
+        ::close(fd);
+        if (n <= 0) {
+            return false;
+        }
+        buf[n] = '\0';
+        return true;
+    }
+
+    // /proc/<pid>/stat: "pid (comm) state ppid ...". comm may contain spaces and
+    // parentheses, so fields are counted from the last ')'. rss here is the same
+    // resident count that statm reports, so statm does not need a second read.
+    static bool read_stat(pid_t pid, proc_stat& st) noexcept {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+        char buf[1024];
+        if (!read_file(path, buf, sizeof(buf))) {
+            return false;
+        }
+        const char* p = strrchr(buf, ')');
+        if (!p) {
+            return false;
+        }
+        p++;
+        // field 3 (state) is index 0
+        for (int field = 0; field <= 21; ++field) {
+            while (*p == ' ') {
+                p++;
+            }
+            if (*p == '\0') {
+                return false;
+            }
+            char* end;
+            switch (field) {
+            case 1:
+                st.ppid = (pid_t)strtol(p, &end, 10);
+                p       = end;
+                break;
+            case 11:
+                st.utime = strtoull(p, &end, 10);
+                p        = end;
+                break;
+            case 12:
+                st.stime = strtoull(p, &end, 10);
+                p        = end;
+                break;
+            case 17:
+                st.threads = (uint32_t)strtoul(p, &end, 10);
+                p          = end;
+                break;
+            case 21:
+                st.rss = strtoull(p, &end, 10);
+                p      = end;
+                break;
+            default:
+                while (*p && *p != ' ') {
+                    p++;
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    static void read_io(pid_t pid, process_sample& s) noexcept {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+        char buf[512];
+        if (!read_file(path, buf, sizeof(buf))) {
+            return;
+        }
+        const char* line = buf;
+        while (line) {
+            // storage I/O, like the other platforms; rchar/wchar would also
+            // count pipes, sockets and page cache hits
+            if (strncmp(line, "read_bytes: ", 12) == 0) {
+                s.read_bytes += strtoull(line + 12, nullptr, 10);
+            }
+            else if (strncmp(line, "write_bytes: ", 13) == 0) {
+                s.write_bytes += strtoull(line + 13, nullptr, 10);
+            }
+            line = strchr(line, '\n');
+            if (line) {
+                line++;
+            }
+        }
+    }
+
+    struct proc_units {
+        uint64_t ticks_per_sec;
+        uint64_t page_size;
+        proc_units() noexcept {
+            long tck      = sysconf(_SC_CLK_TCK);
+            long page     = sysconf(_SC_PAGESIZE);
+            ticks_per_sec = tck > 0 ? (uint64_t)tck : 100;
+            page_size     = page > 0 ? (uint64_t)page : 4096;
+        }
+    };
+
+    static void add_sample(pid_t pid, const proc_stat& st, process_sample& s) noexcept {
+        static proc_units units;
+        s.user_time += st.utime * 1000000 / units.ticks_per_sec;
+        s.system_time += st.stime * 1000000 / units.ticks_per_sec;
+        s.rss += st.rss * units.page_size;
+        s.threads += st.threads;
+        s.processes++;
+        read_io(pid, s);
+    }
+
+    static bool is_pid(const char* name) noexcept {
+        if (*name == '\0') {
+            return false;
+        }
+        for (; *name; ++name) {
+            if (*name < '0' || *name > '9') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void scan_proc(std::unordered_map<pid_t, proc_stat>& table) {
+        DIR* dir = opendir("/proc");
+        if (!dir) {
+            return;
+        }
+        while (struct dirent* e = readdir(dir)) {
+            if (!is_pid(e->d_name)) {
+                continue;
+            }
+            pid_t pid = (pid_t)atoi(e->d_name);
+            proc_stat st;
+            if (read_stat(pid, st)) {
+                table.emplace(pid, st);
+            }
+        }
+        closedir(dir);
+    }
+
+    std::vector<std::optional<process_sample>> sample_processes(const std::vector<process_id>& pids, bool tree) {
+        std::vector<std::optional<process_sample>> result(pids.size());
+        if (!tree) {
+            for (size_t i = 0; i < pids.size(); ++i) {
+                proc_stat st;
+                if (read_stat(pids[i], st)) {
+                    process_sample s;
+                    add_sample(pids[i], st, s);
+                    result[i] = s;
+                }
+            }
+            return result;
+        }
+        std::unordered_map<pid_t, proc_stat> table;
+        scan_proc(table);
+        std::unordered_multimap<pid_t, pid_t> children;
+        for (auto const& [pid, st] : table) {
+            children.emplace(st.ppid, pid);
+        }
+        std::vector<pid_t> queue;
+        for (size_t i = 0; i < pids.size(); ++i) {
+            auto it = table.find(pids[i]);
+            if (it == table.end()) {
+                continue;
+            }
+            process_sample s;
+            queue.clear();
+            queue.push_back(pids[i]);
+            for (size_t j = 0; j < queue.size(); ++j) {
+                pid_t pid = queue[j];
+                add_sample(pid, table[pid], s);
+                auto range = children.equal_range(pid);
+                for (auto c = range.first; c != range.second; ++c) {
+                    queue.push_back(c->second);
+                }
+            }
+            result[i] = s;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,87 @@
+#include <TargetConditionals.h>
+#include <bee/subprocess/process_sample.h>
+
+#if TARGET_OS_IPHONE
+
+namespace bee::subprocess {
+    std::vector<std::optional<process_sample>> sample_processes(const std::vector<process_id>& pids, bool) {
+        return std::vector<std::optional<process_sample>>(pids.size());
+    }
+}
+
+#else
+
+#    include <libproc.h>
+#    include <mach/mach_time.h>
+#    include <sys/resource.h>
+
+#    include <algorithm>
+
+namespace bee::subprocess {
+    // task times are in mach absolute time units, which are not nanoseconds on arm64
+    static uint64_t mach_to_us(uint64_t t) noexcept {
+        static mach_timebase_info_data_t tb = []() {
+            mach_timebase_info_data_t info;
+            if (mach_timebase_info(&info) != KERN_SUCCESS || info.denom == 0) {
+                info.numer = 1;
+                info.denom = 1;
+            }
+            return info;
+        }();
+        return t * tb.numer / tb.denom / 1000;
+    }
+
+    static bool add_sample(pid_t pid, process_sample& s) noexcept {
+        struct proc_taskinfo ti;
+        if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) != sizeof(ti)) {
+            return false;
+        }
+        s.user_time += mach_to_us(ti.pti_total_user);
+        s.system_time += mach_to_us(ti.pti_total_system);
+        s.rss += ti.pti_resident_size;
+        s.threads += (uint32_t)ti.pti_threadnum;
+        s.processes++;
+        rusage_info_v2 ru;
+        if (proc_pid_rusage(pid, RUSAGE_INFO_V2, (rusage_info_t*)&ru) == 0) {
+            s.read_bytes += ru.ri_diskio_bytesread;
+            s.write_bytes += ru.ri_diskio_byteswritten;
+        }
+        return true;
+    }
+
+    static void add_children(pid_t pid, process_sample& s, std::vector<pid_t>& buf) {
+        int n = proc_listchildpids(pid, nullptr, 0);
+        if (n <= 0) {
+            return;
+        }
+        buf.resize((size_t)n + 16);
+        n = proc_listchildpids(pid, buf.data(), (int)(buf.size() * sizeof(pid_t)));
+        if (n <= 0) {
+            return;
+        }
+        std::vector<pid_t> list(buf.begin(), buf.begin() + std::min((size_t)n, buf.size()));
+        for (pid_t child : list) {
+            if (add_sample(child, s)) {
+                add_children(child, s, buf);
+            }
+        }
+    }
+
+    std::vector<std::optional<process_sample>> sample_processes(const std::vector<process_id>& pids, bool tree) {
+        std::vector<std::optional<process_sample>> result(pids.size());
+        std::vector<pid_t> buf;
+        for (size_t i = 0; i < pids.size(); ++i) {
+            process_sample s;
+            if (!add_sample(pids[i], s)) {
+                continue;
+            }
+            if (tree) {
+                add_children(pids[i], s, buf);
+            }
+            result[i] = s;
+        }
+        return result;
+    }
+}
+
+#endif
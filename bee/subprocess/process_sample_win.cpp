@@ -0,0 +1,135 @@
+#include <Windows.h>
+#include <bee/subprocess/process_sample.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace bee::subprocess {
+    struct proc_entry {
+        DWORD ppid;
+        DWORD threads;
+    };
+
+    static uint64_t filetime_us(const FILETIME& ft) noexcept {
+        ULARGE_INTEGER v;
+        v.LowPart  = ft.dwLowDateTime;
+        v.HighPart = ft.dwHighDateTime;
+        return v.QuadPart / 10;
+    }
+
+    static void add_sample(DWORD pid, DWORD threads, process_sample& s) noexcept {
+        s.threads += threads;
+        s.processes++;
+        HANDLE h = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!h) {
+            return;
+        }
+        FILETIME creation, exit, kernel, user;
+        if (::GetProcessTimes(h, &creation, &exit, &kernel, &user)) {
+            s.user_time += filetime_us(user);
+            s.system_time += filetime_us(kernel);
+        }
+        PROCESS_MEMORY_COUNTERS mem;
+        if (::K32GetProcessMemoryInfo(h, &mem, sizeof(mem))) {
+            s.rss += mem.WorkingSetSize;
+        }
+        IO_COUNTERS io;
+        if (::GetProcessIoCounters(h, &io)) {
+            s.read_bytes += io.ReadTransferCount;
+            s.write_bytes += io.WriteTransferCount;
+        }
+        ::CloseHandle(h);
+    }
+
+    static uint64_t creation_time(DWORD pid) noexcept {
+        HANDLE h = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!h) {
+            return 0;
+        }
+        uint64_t t = 0;
+        FILETIME creation, exit, kernel, user;
+        if (::GetProcessTimes(h, &creation, &exit, &kernel, &user)) {
+            t = filetime_us(creation);
+        }
+        ::CloseHandle(h);
+        return t;
+    }
+
+    // One toolhelp snapshot gives the parent and thread count of every process.
+    static bool scan_processes(std::unordered_map<DWORD, proc_entry>& table) {
+        HANDLE snapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        PROCESSENTRY32W e;
+        e.dwSize = sizeof(e);
+        for (BOOL ok = ::Process32FirstW(snapshot, &e); ok; ok = ::Process32NextW(snapshot, &e)) {
+            table.emplace(e.th32ProcessID, proc_entry { e.th32ParentProcessID, e.cntThreads });
+        }
+        ::CloseHandle(snapshot);
+        return true;
+    }
+
+    std::vector<std::optional<process_sample>> sample_processes(const std::vector<process_id>& pids, bool tree) {
+        std::vector<std::optional<process_sample>> result(pids.size());
+        std::unordered_map<DWORD, proc_entry> table;
+        if (!scan_processes(table)) {
+            return result;
+        }
+        std::unordered_multimap<DWORD, DWORD> children;
+        if (tree) {
+            for (auto const& [pid, e] : table) {
+                // the idle process is its own parent
+                if (pid != e.ppid) {
+                    children.emplace(e.ppid, pid);
+                }
+            }
+        }
+        std::vector<DWORD> queue;
+        std::unordered_set<DWORD> visited;
+        std::unordered_map<DWORD, uint64_t> created;
+        auto started = [&](DWORD pid) {
+            auto [it, inserted] = created.try_emplace(pid, 0);
+            if (inserted) {
+                it->second = creation_time(pid);
+            }
+            return it->second;
+        };
+        for (size_t i = 0; i < pids.size(); ++i) {
+            if (table.find(pids[i]) == table.end()) {
+                continue;
+            }
+            process_sample s;
+            queue.clear();
+            visited.clear();
+            queue.push_back(pids[i]);
+            visited.insert(pids[i]);
+            for (size_t j = 0; j < queue.size(); ++j) {
+                DWORD pid = queue[j];
+                add_sample(pid, table[pid].threads, s);
+                // parent ids are not cleared when a parent exits, so a later
+                // process can reuse the pid and inherit the orphans. Real
+                // children are created after their parent; skipping older
+                // ones also breaks the cycles pid reuse can form.
+                auto range = children.equal_range(pid);
+                if (range.first == range.second) {
+                    continue;
+                }
+                uint64_t parent = started(pid);
+                for (auto c = range.first; c != range.second; ++c) {
+                    uint64_t child = started(c->second);
+                    if (parent && child && child < parent) {
+                        continue;
+                    }
+                    if (visited.insert(c->second).second) {
+                        queue.push_back(c->second);
+                    }
+                }
+            }
+            result[i] = s;
+        }
+        return result;
+    }
+}
@@ -61,11 +61,14 @@ namespace bee::subprocess {
         return { envs };
     }
 
-    environment envbuilder::release() {
+    environment envbuilder::release(bool snapshot) {
         char** es = environ;
         if (es == 0) {
             return nullptr;
         }
+        if (set_env_.empty() && !snapshot) {
+            return nullptr;
+        }
         std::vector<char*> envs;
         for (; *es; ++es) {
             std::string str = *es;
@@ -129,7 +132,12 @@ namespace bee::subprocess {
     }
 
     void spawn::env(environment&& env) {
-        env_ = std::move(env);
+        env_  = std::move(env);
+        envp_ = env_;
+    }
+
+    void spawn::share_env(environment& env) {
+        envp_ = env;
     }
 
 #if defined(__ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__) && __ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__ >= 101500
@@ -182,7 +190,7 @@ namespace bee::subprocess {
             errno = err;
             return false;
         }
-        if (int err = posix_spawnp(&pid, arguments[0], &actions, &attr, arguments, env_)) {
+        if (int err = posix_spawnp(&pid, arguments[0], &actions, &attr, arguments, envp_ ? envp_ : environ)) {
             posix_spawn_file_actions_destroy(&actions);
             posix_spawnattr_destroy(&attr);
             errno = err;
@@ -213,8 +221,8 @@ namespace bee::subprocess {
                     }
                 }
             }
-            if (env_) {
-                environ = env_;
+            if (envp_) {
+                environ = envp_;
             }
             if (cwd && chdir(cwd)) {
                 _exit(127);
@@ -13,7 +13,7 @@ namespace bee::subprocess {
     public:
         void set(const std::string& key, const std::string& value);
         void del(const std::string& key);
-        environment release();
+        environment release(bool snapshot = false);
 
     private:
         std::map<std::string, std::optional<std::string>> set_env_;
@@ -71,10 +71,12 @@ namespace bee::subprocess {
         void detached();
         void redirect(stdio type, file_handle f);
         void env(environment&& env);
+        void share_env(environment& env);
         bool exec(args_t& args, const char* cwd);
 
     private:
         environment env_ = nullptr;
+        char** envp_     = nullptr;
         int fds_[3];
         pid_t pid_       = -1;
         short spawnattr_ = 0;
@@ -163,12 +163,12 @@ namespace bee::subprocess {
         envs += L"\0";
     }
 
-    environment envbuilder::release() {
+    environment envbuilder::release(bool snapshot) {
         EnvironmentStrings es;
         if (!es) {
             return nullptr;
         }
-        if (set_env_.empty()) {
+        if (set_env_.empty() && !snapshot) {
             return nullptr;
         }
         strbuilder<wchar_t> res(1024);
@@ -363,7 +363,7 @@ namespace bee::subprocess {
             return false;
         }
         const wchar_t* application = search_path_ ? 0 : args[0].c_str();
-        if (env_) {
+        if (envp_) {
             flags_ |= CREATE_UNICODE_ENVIRONMENT;
         }
         STARTUPINFOW si;
@@ -383,7 +383,7 @@ namespace bee::subprocess {
             si.dwFlags |= STARTF_USESHOWWINDOW;
             si.wShowWindow = SW_HIDE;
         }
-        if (!::CreateProcessW(application, command_line.data(), NULL, NULL, inherit_handle_, flags_ | NORMAL_PRIORITY_CLASS, env_, cwd, &si, (LPPROCESS_INFORMATION)&pi_)) {
+        if (!::CreateProcessW(application, command_line.data(), NULL, NULL, inherit_handle_, flags_ | NORMAL_PRIORITY_CLASS, envp_, cwd, &si, (LPPROCESS_INFORMATION)&pi_)) {
             startupinfo_release(si);
             return false;
         }
@@ -398,7 +398,12 @@ namespace bee::subprocess {
     }
 
     void spawn::env(environment&& env) noexcept {
-        env_ = std::move(env);
+        env_  = std::move(env);
+        envp_ = env_;
+    }
+
+    void spawn::share_env(environment& env) noexcept {
+        envp_ = env;
     }
 
     static_assert(sizeof(PROCESS_INFORMATION) == sizeof(process));
@@ -37,7 +37,7 @@ namespace bee::subprocess {
     public:
         void set(const std::wstring& key, const std::wstring& value);
         void del(const std::wstring& key);
-        environment release();
+        environment release(bool snapshot = false);
 
     private:
         using less = ignore_case::less<std::wstring>;
@@ -108,10 +108,12 @@ namespace bee::subprocess {
         void detached() noexcept;
         void redirect(stdio type, file_handle h) noexcept;
         void env(environment&& env) noexcept;
+        void share_env(environment& env) noexcept;
         bool exec(const args_t& args, const wchar_t* cwd);
 
     private:
         environment env_ = nullptr;
+        wchar_t* envp_   = nullptr;
         process pi_;
         os_handle fds_[3];
         uint32_t flags_      = 0;
@@ -0,0 +1,109 @@
+#include <bee/thread/adaptive_mutex.h>
+#include <bee/thread/kernel_wait.h>
+#include <bee/thread/simplethread.h>
+#include <bee/thread/spinlock.h>
+
+#include <chrono>
+
+namespace bee {
+    static constexpr int16_t kMaxSpins = 100;
+
+    uint64_t lockstats::now() noexcept {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void adaptive_mutex::lock() noexcept {
+        value_type expected = UNLOCKED;
+        if (state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            if (lockstats::active(stats)) {
+                stats->acquires.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+        if (!lockstats::active(stats)) {
+            lock_slow(nullptr);
+            return;
+        }
+        uint64_t start = lockstats::now();
+        lock_slow(stats);
+        stats->acquires.fetch_add(1, std::memory_order_relaxed);
+        stats->contended.fetch_add(1, std::memory_order_relaxed);
+        stats->wait_ns.fetch_add(lockstats::now() - start, std::memory_order_relaxed);
+    }
+
+    void adaptive_mutex::lock_slow(lockstats* profile) noexcept {
+        // Same estimator as glibc's PTHREAD_MUTEX_ADAPTIVE_NP: spin up to twice the recent average.
+        const int16_t avg    = spins.load(std::memory_order_relaxed);
+        const int16_t budget = (int16_t)(avg * 2 + 10 < kMaxSpins ? avg * 2 + 10 : kMaxSpins);
+        value_type c         = LOCKED;
+        int16_t n            = 0;
+        while (n < budget) {
+            ++n;
+            cpu_relax();
+            c = state.load(std::memory_order_relaxed);
+            if (c == UNLOCKED && state.compare_exchange_weak(c, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+                spins.store((int16_t)(avg + (n - avg) / 8), std::memory_order_relaxed);
+                if (profile) {
+                    profile->spins.fetch_add(n, std::memory_order_relaxed);
+                }
+                return;
+            }
+            if (c == PARKED) {
+                break;
+            }
+        }
+        spins.store((int16_t)(avg + (n - avg) / 8), std::memory_order_relaxed);
+        if (profile) {
+            profile->spins.fetch_add(n, std::memory_order_relaxed);
+        }
+#if !defined(BEE_NO_KERNEL_WAIT)
+        if (c != PARKED) {
+            c = state.exchange(PARKED, std::memory_order_acquire);
+        }
+        while (c != UNLOCKED) {
+            if (profile) {
+                profile->parks.fetch_add(1, std::memory_order_relaxed);
+            }
+            kernel_wait((const value_type*)&state, PARKED);
+            c = state.exchange(PARKED, std::memory_order_acquire);
+        }
+#else
+        for (int i = 0;; ++i) {
+            c = UNLOCKED;
+            if (state.compare_exchange_weak(c, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return;
+            }
+            if (profile) {
+                profile->parks.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (i < 8) {
+                thread_yield();
+            }
+            else {
+                thread_sleep(1);
+            }
+        }
+#endif
+    }
+
+    void adaptive_mutex::unlock() noexcept {
+#if !defined(BEE_NO_KERNEL_WAIT)
+        if (state.exchange(UNLOCKED, std::memory_order_release) == PARKED) {
+            kernel_wake((const value_type*)&state, false);
+        }
+#else
+        state.store(UNLOCKED, std::memory_order_release);
+#endif
+    }
+
+    bool adaptive_mutex::try_lock() noexcept {
+        value_type expected = UNLOCKED;
+        if (state.load(std::memory_order_relaxed) == UNLOCKED && state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            if (lockstats::active(stats)) {
+                stats->acquires.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bee/thread/atomic_semaphore.h>
+#include <bee/thread/lockstats.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace bee {
+    // Spins for a bounded, self-tuning number of iterations and then parks the thread in the kernel.
+    class adaptive_mutex {
+    public:
+        using value_type = atomic_semaphore::value_type;
+
+        adaptive_mutex() noexcept = default;
+        explicit adaptive_mutex(lockstats* stats) noexcept
+            : stats(stats) {}
+        adaptive_mutex(const adaptive_mutex&)            = delete;
+        adaptive_mutex& operator=(const adaptive_mutex&) = delete;
+        void lock() noexcept;
+        void unlock() noexcept;
+        bool try_lock() noexcept;
+
+    private:
+        void lock_slow(lockstats* profile) noexcept;
+
+        static constexpr value_type UNLOCKED = 0;
+        static constexpr value_type LOCKED   = 1;
+        static constexpr value_type PARKED   = 2;
+
+        std::atomic<value_type> state = UNLOCKED;
+        std::atomic<int16_t> spins    = 0;
+        lockstats* stats              = nullptr;
+    };
+}
@@ -1,64 +1,18 @@
 #include <bee/thread/atomic_semaphore.h>
+#include <bee/thread/kernel_wait.h>
 #include <bee/thread/simplethread.h>
 #include <bee/thread/spinlock.h>
 
-#include <type_traits>
-
-#if defined(_WIN32)
-#    include <Windows.h>
-#elif defined(__linux__)
-#    include <linux/futex.h>
-#    include <sys/syscall.h>
-#    include <unistd.h>
-
-#    include <climits>
-#endif
-
 namespace bee {
-
-#if defined(_WIN32)
-    template <typename T, std::enable_if_t<sizeof(T) <= 8, int> = 0>
-    void kernel_wait(const T* ptr, T val) {
-        WaitOnAddress((PVOID)ptr, (PVOID)&val, sizeof(T), INFINITE);
-    }
-    template <typename T, std::enable_if_t<sizeof(T) <= 8, int> = 0>
-    void kernel_wake(const T* ptr, bool all) {
-        if (all)
-            WakeByAddressAll((PVOID)ptr);
-        else
-            WakeByAddressSingle((PVOID)ptr);
-    }
-#elif defined(__linux__)
-    template <typename T, std::enable_if_t<std::is_same_v<T, uint32_t>, int> = 0>
-    void kernel_wait(const T* ptr, T val) {
-        syscall(SYS_futex, ptr, FUTEX_WAIT_PRIVATE, val, nullptr, 0, 0);
-    }
-    template <typename T, std::enable_if_t<std::is_same_v<T, uint32_t>, int> = 0>
-    void kernel_wake(const T* ptr, bool all) {
-        syscall(SYS_futex, ptr, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, 0, 0, 0);
-    }
-#elif defined(BEE_USE_ULOCK)
-    extern "C" int __ulock_wait(uint32_t operation, void* addr, uint64_t value, uint32_t timeout);
-    extern "C" int __ulock_wake(uint32_t operation, void* addr, uint64_t wake_value);
-    constexpr uint32_t UL_COMPARE_AND_WAIT = 1;
-    constexpr uint32_t ULF_WAKE_ALL        = 0x00000100;
-    template <typename T, std::enable_if_t<std::is_same_v<T, uint64_t>, int> = 0>
-    void kernel_wait(const T* ptr, T val) {
-        __ulock_wait(UL_COMPARE_AND_WAIT, const_cast<T*>(ptr), val, 0);
-    }
-    template <typename T, std::enable_if_t<std::is_same_v<T, uint64_t>, int> = 0>
-    void kernel_wake(const T* ptr, bool all) {
-        __ulock_wake(UL_COMPARE_AND_WAIT | (all ? ULF_WAKE_ALL : 0), const_cast<T*>(ptr), 0);
-    }
-#else
-    // TODO *bsd
-#    define BEE_NO_KERNEL_WAIT
-#endif
-
     atomic_semaphore::atomic_semaphore() noexcept
         : v(SEM_FALSE) {
     }
 
+    atomic_semaphore::atomic_semaphore(lockstats* stats) noexcept
+        : v(SEM_FALSE)
+        , stats(stats) {
+    }
+
     void atomic_semaphore::release() noexcept {
 #if !defined(BEE_NO_KERNEL_WAIT)
         const auto* ptr = &v;
@@ -69,28 +23,59 @@ namespace bee {
 #endif
     }
 
-    void atomic_semaphore::acquire() noexcept {
+    bool atomic_semaphore::acquire() noexcept {
+        if (v.exchange(SEM_FALSE) == SEM_TRUE) {
+            if (lockstats::active(stats)) {
+                stats->acquires.fetch_add(1, std::memory_order_relaxed);
+            }
+            return false;
+        }
+        if (!lockstats::active(stats)) {
+            acquire_slow(nullptr);
+            return true;
+        }
+        uint64_t start = lockstats::now();
+        acquire_slow(stats);
+        stats->acquires.fetch_add(1, std::memory_order_relaxed);
+        stats->contended.fetch_add(1, std::memory_order_relaxed);
+        stats->wait_ns.fetch_add(lockstats::now() - start, std::memory_order_relaxed);
+        return true;
+    }
+
+    void atomic_semaphore::acquire_slow(lockstats* profile) noexcept {
 #if !defined(BEE_NO_KERNEL_WAIT)
-        for (;;) {
-            if (v.exchange(SEM_FALSE) == SEM_TRUE)
-                return;
+        do {
+            if (profile) {
+                profile->parks.fetch_add(1, std::memory_order_relaxed);
+            }
             kernel_wait((const value_type*)&v, SEM_FALSE);
-        }
+        } while (v.exchange(SEM_FALSE) != SEM_TRUE);
 #else
         for (int i = 0; i < 64; ++i) {
-            if (v.exchange(SEM_FALSE) == SEM_TRUE)
-                return;
             cpu_relax();
-        }
-        for (int i = 0; i < 8; ++i) {
-            if (v.exchange(SEM_FALSE) == SEM_TRUE)
+            if (v.exchange(SEM_FALSE) == SEM_TRUE) {
+                if (profile) {
+                    profile->spins.fetch_add(i + 1, std::memory_order_relaxed);
+                }
                 return;
-            thread_yield();
+            }
+        }
+        if (profile) {
+            profile->spins.fetch_add(64, std::memory_order_relaxed);
         }
-        for (;;) {
-            if (v.exchange(SEM_FALSE) == SEM_TRUE)
+        for (int i = 0;; ++i) {
+            if (profile) {
+                profile->parks.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (i < 8) {
+                thread_yield();
+            }
+            else {
+                thread_sleep(10);
+            }
+            if (v.exchange(SEM_FALSE) == SEM_TRUE) {
                 return;
-            thread_sleep(10);
+            }
         }
 #endif
     }
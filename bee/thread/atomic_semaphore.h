@@ -1,5 +1,7 @@
 #pragma once
 
+#include <bee/thread/lockstats.h>
+
 #include <atomic>
 #include <cstdint>
 
@@ -29,15 +31,20 @@ namespace bee {
 #endif
 
         atomic_semaphore() noexcept;
+        explicit atomic_semaphore(lockstats* stats) noexcept;
         atomic_semaphore(const atomic_semaphore&)            = delete;
         atomic_semaphore& operator=(const atomic_semaphore&) = delete;
         void release() noexcept;
-        void acquire() noexcept;
+        // Returns true if the caller had to wait for a release.
+        bool acquire() noexcept;
 
         static constexpr value_type SEM_FALSE = 0;
         static constexpr value_type SEM_TRUE  = 1;
 
     private:
+        void acquire_slow(lockstats* profile) noexcept;
+
         std::atomic<value_type> v;
+        lockstats* stats = nullptr;
     };
 }
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace bee {
+    struct lockstats {
+        std::atomic<uint64_t> acquires  = 0;
+        std::atomic<uint64_t> contended = 0;
+        std::atomic<uint64_t> spins     = 0;
+        std::atomic<uint64_t> parks     = 0;
+        std::atomic<uint64_t> wait_ns   = 0;
+
+        static inline std::atomic<bool> enabled = false;
+        static bool active(const lockstats* s) noexcept {
+            return s && enabled.load(std::memory_order_relaxed);
+        }
+        static uint64_t now() noexcept;
+    };
+}
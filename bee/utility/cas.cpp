@@ -0,0 +1,440 @@
+#include <bee/thread/simplethread.h>
+#include <bee/utility/cas.h>
+#include <bee/utility/sha256.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <unordered_map>
+
+#if defined(__linux__)
+#    include <fcntl.h>
+#    include <linux/fs.h>
+#    include <sys/ioctl.h>
+#    include <unistd.h>
+#elif defined(__APPLE__)
+#    include <sys/attr.h>
+#    include <sys/clonefile.h>
+#endif
+
+namespace bee {
+    static constexpr size_t kChunkSize = 1024 * 1024;
+    static constexpr size_t kKeySize   = sha256::digest_size * 2;
+
+    static FILE* open_file(const fs::path& path, bool write) noexcept {
+#if defined(_WIN32)
+        return _wfopen(path.c_str(), write ? L"ab" : L"rb");
+#else
+        return fopen(path.c_str(), write ? "ab" : "rb");
+#endif
+    }
+
+    static std::string tohex(const uint8_t* digest, size_t len) {
+        static const char hex[] = "0123456789abcdef";
+        std::string key(len * 2, '0');
+        for (size_t i = 0; i < len; ++i) {
+            key[i * 2]     = hex[digest[i] >> 4];
+            key[i * 2 + 1] = hex[digest[i] & 0xF];
+        }
+        return key;
+    }
+
+    static int64_t now_seconds() noexcept {
+        return (int64_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static fs::path unique_tmp(const fs::path& dir, const std::string& key) {
+        static std::atomic<uint64_t> counter = 0;
+        auto stamp = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+        return dir / (key + "." + std::to_string(stamp) + "." + std::to_string(counter.fetch_add(1)));
+    }
+
+    static void set_readonly(const fs::path& path, bool readonly) {
+        std::error_code ec;
+        fs::permissions(path, fs::perms::owner_write, readonly ? fs::perm_options::remove : fs::perm_options::add, ec);
+        if (readonly) {
+            fs::permissions(path, fs::perms::group_write | fs::perms::others_write, fs::perm_options::remove, ec);
+        }
+    }
+
+    cas::~cas() {
+        close();
+    }
+
+    bool cas::valid_key(std::string_view key) noexcept {
+        if (key.size() != kKeySize) {
+            return false;
+        }
+        for (char c : key) {
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Streams the file through a fixed buffer, so memory use does not depend on
+    // the file size. The key is the SHA-256 of the content: a collision would
+    // silently serve the wrong blob, so a fast hash is not good enough here.
+    std::string cas::hash_file(const fs::path& path, std::error_code& ec) {
+        FILE* f = open_file(path, false);
+        if (!f) {
+            ec = std::error_code(errno, std::generic_category());
+            return {};
+        }
+        std::unique_ptr<unsigned char[]> buf(new unsigned char[kChunkSize]);
+        sha256 h;
+        size_t n;
+        while ((n = fread(buf.get(), 1, kChunkSize, f)) > 0) {
+            h.update(buf.get(), n);
+        }
+        if (ferror(f)) {
+            ec = std::error_code(errno, std::generic_category());
+            fclose(f);
+            return {};
+        }
+        fclose(f);
+        uint8_t digest[sha256::digest_size];
+        h.final(digest);
+        return tohex(digest, sizeof(digest));
+    }
+
+    bool cas::reflink(const fs::path& from, const fs::path& to) noexcept {
+#if defined(__linux__) && defined(FICLONE)
+        int src = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+        if (src < 0) {
+            return false;
+        }
+        int dst = ::open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (dst < 0) {
+            ::close(src);
+            return false;
+        }
+        int r = ioctl(dst, FICLONE, src);
+        ::close(src);
+        ::close(dst);
+        if (r != 0) {
+            ::unlink(to.c_str());
+            return false;
+        }
+        return true;
+#elif defined(__APPLE__)
+        return clonefile(from.c_str(), to.c_str(), 0) == 0;
+#else
+        (void)from;
+        (void)to;
+        return false;
+#endif
+    }
+
+    bool cas::open(const fs::path& root, std::error_code& ec) {
+        close();
+        m_root = root;
+        fs::create_directories(m_root / "objects", ec);
+        if (ec) {
+            return false;
+        }
+        fs::create_directories(m_root / "tmp", ec);
+        if (ec) {
+            return false;
+        }
+        m_log = open_file(m_root / "access.log", true);
+        if (!m_log) {
+            ec = std::error_code(errno, std::generic_category());
+            return false;
+        }
+        return true;
+    }
+
+    void cas::close() noexcept {
+        if (m_log) {
+            fclose(m_log);
+            m_log = nullptr;
+        }
+    }
+
+    fs::path cas::blob(const std::string& key) const {
+        return m_root / "objects" / key.substr(0, 2) / key.substr(2);
+    }
+
+    bool cas::has(const std::string& key) const {
+        std::error_code ec;
+        return fs::exists(blob(key), ec);
+    }
+
+    void cas::touch(const std::string& key) {
+        if (m_log) {
+            fprintf(m_log, "%s %lld\n", key.c_str(), (long long)now_seconds());
+            fflush(m_log);
+        }
+    }
+
+    // Copies the file into tmp and hashes the bytes written there, so the key
+    // always matches what gets stored even if the source changes meanwhile.
+    // A reflinked copy is hashed afterwards; it can not change under us.
+    std::string cas::stage(const fs::path& path, fs::path& tmp, std::error_code& ec) const {
+        tmp = unique_tmp(m_root / "tmp", "put");
+        if (reflink(path, tmp)) {
+            std::string key = hash_file(tmp, ec);
+            if (ec) {
+                std::error_code ignore;
+                fs::remove(tmp, ignore);
+            }
+            return key;
+        }
+        FILE* in = open_file(path, false);
+        if (!in) {
+            ec = std::error_code(errno, std::generic_category());
+            return {};
+        }
+        FILE* out = open_file(tmp, true);
+        if (!out) {
+            ec = std::error_code(errno, std::generic_category());
+            fclose(in);
+            return {};
+        }
+        std::unique_ptr<unsigned char[]> buf(new unsigned char[kChunkSize]);
+        sha256 h;
+        size_t n;
+        int err = 0;
+        while ((n = fread(buf.get(), 1, kChunkSize, in)) > 0) {
+            if (fwrite(buf.get(), 1, n, out) != n) {
+                err = errno;
+                break;
+            }
+            h.update(buf.get(), n);
+        }
+        if (!err && ferror(in)) {
+            err = errno;
+        }
+        fclose(in);
+        if (fclose(out) != 0 && !err) {
+            err = errno;
+        }
+        if (err) {
+            ec = std::error_code(err, std::generic_category());
+            std::error_code ignore;
+            fs::remove(tmp, ignore);
+            return {};
+        }
+        uint8_t digest[sha256::digest_size];
+        h.final(digest);
+        return tohex(digest, sizeof(digest));
+    }
+
+    bool cas::commit(const fs::path& tmp, const std::string& key, std::error_code& ec) {
+        std::error_code ignore;
+        fs::path target = blob(key);
+        bool exists     = fs::exists(target, ec);
+        if (!ec && !exists) {
+            fs::create_directories(target.parent_path(), ec);
+        }
+        if (ec) {
+            fs::remove(tmp, ignore);
+            return false;
+        }
+        if (!exists) {
+            set_readonly(tmp, true);
+            fs::rename(tmp, target, ec);
+        }
+        if (exists || ec) {
+            set_readonly(tmp, false);
+            fs::remove(tmp, ignore);
+            if (ec && !fs::exists(target, ignore)) {
+                return false;
+            }
+            ec.clear();
+        }
+        touch(key);
+        return true;
+    }
+
+    std::string cas::put(const fs::path& path, std::error_code& ec) {
+        fs::path tmp;
+        std::string key = stage(path, tmp, ec);
+        if (ec || !commit(tmp, key, ec)) {
+            return {};
+        }
+        return key;
+    }
+
+    // Copies and hashes on `threads` threads; the renames and log writes that
+    // follow are cheap and stay on the calling thread.
+    std::vector<std::string> cas::put_many(const std::vector<fs::path>& paths, std::vector<std::error_code>& ec, int threads) {
+        struct job {
+            const cas& self;
+            const std::vector<fs::path>& paths;
+            std::vector<fs::path> tmps;
+            std::vector<std::string> keys;
+            std::vector<std::error_code>& ec;
+            std::atomic<size_t> next = 0;
+        };
+        ec.assign(paths.size(), std::error_code {});
+        job j { *this, paths, std::vector<fs::path>(paths.size()), std::vector<std::string>(paths.size()), ec };
+        auto worker = [](void* ud) noexcept {
+            auto& j = *static_cast<job*>(ud);
+            for (;;) {
+                size_t i = j.next.fetch_add(1);
+                if (i >= j.paths.size()) {
+                    return;
+                }
+                j.keys[i] = j.self.stage(j.paths[i], j.tmps[i], j.ec[i]);
+            }
+        };
+        size_t n = std::min<size_t>(threads > 0 ? (size_t)threads : 1, paths.size());
+        std::vector<thread_handle> handles;
+        for (size_t i = 1; i < n; ++i) {
+            if (auto h = thread_create(worker, &j)) {
+                handles.push_back(h);
+            }
+        }
+        worker(&j);
+        for (auto h : handles) {
+            thread_wait(h);
+        }
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (!ec[i]) {
+                commit(j.tmps[i], j.keys[i], ec[i]);
+            }
+        }
+        return std::move(j.keys);
+    }
+
+    bool cas::get(const std::string& key, const fs::path& dest, bool allow_hardlink, method& used, std::error_code& ec) {
+        fs::path source = blob(key);
+        if (!fs::exists(source, ec)) {
+            if (!ec) {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            }
+            return false;
+        }
+        if (fs::exists(fs::symlink_status(dest, ec))) {
+            // A hardlinked dest shares its permissions with the blob, so only
+            // a private copy may be made writable. POSIX unlinks read-only
+            // files anyway; Windows refuses to delete them.
+#if defined(_WIN32)
+            if (fs::hard_link_count(dest, ec) == 1) {
+                set_readonly(dest, false);
+            }
+#endif
+            fs::remove(dest, ec);
+            if (ec) {
+                return false;
+            }
+        }
+        ec.clear();
+        if (reflink(source, dest)) {
+            set_readonly(dest, false);
+            used = method::reflink;
+        }
+        else if (allow_hardlink && (fs::create_hard_link(source, dest, ec), !ec)) {
+            used = method::hardlink;
+        }
+        else {
+            ec.clear();
+            fs::copy_file(source, dest, ec);
+            if (ec) {
+                return false;
+            }
+            set_readonly(dest, false);
+            used = method::copy;
+        }
+        touch(key);
+        return true;
+    }
+
+    cas::gc_result cas::gc(uint64_t max_bytes, std::error_code& ec) {
+        gc_result r;
+        // Later lines win ties within the same second.
+        struct stamp {
+            int64_t time = 0;
+            uint64_t seq = 0;
+            bool operator<(const stamp& o) const noexcept {
+                return time < o.time || (time == o.time && seq < o.seq);
+            }
+        };
+        std::unordered_map<std::string, stamp> access;
+        if (FILE* f = open_file(m_root / "access.log", false)) {
+            char key[80];
+            long long time;
+            uint64_t seq = 0;
+            while (fscanf(f, "%79s %lld", key, &time) == 2) {
+                auto& t = access[key];
+                t       = std::max(t, stamp { time, ++seq });
+            }
+            fclose(f);
+        }
+        struct object {
+            std::string key;
+            uint64_t size;
+            stamp time;
+        };
+        std::vector<object> objects;
+        uint64_t total = 0;
+        for (fs::directory_iterator dir(m_root / "objects", ec), end; !ec && dir != end; dir.increment(ec)) {
+            std::error_code file_ec;
+            for (fs::directory_iterator file(dir->path(), file_ec); !file_ec && file != end; file.increment(file_ec)) {
+                std::string key = dir->path().filename().string() + file->path().filename().string();
+                if (!valid_key(key)) {
+                    continue;
+                }
+                uint64_t size = (uint64_t)file->file_size(file_ec);
+                if (file_ec) {
+                    continue;
+                }
+                auto it = access.find(key);
+                objects.push_back({ key, size, it != access.end() ? it->second : stamp {} });
+                total += size;
+            }
+        }
+        if (ec) {
+            return r;
+        }
+        std::sort(objects.begin(), objects.end(), [](const object& a, const object& b) { return a.time < b.time; });
+        size_t collected = 0;
+        for (auto& o : objects) {
+            if (total <= max_bytes) {
+                break;
+            }
+            fs::path path = blob(o.key);
+            std::error_code rm_ec;
+            set_readonly(path, false);
+            if (fs::remove(path, rm_ec)) {
+                total -= o.size;
+                r.removed++;
+                r.freed += o.size;
+            }
+            collected++;
+        }
+        r.remaining = total;
+
+        // Compact the log to one line per surviving object.
+        fs::path log = m_root / "access.log";
+        fs::path tmp = unique_tmp(m_root / "tmp", "access");
+        if (FILE* f = open_file(tmp, true)) {
+            for (size_t i = collected; i < objects.size(); ++i) {
+                if (objects[i].time.seq != 0) {
+                    fprintf(f, "%s %lld\n", objects[i].key.c_str(), (long long)objects[i].time.time);
+                }
+            }
+            fclose(f);
+            close();
+            fs::rename(tmp, log, ec);
+            m_log = open_file(log, true);
+        }
+
+        // Remove temporaries left behind by interrupted puts.
+        auto expire = fs::file_time_type::clock::now() - std::chrono::hours(24);
+        std::error_code tmp_ec;
+        for (fs::directory_iterator file(m_root / "tmp", tmp_ec), end; !tmp_ec && file != end; file.increment(tmp_ec)) {
+            std::error_code file_ec;
+            if (file->last_write_time(file_ec) < expire && !file_ec) {
+                set_readonly(file->path(), false);
+                fs::remove(file->path(), file_ec);
+            }
+        }
+        return r;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <bee/nonstd/filesystem.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace bee {
+    // Content-addressed blob store. Blobs live read-only in <root>/objects/xx/
+    // under the hex SHA-256 of their content; last use is appended to
+    // <root>/access.log and drives the LRU collection.
+    class cas {
+    public:
+        enum class method {
+            reflink,
+            hardlink,
+            copy,
+        };
+        struct gc_result {
+            uint64_t removed   = 0;
+            uint64_t freed     = 0;
+            uint64_t remaining = 0;
+        };
+
+        cas() noexcept = default;
+        ~cas();
+        cas(const cas&)            = delete;
+        cas& operator=(const cas&) = delete;
+
+        bool open(const fs::path& root, std::error_code& ec);
+        void close() noexcept;
+        std::string put(const fs::path& path, std::error_code& ec);
+        std::vector<std::string> put_many(const std::vector<fs::path>& paths, std::vector<std::error_code>& ec, int threads);
+        bool get(const std::string& key, const fs::path& dest, bool allow_hardlink, method& used, std::error_code& ec);
+        bool has(const std::string& key) const;
+        fs::path blob(const std::string& key) const;
+        gc_result gc(uint64_t max_bytes, std::error_code& ec);
+
+        static bool valid_key(std::string_view key) noexcept;
+        static std::string hash_file(const fs::path& path, std::error_code& ec);
+        static bool reflink(const fs::path& from, const fs::path& to) noexcept;
+
+    private:
+        std::string stage(const fs::path& path, fs::path& tmp, std::error_code& ec) const;
+        bool commit(const fs::path& tmp, const std::string& key, std::error_code& ec);
+        void touch(const std::string& key);
+
+        fs::path m_root;
+        FILE* m_log = nullptr;
+    };
+}
@@ -0,0 +1,65 @@
+#include <bee/utility/content_hash.h>
+
+#include <cstring>
+
+namespace bee {
+    static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+    static inline uint64_t rotl(uint64_t x, int r) noexcept {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static inline uint64_t read64(const unsigned char* p) noexcept {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline uint64_t mix(uint64_t acc, uint64_t input) noexcept {
+        acc += input * kPrime2;
+        acc = rotl(acc, 31);
+        return acc * kPrime1;
+    }
+
+    // Four independent lanes over 32-byte stripes, so the loop is not bound by
+    // the latency of a single multiply chain. Not meant to resist collisions
+    // crafted by an adversary.
+    uint64_t content_hash(const void* data, size_t len, uint64_t seed) noexcept {
+        auto p         = static_cast<const unsigned char*>(data);
+        const auto end = p + len;
+        uint64_t h;
+        if (len >= 32) {
+            uint64_t v1 = seed + kPrime1 + kPrime2;
+            uint64_t v2 = seed + kPrime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - kPrime1;
+            for (; p + 32 <= end; p += 32) {
+                v1 = mix(v1, read64(p));
+                v2 = mix(v2, read64(p + 8));
+                v3 = mix(v3, read64(p + 16));
+                v4 = mix(v4, read64(p + 24));
+            }
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        }
+        else {
+            h = seed + kPrime3;
+        }
+        h += (uint64_t)len;
+        for (; p + 8 <= end; p += 8) {
+            h ^= mix(0, read64(p));
+            h = rotl(h, 27) * kPrime1 + kPrime3;
+        }
+        for (; p < end; ++p) {
+            h ^= (*p) * kPrime3;
+            h = rotl(h, 11) * kPrime1;
+        }
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+}
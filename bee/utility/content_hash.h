@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bee {
+    // Fast non-cryptographic 64-bit hash. Long inputs can be hashed in chunks by
+    // passing the previous result as the seed of the next chunk.
+    uint64_t content_hash(const void* data, size_t len, uint64_t seed = 0) noexcept;
+}
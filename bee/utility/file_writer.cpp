@@ -0,0 +1,340 @@
+#include <bee/utility/file_writer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#    include <Windows.h>
+#else
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace bee {
+    // Direct I/O needs buffers, offsets and lengths aligned to the logical
+    // block size of the device; a page covers every common one.
+    static constexpr size_t kAlign = 4096;
+
+    static std::error_code last_error() noexcept {
+#if defined(_WIN32)
+        return std::error_code(::GetLastError(), std::system_category());
+#else
+        return std::error_code(errno, std::generic_category());
+#endif
+    }
+
+    static char* alloc_block(size_t size) {
+        return static_cast<char*>(::operator new[](size, std::align_val_t(kAlign)));
+    }
+
+    static void free_block(char* p) noexcept {
+        ::operator delete[](p, std::align_val_t(kAlign));
+    }
+
+#if defined(_WIN32)
+    static file_handle open_file(const fs::path& path, bool direct) noexcept {
+        DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+        if (direct) {
+            flags |= FILE_FLAG_NO_BUFFERING;
+        }
+        HANDLE h = ::CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, flags, NULL);
+        if (h == INVALID_HANDLE_VALUE) {
+            return {};
+        }
+        return { h };
+    }
+
+    static bool preallocate_file(file_handle fd, uint64_t size) noexcept {
+        FILE_ALLOCATION_INFO info;
+        info.AllocationSize.QuadPart = (LONGLONG)size;
+        return !!::SetFileInformationByHandle(fd.value(), FileAllocationInfo, &info, sizeof(info));
+    }
+
+    static bool truncate_file(file_handle fd, uint64_t size) noexcept {
+        FILE_END_OF_FILE_INFO info;
+        info.EndOfFile.QuadPart = (LONGLONG)size;
+        return !!::SetFileInformationByHandle(fd.value(), FileEndOfFileInfo, &info, sizeof(info));
+    }
+
+    static bool write_at(file_handle fd, const char* data, size_t len, uint64_t offset) noexcept {
+        while (len > 0) {
+            OVERLAPPED ov = {};
+            ov.Offset     = (DWORD)offset;
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD n       = 0;
+            DWORD chunk   = (DWORD)(std::min)(len, (size_t)1 << 30);
+            if (!::WriteFile(fd.value(), data, chunk, &n, &ov)) {
+                return false;
+            }
+            data += n;
+            len -= n;
+            offset += n;
+        }
+        return true;
+    }
+#else
+    static file_handle open_file(const fs::path& path, bool direct) noexcept {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#    if defined(O_DIRECT)
+        if (direct) {
+            flags |= O_DIRECT;
+        }
+#    endif
+        int fd = ::open(path.c_str(), flags, 0644);
+        if (fd == -1) {
+            return {};
+        }
+#    if defined(__APPLE__)
+        if (direct && ::fcntl(fd, F_NOCACHE, 1) == -1) {
+            ::close(fd);
+            return {};
+        }
+#    endif
+        return { fd };
+    }
+
+    // Reserves the space without changing the file size where the platform
+    // allows it, so readers never see the unwritten tail.
+    static bool preallocate_file(file_handle fd, uint64_t size) noexcept {
+#    if defined(__linux__)
+        return ::fallocate(fd.value(), FALLOC_FL_KEEP_SIZE, 0, (off_t)size) == 0;
+#    elif defined(__APPLE__)
+        fstore_t st = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, (off_t)size, 0 };
+        if (::fcntl(fd.value(), F_PREALLOCATE, &st) == -1) {
+            st.fst_flags = F_ALLOCATEALL;
+            if (::fcntl(fd.value(), F_PREALLOCATE, &st) == -1) {
+                return false;
+            }
+        }
+        return true;
+#    else
+        errno = ::posix_fallocate(fd.value(), 0, (off_t)size);
+        return errno == 0;
+#    endif
+    }
+
+    static bool truncate_file(file_handle fd, uint64_t size) noexcept {
+        return ::ftruncate(fd.value(), (off_t)size) == 0;
+    }
+
+    static bool write_at(file_handle fd, const char* data, size_t len, uint64_t offset) noexcept {
+        while (len > 0) {
+            ssize_t n = ::pwrite(fd.value(), data, len, (off_t)offset);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            len -= (size_t)n;
+            offset += (uint64_t)n;
+        }
+        return true;
+    }
+#endif
+
+    static void close_file(file_handle& fd) noexcept {
+#if defined(_WIN32)
+        ::CloseHandle(fd.value());
+#else
+        ::close(fd.value());
+#endif
+        fd = {};
+    }
+
+    file_writer::~file_writer() {
+        std::error_code ec;
+        close(ec);
+    }
+
+    bool file_writer::open(const fs::path& path, const options& opts, std::error_code& ec) {
+        if (m_fd) {
+            ec = std::make_error_code(std::errc::device_or_resource_busy);
+            return false;
+        }
+        m_opts             = opts;
+        m_opts.block_size  = (std::max)((opts.block_size + kAlign - 1) / kAlign * kAlign, kAlign);
+        m_opts.buffers     = (std::clamp)(opts.buffers, 2, 64);
+        m_direct           = opts.direct;
+        m_fd               = open_file(path, m_direct);
+#if !defined(_WIN32)
+        // some file systems (tmpfs) refuse O_DIRECT; write through the cache there
+        if (!m_fd && m_direct && errno == EINVAL) {
+            m_direct = false;
+            m_fd     = open_file(path, false);
+        }
+#endif
+        if (!m_fd) {
+            ec = last_error();
+            return false;
+        }
+        if (opts.preallocate > 0) {
+            m_preallocated = preallocate_file(m_fd, opts.preallocate);
+        }
+        try {
+            for (int i = 0; i < m_opts.buffers; ++i) {
+                m_buffers.push_back(alloc_block(m_opts.block_size));
+            }
+            m_free.assign(m_buffers.begin() + 1, m_buffers.end());
+            m_queue.reserve(m_buffers.size());
+            m_current = { m_buffers[0], 0, 0 };
+            m_stop    = false;
+            m_thread  = std::thread(&file_writer::run, this);
+        } catch (const std::exception&) {
+            release();
+            close_file(m_fd);
+            ec = std::make_error_code(std::errc::not_enough_memory);
+            return false;
+        }
+        return true;
+    }
+
+    bool file_writer::write(const char* data, size_t len, std::error_code& ec) {
+        if (!m_fd) {
+            ec = std::make_error_code(std::errc::bad_file_descriptor);
+            return false;
+        }
+        while (len > 0) {
+            size_t n = (std::min)(len, m_opts.block_size - m_current.len);
+            memcpy(m_current.data + m_current.len, data, n);
+            m_current.len += n;
+            m_size += n;
+            data += n;
+            len -= n;
+            if (m_current.len == m_opts.block_size && !submit(ec)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Queues the current block and takes a free one, waiting for the writer
+    // when all of them are queued.
+    bool file_writer::submit(std::error_code& ec) {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        m_queue.push_back(m_current);
+        m_cv.notify_all();
+        m_cv.wait(lk, [this] { return !m_free.empty() || m_error; });
+        if (m_error) {
+            ec = m_error;
+            return false;
+        }
+        const uint64_t next = m_current.offset + m_current.len;
+        m_current           = { m_free.back(), 0, next };
+        m_free.pop_back();
+        return true;
+    }
+
+    bool file_writer::write_block(const block& b) noexcept {
+        size_t len = b.len;
+        if (m_direct && len % kAlign != 0) {
+            // only the last block can be partial; the padding is cut off in close
+            const size_t padded = (len + kAlign - 1) / kAlign * kAlign;
+            memset(b.data + len, 0, padded - len);
+            len = padded;
+        }
+        if (!write_at(m_fd, b.data, len, b.offset)) {
+            return false;
+        }
+        writeback(b.offset + b.len);
+        return true;
+    }
+
+    // Starts writeback of each new block at once and waits for the window
+    // before the last one, so dirty data stays bounded by two windows and
+    // the page cache never builds up a large backlog to flush.
+    void file_writer::writeback(uint64_t end) noexcept {
+#if defined(__linux__)
+        const uint64_t window = m_opts.sync_bytes;
+        if (window == 0) {
+            return;
+        }
+        ::sync_file_range(m_fd.value(), (off_t)m_synced, (off_t)(end - m_synced), SYNC_FILE_RANGE_WRITE);
+        while (end - m_synced >= 2 * window) {
+            ::sync_file_range(m_fd.value(), (off_t)m_synced, (off_t)window, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            if (!m_direct) {
+                ::posix_fadvise(m_fd.value(), (off_t)m_synced, (off_t)window, POSIX_FADV_DONTNEED);
+            }
+            m_synced += window;
+        }
+#else
+        (void)end;
+#endif
+    }
+
+    void file_writer::run() noexcept {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        for (;;) {
+            m_cv.wait(lk, [this] { return !m_queue.empty() || m_stop; });
+            if (m_queue.empty()) {
+                return;
+            }
+            block b = m_queue.front();
+            m_queue.erase(m_queue.begin());
+            bool ok = true;
+            if (!m_error) {
+                lk.unlock();
+                ok = write_block(b);
+                lk.lock();
+            }
+            if (!ok && !m_error) {
+                m_error = last_error();
+            }
+            m_free.push_back(b.data);
+            m_cv.notify_all();
+        }
+    }
+
+    bool file_writer::close(std::error_code& ec) {
+        if (!m_fd) {
+            return true;
+        }
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            if (m_current.len > 0) {
+                m_queue.push_back(m_current);
+            }
+            m_stop = true;
+            m_cv.notify_all();
+        }
+        m_thread.join();
+        bool ok = !m_error;
+        if (!ok) {
+            ec = m_error;
+        }
+        // drop the direct I/O padding and any preallocated space left over
+        if ((m_direct || m_preallocated) && !truncate_file(m_fd, m_size) && ok) {
+            ec = last_error();
+            ok = false;
+        }
+        close_file(m_fd);
+        release();
+        return ok;
+    }
+
+    void file_writer::release() noexcept {
+        for (char* p : m_buffers) {
+            free_block(p);
+        }
+        m_buffers.clear();
+        m_free.clear();
+        m_queue.clear();
+        m_current = {};
+    }
+
+    uint64_t file_writer::size() const noexcept {
+        return m_size;
+    }
+
+    bool file_writer::direct() const noexcept {
+        return m_direct;
+    }
+
+    bool file_writer::preallocated() const noexcept {
+        return m_preallocated;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <bee/nonstd/filesystem.h>
+#include <bee/utility/file_handle.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace bee {
+    // Sequential writer for large files. Data is copied into aligned blocks
+    // that a background thread writes at fixed offsets, one at a time; with
+    // `buffers` blocks the caller can fill the others meanwhile. The file
+    // can be preallocated up front, written around the page cache (direct)
+    // and is pushed to disk sync_bytes at a time while it grows instead of
+    // all at once by the kernel later.
+    class file_writer {
+    public:
+        struct options {
+            uint64_t preallocate = 0;
+            bool direct          = false;
+            int buffers          = 2;
+            size_t block_size    = 1 << 20;
+            uint64_t sync_bytes  = 8 << 20;
+        };
+
+        file_writer() noexcept = default;
+        ~file_writer();
+        file_writer(const file_writer&)            = delete;
+        file_writer& operator=(const file_writer&) = delete;
+
+        bool open(const fs::path& path, const options& opts, std::error_code& ec);
+        bool write(const char* data, size_t len, std::error_code& ec);
+        bool close(std::error_code& ec);
+        uint64_t size() const noexcept;
+        bool direct() const noexcept;
+        bool preallocated() const noexcept;
+
+    private:
+        struct block {
+            char* data;
+            size_t len;
+            uint64_t offset;
+        };
+        bool submit(std::error_code& ec);
+        void run() noexcept;
+        bool write_block(const block& b) noexcept;
+        void writeback(uint64_t end) noexcept;
+        void release() noexcept;
+
+        file_handle m_fd;
+        options m_opts;
+        bool m_direct       = false;
+        bool m_preallocated = false;
+        uint64_t m_size     = 0;
+        uint64_t m_synced   = 0;
+        block m_current     = {};
+        std::vector<char*> m_buffers;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::vector<block> m_queue;
+        std::vector<char*> m_free;
+        std::error_code m_error;
+        bool m_stop = false;
+        std::thread m_thread;
+    };
+}
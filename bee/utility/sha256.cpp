@@ -0,0 +1,123 @@
+#include <bee/utility/sha256.h>
+
+#include <cstring>
+
+namespace bee {
+    static constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    static inline uint32_t rotr(uint32_t x, int n) noexcept {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    static inline uint32_t load_be32(const uint8_t* p) noexcept {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+
+    static inline void store_be32(uint8_t* p, uint32_t v) noexcept {
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)v;
+    }
+
+    sha256::sha256() noexcept {
+        reset();
+    }
+
+    void sha256::reset() noexcept {
+        static constexpr uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        memcpy(m_state, init, sizeof(m_state));
+        m_bits     = 0;
+        m_buffered = 0;
+    }
+
+    void sha256::transform(const uint8_t* block) noexcept {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = load_be32(block + i * 4);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i]        = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+        uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + K[i] + w[i];
+            uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t mj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + mj;
+            h           = g;
+            g           = f;
+            f           = e;
+            e           = d + t1;
+            d           = c;
+            c           = b;
+            b           = a;
+            a           = t1 + t2;
+        }
+        m_state[0] += a;
+        m_state[1] += b;
+        m_state[2] += c;
+        m_state[3] += d;
+        m_state[4] += e;
+        m_state[5] += f;
+        m_state[6] += g;
+        m_state[7] += h;
+    }
+
+    void sha256::update(const void* data, size_t len) noexcept {
+        auto p = static_cast<const uint8_t*>(data);
+        m_bits += (uint64_t)len * 8;
+        if (m_buffered > 0) {
+            size_t n = sizeof(m_buffer) - m_buffered;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(m_buffer + m_buffered, p, n);
+            m_buffered += n;
+            p += n;
+            len -= n;
+            if (m_buffered < sizeof(m_buffer)) {
+                return;
+            }
+            transform(m_buffer);
+            m_buffered = 0;
+        }
+        for (; len >= sizeof(m_buffer); p += sizeof(m_buffer), len -= sizeof(m_buffer)) {
+            transform(p);
+        }
+        memcpy(m_buffer, p, len);
+        m_buffered = len;
+    }
+
+    void sha256::final(uint8_t digest[digest_size]) noexcept {
+        const uint64_t bits = m_bits;
+        m_buffer[m_buffered++] = 0x80;
+        if (m_buffered > 56) {
+            memset(m_buffer + m_buffered, 0, sizeof(m_buffer) - m_buffered);
+            transform(m_buffer);
+            m_buffered = 0;
+        }
+        memset(m_buffer + m_buffered, 0, 56 - m_buffered);
+        store_be32(m_buffer + 56, (uint32_t)(bits >> 32));
+        store_be32(m_buffer + 60, (uint32_t)bits);
+        transform(m_buffer);
+        for (int i = 0; i < 8; ++i) {
+            store_be32(digest + i * 4, m_state[i]);
+        }
+        reset();
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bee {
+    // SHA-256 (FIPS 180-4). Feed data with update() in any number of pieces,
+    // then final() writes the 32-byte digest and resets the state.
+    class sha256 {
+    public:
+        static constexpr size_t digest_size = 32;
+
+        sha256() noexcept;
+        void update(const void* data, size_t len) noexcept;
+        void final(uint8_t digest[digest_size]) noexcept;
+
+    private:
+        void reset() noexcept;
+        void transform(const uint8_t* block) noexcept;
+
+        uint32_t m_state[8];
+        uint64_t m_bits;
+        uint8_t m_buffer[64];
+        size_t m_buffered;
+    };
+}
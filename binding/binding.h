@@ -212,6 +212,9 @@ namespace bee::lua {
         }
     }
 
+    void instrument_module(lua_State* L, const char* name);
+    void instrument_metatable(lua_State* L, const char* name);
+
     template <typename T, typename... Args>
     T& newudata(lua_State* L, void (*init_metatable)(lua_State*), Args&&... args) {
         static_assert(udata_has_name<T>::value);
@@ -227,6 +230,7 @@ namespace bee::lua {
                 lua_setfield(L, -2, "__gc");
             }
             init_metatable(L);
+            instrument_metatable(L, udata<T>::name);
         }
         lua_setmetatable(L, -2);
         return *o;
@@ -246,6 +250,7 @@ namespace bee::lua {
                 lua_setfield(L, -2, "__gc");
             }
             init_metatable(L);
+            instrument_metatable(L, name);
         }
         lua_setmetatable(L, -2);
         return *o;
@@ -299,9 +304,11 @@ namespace bee::lua {
 #    define BEE_LUA_API extern "C"
 #endif
 
-#define DEFINE_LUAOPEN(name)                 \
-    BEE_LUA_API                              \
-    int luaopen_bee_##name(lua_State* L) {   \
-        return bee::lua_##name ::luaopen(L); \
-    }                                        \
+#define DEFINE_LUAOPEN(name)                          \
+    BEE_LUA_API                                       \
+    int luaopen_bee_##name(lua_State* L) {            \
+        int n = bee::lua_##name ::luaopen(L);         \
+        ::bee::lua::instrument_module(L, #name);      \
+        return n;                                     \
+    }                                                 \
     static ::bee::lua::callfunc _init_##name(::bee::lua::register_module, "bee." #name, luaopen_bee_##name);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+namespace bee::lua_thread {
+    class channel;
+    using boxchannel = std::shared_ptr<channel>;
+
+    // Native access to bee.thread channels. Messages are lua-seri buffers.
+    boxchannel channel_open(std::string_view name);
+    void channel_push(channel& c, void* data);
+}
@@ -8,13 +8,44 @@
 #include <binding/file.h>
 #include <binding/udata.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #if defined(__NetBSD__) || defined(__FreeBSD__) || defined(__OpenBSD__)
 #    define BEE_DISABLE_FULLPATH
 #endif
 
+#if defined(__APPLE__)
+#    include <TargetConditionals.h>
+#endif
+
+#if defined(__EMSCRIPTEN__) || (defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE)
+#    define BEE_DISABLE_FSCACHE
+#else
+#    include <bee/filewatch.h>
+#    include <bee/thread/setname.h>
+#    include <bee/thread/simplethread.h>
+#endif
+
+#if !defined(__EMSCRIPTEN__)
+#    include <bee/utility/cas.h>
+#    include <bee/utility/file_writer.h>
+#endif
+
+#if !defined(BEE_DISABLE_FSCACHE)
+namespace bee::lua_filesystem::cache {
+    struct statcache;
+}
+#endif
+
 namespace bee::lua {
     template <>
     struct udata<fs::file_status> {
@@ -32,7 +63,22 @@ namespace bee::lua {
     struct udata<fs::directory_iterator> {
         static inline auto name = "bee::pairs";
     };
-
+#if !defined(BEE_DISABLE_FSCACHE)
+    template <>
+    struct udata<lua_filesystem::cache::statcache> {
+        static inline auto name = "bee::fs::cache";
+    };
+#endif
+#if !defined(__EMSCRIPTEN__)
+    template <>
+    struct udata<cas> {
+        static inline auto name = "bee::fs::cas";
+    };
+    template <>
+    struct udata<file_writer> {
+        static inline auto name = "bee::fs::writer";
+    };
+#endif
 }
 
 #if defined(__EMSCRIPTEN__)
@@ -872,6 +918,16 @@ namespace bee::lua_filesystem {
         return 1;
     }
 
+    static lua_Integer to_seconds(fs::file_time_type time) {
+        using namespace std::chrono;
+#if defined(__APPLE__)
+        auto system_time = time;
+#else
+        auto system_time = clock_cast<system_clock>(time);
+#endif
+        return duration_cast<seconds>(system_time.time_since_epoch()).count();
+    }
+
     static lua::cxx::status last_write_time(lua_State* L) {
         using namespace std::chrono;
         path_ptr p = getpathptr(L, 1);
@@ -881,12 +937,7 @@ namespace bee::lua_filesystem {
             if (ec) {
                 return pusherror(L, "last_write_time", ec, p);
             }
-#if defined(__APPLE__)
-            auto system_time = time;
-#else
-            auto system_time = clock_cast<system_clock>(time);
-#endif
-            lua_pushinteger(L, duration_cast<seconds>(system_time.time_since_epoch()).count());
+            lua_pushinteger(L, to_seconds(time));
             return 1;
         }
         auto sec = seconds(lua::checkinteger<lua_Integer>(L, 2));
@@ -1104,6 +1155,737 @@ namespace bee::lua_filesystem {
 #    endif
 #endif
 
+#if !defined(BEE_DISABLE_FSCACHE)
+    namespace cache {
+        // Metadata cache for paths below a root. A watcher thread drains a
+        // filewatch::watch on the root; lookups apply the pending invalidations
+        // before touching the table, so a hit costs no syscall.
+        struct statcache {
+            struct entry {
+                fs::file_status status;
+                lua_Integer mtime = 0;
+                uintmax_t size    = 0;
+                bool has_mtime    = false;
+                bool has_size     = false;
+            };
+
+            filewatch::watch watch;
+            fs::path path;
+            // The canonical root and the root as given, as absolute keys.
+            std::vector<std::string> roots;
+            bool fold = false;
+            // Keyed by the path relative to the root, "" for the root itself.
+            std::unordered_map<std::string, entry> entries;
+            uint64_t hits          = 0;
+            uint64_t misses        = 0;
+            uint64_t uncached      = 0;
+            uint64_t invalidations = 0;
+            uint64_t overflows     = 0;
+            uint64_t syncs         = 0;
+
+            std::mutex mutex;
+            std::condition_variable synced;
+            std::vector<filewatch::notify> pending;
+            std::string marker;
+            bool marker_seen = false;
+            std::atomic<bool> dirty { false };
+            std::atomic<bool> quit { false };
+            thread_handle thread = nullptr;
+
+            ~statcache() {
+                stop();
+            }
+            void stop() noexcept {
+                if (thread) {
+                    quit = true;
+                    watch.wakeup();
+                    thread_wait(thread);
+                    thread = nullptr;
+                }
+                std::unique_lock<std::mutex> lk(mutex);
+                watch.stop();
+            }
+            void drain() {
+                watch.update();
+                bool any = false;
+                while (auto n = watch.select()) {
+                    if (!marker.empty() && n->path.size() > marker.size() && n->path.compare(n->path.size() - marker.size(), marker.size(), marker) == 0) {
+                        marker_seen = true;
+                        continue;
+                    }
+                    pending.emplace_back(std::move(*n));
+                    any = true;
+                }
+                if (any) {
+                    dirty.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        static void foldcase(std::string& str) {
+            for (auto& c : str) {
+                if (c >= 'A' && c <= 'Z') {
+                    c = c - 'A' + 'a';
+                }
+            }
+        }
+
+        // Whether the volume holding 'root' ignores case, found by looking up
+        // the root's name with its ASCII case swapped. Only ASCII is folded.
+        static bool case_insensitive(const fs::path& root) {
+            auto name    = root.filename().native();
+            bool swapped = false;
+            for (auto& c : name) {
+                if (c >= 'a' && c <= 'z') {
+                    c       = c - 'a' + 'A';
+                    swapped = true;
+                }
+                else if (c >= 'A' && c <= 'Z') {
+                    c       = c - 'A' + 'a';
+                    swapped = true;
+                }
+            }
+            if (!swapped) {
+#if defined(_WIN32) || defined(__APPLE__)
+                return true;
+#else
+                return false;
+#endif
+            }
+            std::error_code ec;
+            return fs::equivalent(root, root.parent_path() / name, ec);
+        }
+
+        static std::string makeabskey(const fs::path& path, bool fold) {
+            auto str = path.lexically_normal().generic_u8string();
+            std::string key { u8tostrview(str) };
+            while (key.size() > 1 && key.back() == '/') {
+                key.pop_back();
+            }
+            if (fold) {
+                foldcase(key);
+            }
+            return key;
+        }
+
+        // Key of 'path' relative to the root; false when it is outside the root.
+        static bool makekey(const statcache& self, const fs::path& path, std::string& key) {
+            if (path.is_absolute()) {
+                key = makeabskey(path, self.fold);
+            }
+            else {
+                std::error_code ec;
+                fs::path abspath = fs::absolute(path, ec);
+                if (ec) {
+                    return false;
+                }
+                key = makeabskey(abspath, self.fold);
+            }
+            for (auto& root : self.roots) {
+                if (key.size() < root.size() || key.compare(0, root.size(), root) != 0) {
+                    continue;
+                }
+                if (key.size() == root.size()) {
+                    key.clear();
+                    return true;
+                }
+                if (root.back() == '/') {
+                    key.erase(0, root.size());
+                    return true;
+                }
+                if (key[root.size()] == '/') {
+                    key.erase(0, root.size() + 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static bool is_below(std::string_view key, std::string_view prefix) {
+            if (prefix.empty()) {
+                return true;
+            }
+            if (key.size() < prefix.size() || key.compare(0, prefix.size(), prefix) != 0) {
+                return false;
+            }
+            return key.size() == prefix.size() || key[prefix.size()] == '/';
+        }
+
+        static void apply(statcache& self) {
+            if (!self.dirty.load(std::memory_order_acquire)) {
+                return;
+            }
+            std::vector<filewatch::notify> events;
+            {
+                std::unique_lock<std::mutex> lk(self.mutex);
+                events.swap(self.pending);
+                self.dirty.store(false, std::memory_order_relaxed);
+            }
+            std::vector<std::string> subtrees;
+            for (auto& ev : events) {
+                if (ev.flags == filewatch::notify::flag::overflow) {
+                    self.overflows++;
+                    self.invalidations += self.entries.size();
+                    self.entries.clear();
+                    return;
+                }
+                std::string key;
+                if (!makekey(self, fs::u8path(ev.path), key)) {
+                    continue;
+                }
+                self.invalidations += self.entries.erase(key);
+                if (ev.flags == filewatch::notify::flag::rename) {
+                    // The parent's mtime changed and the path may have been a directory.
+                    if (!key.empty()) {
+                        auto pos = key.rfind('/');
+                        self.invalidations += self.entries.erase(pos == std::string::npos ? std::string() : key.substr(0, pos));
+                    }
+                    subtrees.emplace_back(std::move(key));
+                }
+            }
+            if (subtrees.empty()) {
+                return;
+            }
+            for (auto it = self.entries.begin(); it != self.entries.end();) {
+                bool remove = false;
+                for (auto& prefix : subtrees) {
+                    if (is_below(it->first, prefix)) {
+                        remove = true;
+                        break;
+                    }
+                }
+                if (remove) {
+                    it = self.entries.erase(it);
+                    self.invalidations++;
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        // Returns the entry for 'path', or nullptr when it can't be cached: the
+        // cache is closed, the path is outside the root, or it is a symlink
+        // whose target may not be watched.
+        static statcache::entry* lookup(statcache& self, const fs::path& path) {
+            if (!self.thread) {
+                return nullptr;
+            }
+            apply(self);
+            std::string key;
+            if (!makekey(self, path, key)) {
+                self.uncached++;
+                return nullptr;
+            }
+            auto it = self.entries.find(key);
+            if (it != self.entries.end()) {
+                self.hits++;
+                return &it->second;
+            }
+            self.misses++;
+            std::error_code ec;
+            auto status = fs::symlink_status(path, ec);
+            if (fs::is_symlink(status)) {
+                return nullptr;
+            }
+            auto& e  = self.entries[std::move(key)];
+            e.status = status;
+            return &e;
+        }
+
+        static statcache& to(lua_State* L, int idx) {
+            return lua::checkudata<statcache>(L, idx);
+        }
+
+        static fs::file_status getstatus(statcache& self, path_ptr& p) {
+            if (auto e = lookup(self, p)) {
+                return e->status;
+            }
+            std::error_code ec;
+            return fs::status(p, ec);
+        }
+
+        static int status(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            file_status::push(L, getstatus(self, p));
+            return 1;
+        }
+
+        static int exists(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            lua_pushboolean(L, fs::exists(getstatus(self, p)));
+            return 1;
+        }
+
+        static int is_directory(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            lua_pushboolean(L, fs::is_directory(getstatus(self, p)));
+            return 1;
+        }
+
+        static int is_regular_file(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            lua_pushboolean(L, fs::is_regular_file(getstatus(self, p)));
+            return 1;
+        }
+
+        static lua::cxx::status last_write_time(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            auto e     = lookup(self, p);
+            if (e && e->has_mtime) {
+                lua_pushinteger(L, e->mtime);
+                return 1;
+            }
+            std::error_code ec;
+            auto time = fs::last_write_time(p, ec);
+            if (ec) {
+                return pusherror(L, "last_write_time", ec, p);
+            }
+            lua_Integer mtime = to_seconds(time);
+            if (e) {
+                e->mtime     = mtime;
+                e->has_mtime = true;
+            }
+            lua_pushinteger(L, mtime);
+            return 1;
+        }
+
+        static lua::cxx::status file_size(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            auto e     = lookup(self, p);
+            if (e && e->has_size) {
+                lua_pushinteger(L, static_cast<lua_Integer>(e->size));
+                return 1;
+            }
+            std::error_code ec;
+            auto size = fs::file_size(p, ec);
+            if (ec) {
+                return pusherror(L, "file_size", ec, p);
+            }
+            if (e) {
+                e->size     = size;
+                e->has_size = true;
+            }
+            lua_pushinteger(L, static_cast<lua_Integer>(size));
+            return 1;
+        }
+
+        // Creates and removes a marker file in the root and waits until the
+        // watcher has seen it. Events are delivered in order, so every change
+        // made before the call is applied afterwards. Returns false when the
+        // marker can't be written or is not seen within 'timeout' seconds.
+        static int sync(lua_State* L) {
+            auto& self         = to(L, 1);
+            lua_Number timeout = luaL_optnumber(L, 2, 1.0);
+            luaL_argcheck(L, timeout >= 0 && timeout <= 86400, 2, "timeout out of range");
+            if (!self.thread) {
+                lua_pushboolean(L, 0);
+                return 1;
+            }
+            std::string name = ".bee-cache-sync." + std::to_string((uintptr_t)&self) + "." + std::to_string(++self.syncs);
+            {
+                std::unique_lock<std::mutex> lk(self.mutex);
+                self.marker      = "/" + name;
+                self.marker_seen = false;
+            }
+            fs::path marker = self.path / name;
+            bool written    = false;
+#    if defined(_WIN32)
+            FILE* f = _wfopen(marker.c_str(), L"wb");
+#    else
+            FILE* f = fopen(marker.c_str(), "wb");
+#    endif
+            if (f) {
+                fclose(f);
+                std::error_code ec;
+                written = fs::remove(marker, ec);
+            }
+            bool ok = false;
+            {
+                std::unique_lock<std::mutex> lk(self.mutex);
+                if (written) {
+                    ok = self.synced.wait_for(lk, std::chrono::duration<double>(timeout), [&] { return self.marker_seen; });
+                }
+            }
+            // the marker changed the root's mtime
+            self.invalidations += self.entries.erase(std::string());
+            apply(self);
+            lua_pushboolean(L, ok);
+            return 1;
+        }
+
+        static int clear(lua_State* L) {
+            auto& self = to(L, 1);
+            apply(self);
+            self.entries.clear();
+            return 0;
+        }
+
+        static int stats(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_createtable(L, 0, 6);
+            lua_pushinteger(L, (lua_Integer)self.hits);
+            lua_setfield(L, -2, "hits");
+            lua_pushinteger(L, (lua_Integer)self.misses);
+            lua_setfield(L, -2, "misses");
+            lua_pushinteger(L, (lua_Integer)self.uncached);
+            lua_setfield(L, -2, "uncached");
+            lua_pushinteger(L, (lua_Integer)self.invalidations);
+            lua_setfield(L, -2, "invalidations");
+            lua_pushinteger(L, (lua_Integer)self.overflows);
+            lua_setfield(L, -2, "overflows");
+            lua_pushinteger(L, (lua_Integer)self.entries.size());
+            lua_setfield(L, -2, "entries");
+            return 1;
+        }
+
+        static int mt_close(lua_State* L) {
+            auto& self = to(L, 1);
+            self.stop();
+            self.entries.clear();
+            return 0;
+        }
+
+        static void watcher(void* ud) noexcept {
+            auto& self = *static_cast<statcache*>(ud);
+            thread_setname("bee.fs.cache");
+            while (!self.quit) {
+                bool seen;
+                {
+                    std::unique_lock<std::mutex> lk(self.mutex);
+                    self.drain();
+                    seen = self.marker_seen;
+                }
+                if (seen) {
+                    self.synced.notify_all();
+                }
+                self.watch.wait(-1);
+            }
+        }
+
+        static void metatable(lua_State* L) {
+            static luaL_Reg lib[] = {
+                { "status", status },
+                { "exists", exists },
+                { "is_directory", is_directory },
+                { "is_regular_file", is_regular_file },
+                { "last_write_time", lua::cxx::cfunc<last_write_time> },
+                { "file_size", lua::cxx::cfunc<file_size> },
+                { "sync", sync },
+                { "clear", clear },
+                { "stats", stats },
+                { "close", mt_close },
+                { NULL, NULL }
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+            static luaL_Reg mt[] = {
+                { "__close", mt_close },
+                { NULL, NULL }
+            };
+            luaL_setfuncs(L, mt, 0);
+        }
+
+        static lua::cxx::status create(lua_State* L) {
+            path_ptr p = getpathptr(L, 1);
+            std::error_code ec;
+            fs::path given = fs::absolute(p, ec);
+            if (ec) {
+                return pusherror(L, "cache", ec, p);
+            }
+            fs::path root = fs::canonical(p, ec);
+            if (ec) {
+                return pusherror(L, "cache", ec, p);
+            }
+            if (!fs::is_directory(root, ec)) {
+                return pusherror(L, "cache", ec ? ec : std::make_error_code(std::errc::not_a_directory), root);
+            }
+            auto& self = lua::newudata<statcache>(L, metatable);
+            self.path  = root;
+            self.fold  = case_insensitive(root);
+            self.roots.emplace_back(makeabskey(root, self.fold));
+            auto alias = makeabskey(given, self.fold);
+            if (alias != self.roots[0]) {
+                self.roots.emplace_back(std::move(alias));
+            }
+            self.watch.set_recursive(true);
+            self.watch.add(root.native());
+            self.thread = thread_create(watcher, &self);
+            if (!self.thread) {
+                lua_pushnil(L);
+                lua_pushstring(L, make_syserror("thread_create").c_str());
+                return 2;
+            }
+            return 1;
+        }
+    }
+#endif
+
+#if !defined(__EMSCRIPTEN__)
+    namespace store {
+        static cas& to(lua_State* L, int idx) {
+            return lua::checkudata<cas>(L, idx);
+        }
+
+        static std::string checkkey(lua_State* L, int idx) {
+            auto s = lua::checkstrview(L, idx);
+            luaL_argcheck(L, cas::valid_key({ s.data(), s.size() }), idx, "invalid key");
+            return { s.data(), s.size() };
+        }
+
+        static const char* methodname(cas::method m) {
+            switch (m) {
+            case cas::method::reflink:
+                return "reflink";
+            case cas::method::hardlink:
+                return "hardlink";
+            case cas::method::copy:
+                return "copy";
+            default:
+                std::unreachable();
+            }
+        }
+
+        static lua::cxx::status put(lua_State* L) {
+            auto& self = to(L, 1);
+            path_ptr p = getpathptr(L, 2);
+            std::error_code ec;
+            auto key = self.put(p, ec);
+            if (ec) {
+                return pusherror(L, "cas::put", ec, p);
+            }
+            lua_pushlstring(L, key.data(), key.size());
+            return 1;
+        }
+
+        static int put_many(lua_State* L) {
+            auto& self = to(L, 1);
+            luaL_checktype(L, 2, LUA_TTABLE);
+            int threads = (int)luaL_optinteger(L, 3, (lua_Integer)std::thread::hardware_concurrency());
+            lua_Integer n = luaL_len(L, 2);
+            for (lua_Integer i = 1; i <= n; ++i) {
+                lua_geti(L, 2, i);
+                getpathptr(L, -1);
+                lua_pop(L, 1);
+            }
+            std::vector<fs::path> paths;
+            paths.reserve((size_t)n);
+            for (lua_Integer i = 1; i <= n; ++i) {
+                lua_geti(L, 2, i);
+                path_ptr p = getpathptr(L, -1);
+                paths.emplace_back(static_cast<const fs::path&>(p));
+                lua_pop(L, 1);
+            }
+            std::vector<std::error_code> ec;
+            auto keys = self.put_many(paths, ec, threads);
+            lua_createtable(L, (int)n, 0);
+            lua_newtable(L);
+            for (size_t i = 0; i < paths.size(); ++i) {
+                if (ec[i]) {
+                    lua_pushboolean(L, 0);
+                    lua_rawseti(L, -3, (lua_Integer)i + 1);
+                    (void)pusherror(L, "cas::put", ec[i], paths[i]);
+                    lua_rawseti(L, -2, (lua_Integer)i + 1);
+                }
+                else {
+                    lua_pushlstring(L, keys[i].data(), keys[i].size());
+                    lua_rawseti(L, -3, (lua_Integer)i + 1);
+                }
+            }
+            return 2;
+        }
+
+        static lua::cxx::status get(lua_State* L) {
+            auto& self     = to(L, 1);
+            auto key       = checkkey(L, 2);
+            path_ptr dest  = getpathptr(L, 3);
+            bool hardlink  = lua_isnoneornil(L, 4) || lua_toboolean(L, 4);
+            cas::method m  = cas::method::copy;
+            std::error_code ec;
+            if (!self.get(key, dest, hardlink, m, ec)) {
+                return pusherror(L, "cas::get", ec, dest);
+            }
+            lua_pushstring(L, methodname(m));
+            return 1;
+        }
+
+        static int has(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushboolean(L, self.has(checkkey(L, 2)));
+            return 1;
+        }
+
+        static int blob(lua_State* L) {
+            auto& self = to(L, 1);
+            path::push(L, self.blob(checkkey(L, 2)));
+            return 1;
+        }
+
+        static lua::cxx::status gc(lua_State* L) {
+            auto& self = to(L, 1);
+            auto max   = lua::checkinteger<lua_Integer>(L, 2);
+            luaL_argcheck(L, max >= 0, 2, "must not be negative");
+            std::error_code ec;
+            auto r = self.gc((uint64_t)max, ec);
+            if (ec) {
+                return pusherror(L, "cas::gc", ec);
+            }
+            lua_pushinteger(L, (lua_Integer)r.removed);
+            lua_pushinteger(L, (lua_Integer)r.freed);
+            lua_pushinteger(L, (lua_Integer)r.remaining);
+            return 3;
+        }
+
+        static int mt_close(lua_State* L) {
+            auto& self = to(L, 1);
+            self.close();
+            return 0;
+        }
+
+        static void metatable(lua_State* L) {
+            static luaL_Reg lib[] = {
+                { "put", lua::cxx::cfunc<put> },
+                { "put_many", put_many },
+                { "get", lua::cxx::cfunc<get> },
+                { "has", has },
+                { "blob", blob },
+                { "gc", lua::cxx::cfunc<gc> },
+                { "close", mt_close },
+                { NULL, NULL }
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+            static luaL_Reg mt[] = {
+                { "__close", mt_close },
+                { NULL, NULL }
+            };
+            luaL_setfuncs(L, mt, 0);
+        }
+
+        static lua::cxx::status create(lua_State* L) {
+            path_ptr root = getpathptr(L, 1);
+            auto& self    = lua::newudata<cas>(L, metatable);
+            std::error_code ec;
+            if (!self.open(root, ec)) {
+                return pusherror(L, "cas", ec, root);
+            }
+            return 1;
+        }
+    }
+
+    namespace writer {
+        static file_writer& to(lua_State* L, int idx) {
+            return lua::checkudata<file_writer>(L, idx);
+        }
+
+        static lua::cxx::status write(lua_State* L) {
+            auto& self = to(L, 1);
+            const char* data;
+            size_t len;
+            if (lua_type(L, 2) == LUA_TLIGHTUSERDATA) {
+                data = lua::tolightud<const char*>(L, 2);
+                len  = lua::checkinteger<size_t>(L, 3);
+            }
+            else {
+                data = luaL_checklstring(L, 2, &len);
+            }
+            std::error_code ec;
+            if (!self.write(data, len, ec)) {
+                return pusherror(L, "writer::write", ec);
+            }
+            return 0;
+        }
+
+        static lua::cxx::status close(lua_State* L) {
+            auto& self = to(L, 1);
+            std::error_code ec;
+            if (!self.close(ec)) {
+                return pusherror(L, "writer::close", ec);
+            }
+            return 0;
+        }
+
+        static int size(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushinteger(L, (lua_Integer)self.size());
+            return 1;
+        }
+
+        static int direct(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushboolean(L, self.direct());
+            return 1;
+        }
+
+        static int preallocated(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushboolean(L, self.preallocated());
+            return 1;
+        }
+
+        static void metatable(lua_State* L) {
+            static luaL_Reg lib[] = {
+                { "write", lua::cxx::cfunc<write> },
+                { "close", lua::cxx::cfunc<close> },
+                { "size", size },
+                { "direct", direct },
+                { "preallocated", preallocated },
+                { NULL, NULL }
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+            static luaL_Reg mt[] = {
+                { "__close", lua::cxx::cfunc<close> },
+                { NULL, NULL }
+            };
+            luaL_setfuncs(L, mt, 0);
+        }
+
+        static uint64_t optfield(lua_State* L, int idx, const char* name, uint64_t def) {
+            if (LUA_TNIL == lua_getfield(L, idx, name)) {
+                lua_pop(L, 1);
+                return def;
+            }
+            auto v = lua::checkinteger<lua_Integer>(L, -1);
+            lua_pop(L, 1);
+            if (v < 0) {
+                luaL_error(L, "`%s` must not be negative", name);
+            }
+            return (uint64_t)v;
+        }
+
+        static lua::cxx::status create(lua_State* L) {
+            file_writer::options opts;
+            if (!lua_isnoneornil(L, 2)) {
+                luaL_checktype(L, 2, LUA_TTABLE);
+                opts.preallocate = optfield(L, 2, "preallocate", opts.preallocate);
+                opts.buffers     = (int)optfield(L, 2, "buffers", opts.buffers);
+                opts.block_size  = (size_t)optfield(L, 2, "block_size", opts.block_size);
+                opts.sync_bytes  = optfield(L, 2, "sync_bytes", opts.sync_bytes);
+                lua_getfield(L, 2, "direct");
+                opts.direct = lua_toboolean(L, -1);
+                lua_pop(L, 1);
+            }
+            path_ptr path = getpathptr(L, 1);
+            auto& self    = lua::newudata<file_writer>(L, metatable);
+            std::error_code ec;
+            if (!self.open(path, opts, ec)) {
+                return pusherror(L, "open_writer", ec, path);
+            }
+            return 1;
+        }
+    }
+#endif
+
     static int luaopen(lua_State* L) {
         static luaL_Reg lib[] = {
             { "path", path::constructor },
@@ -1135,9 +1917,14 @@ namespace bee::lua_filesystem {
             { "dll_path", dll_path },
 #if !defined(__EMSCRIPTEN__)
             { "filelock", filelock },
+            { "cas", lua::cxx::cfunc<store::create> },
+            { "open_writer", lua::cxx::cfunc<writer::create> },
 #    if !defined(BEE_DISABLE_FULLPATH)
             { "fullpath", fullpath },
 #    endif
+#endif
+#if !defined(BEE_DISABLE_FSCACHE)
+            { "cache", lua::cxx::cfunc<cache::create> },
 #endif
             { "copy_options", NULL },
             { "perm_options", NULL },
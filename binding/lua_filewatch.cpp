@@ -1,15 +1,82 @@
 #include <bee/error.h>
 #include <bee/filewatch.h>
+#include <bee/filewatch/content_filter.h>
 #include <bee/nonstd/filesystem.h>
 #include <bee/nonstd/unreachable.h>
+#include <bee/thread/setname.h>
+#include <bee/thread/simplethread.h>
 #include <binding/binding.h>
+#include <binding/channel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <3rd/lua-seri/lua-seri.h>
+}
+
+namespace bee::lua_filewatch {
+    // Runs a watch on its own native thread, so the kernel queue is drained even
+    // when no Lua code calls select(). Batches are pushed into a bee.thread channel.
+    struct threadwatch {
+        filewatch::watch watch;
+        std::mutex mutex;
+        lua_thread::boxchannel channel;
+        std::vector<std::string> ignore;
+        std::unique_ptr<filewatch::content_filter> content;
+        int interval = -1;
+        std::atomic<bool> quit { false };
+        thread_handle thread = nullptr;
+
+        ~threadwatch() {
+            stop();
+        }
+        bool ignored(const char* path) const noexcept {
+            for (auto& pattern : ignore) {
+                if (strstr(path, pattern.c_str())) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        void stop() noexcept {
+            if (thread) {
+                quit = true;
+                watch.wakeup();
+                thread_wait(thread);
+                thread = nullptr;
+            }
+            if (content) {
+                content->stop();
+            }
+            std::unique_lock<std::mutex> lk(mutex);
+            watch.stop();
+        }
+    };
+}
 
 namespace bee::lua {
     template <>
     struct udata<filewatch::watch> {
-        static inline int nupvalue = 1;
+        static inline int nupvalue = 2;
         static inline auto name    = "bee::filewatch";
     };
+    template <>
+    struct udata<filewatch::content_filter> {
+        static inline auto name = "bee::filewatch::content_filter";
+    };
+    template <>
+    struct udata<lua_filewatch::threadwatch> {
+        static inline auto name = "bee::filewatch::thread";
+    };
 }
 
 namespace bee::lua_filewatch {
@@ -24,17 +91,21 @@ namespace bee::lua_filewatch {
         return thread;
     }
 
-    static int add(lua_State* L) {
-        filewatch::watch& self = to(L, 1);
-        auto path              = lua::checkstring(L, 2);
+    static filewatch::watch::string_type checkpath(lua_State* L, int idx) {
+        auto path = lua::checkstring(L, idx);
         std::error_code ec;
         fs::path abspath = fs::absolute(path, ec);
         if (ec) {
             lua_pushstring(L, make_error(ec, "fs::absolute").c_str());
             lua_error(L);
-            return 0;
+            std::unreachable();
         }
-        self.add(abspath.lexically_normal().string<filewatch::watch::string_type::value_type>());
+        return abspath.lexically_normal().string<filewatch::watch::string_type::value_type>();
+    }
+
+    static int add(lua_State* L) {
+        filewatch::watch& self = to(L, 1);
+        self.add(checkpath(L, 2));
         return 0;
     }
 
@@ -82,10 +153,69 @@ namespace bee::lua_filewatch {
         return 1;
     }
 
+    static filewatch::content_filter* get_content_filter(lua_State* L) {
+        lua_getiuservalue(L, 1, 2);
+        auto filter = static_cast<filewatch::content_filter*>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+        return filter;
+    }
+
+    static void content_filter_metatable(lua_State*) {}
+
+    // A disabled filter stays attached until select() has handed out the
+    // events it still held; enabling it again picks up the same queue.
+    static int set_content_filter(lua_State* L) {
+        to(L, 1);
+        bool enable = lua_toboolean(L, 2);
+        auto filter = get_content_filter(L);
+        if (enable) {
+            if (!filter) {
+                filter = &lua::newudata<filewatch::content_filter>(L, content_filter_metatable);
+                lua_setiuservalue(L, 1, 2);
+            }
+            if (!filter->start()) {
+                lua_pushstring(L, make_syserror("thread_create").c_str());
+                return lua_error(L);
+            }
+        }
+        else if (filter) {
+            filter->flush();
+        }
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+
+    static int content_stats(lua_State* L) {
+        to(L, 1);
+        auto filter = get_content_filter(L);
+        lua_pushinteger(L, filter ? (lua_Integer)filter->hashed() : 0);
+        lua_pushinteger(L, filter ? (lua_Integer)filter->suppressed() : 0);
+        return 2;
+    }
+
     static int select(lua_State* L) {
         filewatch::watch& self = to(L, 1);
         self.update();
-        auto notify = self.select();
+        std::optional<filewatch::notify> notify;
+        auto filter = get_content_filter(L);
+        if (filter && filter->running()) {
+            while (auto n = self.select()) {
+                filter->push(std::move(*n));
+            }
+            notify = filter->select();
+        }
+        else {
+            if (filter) {
+                notify = filter->select();
+                if (!notify) {
+                    lua_pushnil(L);
+                    lua_setiuservalue(L, 1, 2);
+                }
+            }
+            if (!notify) {
+                notify = self.select();
+            }
+        }
         if (!notify) {
             return 0;
         }
@@ -96,6 +226,9 @@ namespace bee::lua_filewatch {
         case filewatch::notify::flag::rename:
             lua_pushstring(L, "rename");
             break;
+        case filewatch::notify::flag::overflow:
+            lua_pushstring(L, "overflow");
+            break;
         default:
             std::unreachable();
         }
@@ -115,6 +248,8 @@ namespace bee::lua_filewatch {
             { "set_recursive", set_recursive },
             { "set_follow_symlinks", set_follow_symlinks },
             { "set_filter", set_filter },
+            { "set_content_filter", set_content_filter },
+            { "content_stats", content_stats },
             { "select", select },
             { NULL, NULL }
         };
@@ -128,7 +263,205 @@ namespace bee::lua_filewatch {
         luaL_setfuncs(L, mt, 0);
     }
 
+    namespace thread {
+        static threadwatch& to(lua_State* L, int idx) {
+            return lua::checkudata<threadwatch>(L, idx);
+        }
+
+        static const char* flagname(filewatch::notify::flag flag) {
+            switch (flag) {
+            case filewatch::notify::flag::modify:
+                return "modify";
+            case filewatch::notify::flag::rename:
+                return "rename";
+            case filewatch::notify::flag::overflow:
+                return "overflow";
+            default:
+                std::unreachable();
+            }
+        }
+
+        static int pack_batch(lua_State* L) {
+            auto& batch = *lua::tolightud<std::vector<filewatch::notify>*>(L, 1);
+            lua_settop(L, 0);
+            lua_createtable(L, (int)batch.size(), 0);
+            lua_Integer i = 0;
+            for (auto& n : batch) {
+                lua_createtable(L, 2, 0);
+                lua_pushstring(L, flagname(n.flags));
+                lua_rawseti(L, -2, 1);
+                lua_pushlstring(L, n.path.data(), n.path.size());
+                lua_rawseti(L, -2, 2);
+                lua_rawseti(L, -2, ++i);
+            }
+            lua_pushlightuserdata(L, seri_pack(L, 0, NULL));
+            return 1;
+        }
+
+        static void push_batch(lua_State* L, threadwatch& self, std::vector<filewatch::notify>& batch) {
+            lua_pushcfunction(L, pack_batch);
+            lua_pushlightuserdata(L, &batch);
+            if (lua_pcall(L, 1, 1, 0) == LUA_OK) {
+                lua_thread::channel_push(*self.channel, lua_touserdata(L, -1));
+            }
+            lua_settop(L, 0);
+        }
+
+        static void main(void* ud) noexcept {
+            auto& self = *static_cast<threadwatch*>(ud);
+            thread_setname("bee.filewatch");
+            lua_State* L = luaL_newstate();
+            std::vector<filewatch::notify> batch;
+            std::set<std::pair<filewatch::notify::flag, std::string>> seen;
+            while (!self.quit) {
+                {
+                    std::unique_lock<std::mutex> lk(self.mutex);
+                    self.watch.update();
+                    while (auto n = self.watch.select()) {
+                        if (self.ignored(n->path.c_str())) {
+                            continue;
+                        }
+                        if (self.content) {
+                            self.content->push(std::move(*n));
+                        }
+                        else if (seen.emplace(n->flags, n->path).second) {
+                            batch.emplace_back(std::move(*n));
+                        }
+                    }
+                }
+                if (self.content) {
+                    while (auto n = self.content->select()) {
+                        if (seen.emplace(n->flags, n->path).second) {
+                            batch.emplace_back(std::move(*n));
+                        }
+                    }
+                }
+                if (!batch.empty()) {
+                    if (L) {
+                        push_batch(L, self, batch);
+                    }
+                    batch.clear();
+                    seen.clear();
+                    continue;
+                }
+                self.watch.wait(self.interval);
+            }
+            if (L) {
+                lua_close(L);
+            }
+        }
+
+        static int add(lua_State* L) {
+            auto& self = to(L, 1);
+            auto path  = checkpath(L, 2);
+            std::unique_lock<std::mutex> lk(self.mutex);
+            self.watch.add(path);
+            self.watch.wakeup();
+            return 0;
+        }
+
+        static int set_recursive(lua_State* L) {
+            auto& self  = to(L, 1);
+            bool enable = lua_toboolean(L, 2);
+            std::unique_lock<std::mutex> lk(self.mutex);
+            self.watch.set_recursive(enable);
+            lua_pushboolean(L, 1);
+            return 1;
+        }
+
+        static int set_follow_symlinks(lua_State* L) {
+            auto& self  = to(L, 1);
+            bool enable = lua_toboolean(L, 2);
+            std::unique_lock<std::mutex> lk(self.mutex);
+            bool ok = self.watch.set_follow_symlinks(enable);
+            lua_pushboolean(L, ok);
+            return 1;
+        }
+
+        static int mt_close(lua_State* L) {
+            auto& self = to(L, 1);
+            self.stop();
+            return 0;
+        }
+
+        static void metatable(lua_State* L) {
+            static luaL_Reg lib[] = {
+                { "add", add },
+                { "set_recursive", set_recursive },
+                { "set_follow_symlinks", set_follow_symlinks },
+                { "close", mt_close },
+                { NULL, NULL }
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+            static luaL_Reg mt[] = {
+                { "__close", mt_close },
+                { NULL, NULL }
+            };
+            luaL_setfuncs(L, mt, 0);
+        }
+
+        static int create(lua_State* L) {
+            if (lua_getfield(L, 1, "channel") != LUA_TSTRING) {
+                return luaL_error(L, "thread mode requires a `channel` name");
+            }
+            auto name = lua::checkstrview(L, -1);
+            lua_pop(L, 1);
+            int interval = -1;
+            if (lua_getfield(L, 1, "interval") != LUA_TNIL) {
+                lua_Number sec = luaL_checknumber(L, -1);
+                luaL_argcheck(L, sec > 0 && sec <= INT_MAX / 1000, 1, "`interval` must be greater than zero and at most 2147483 seconds");
+                interval = std::max(1, (int)(sec * 1000));
+            }
+            lua_pop(L, 1);
+            std::vector<std::string> ignore;
+            if (lua_getfield(L, 1, "ignore") != LUA_TNIL) {
+                luaL_checktype(L, -1, LUA_TTABLE);
+                lua_Integer n = luaL_len(L, -1);
+                for (lua_Integer i = 1; i <= n; ++i) {
+                    lua_geti(L, -1, i);
+                    auto pattern = lua::checkstrview(L, -1);
+                    ignore.emplace_back(pattern.data(), pattern.size());
+                    lua_pop(L, 1);
+                }
+            }
+            lua_pop(L, 1);
+            lua_getfield(L, 1, "content_filter");
+            bool content = lua_toboolean(L, -1);
+            lua_pop(L, 1);
+            auto& self    = lua::newudata<threadwatch>(L, metatable);
+            self.channel  = lua_thread::channel_open({ name.data(), name.size() });
+            self.interval = interval;
+            self.ignore   = std::move(ignore);
+            if (!self.ignore.empty()) {
+                self.watch.set_filter([&self](const char* path) { return !self.ignored(path); });
+            }
+            if (content) {
+                self.content = std::make_unique<filewatch::content_filter>();
+                self.content->set_ready([&self] { self.watch.wakeup(); });
+                if (!self.content->start()) {
+                    lua_pushstring(L, make_syserror("thread_create").c_str());
+                    return lua_error(L);
+                }
+            }
+            self.thread = thread_create(main, &self);
+            if (!self.thread) {
+                lua_pushstring(L, make_syserror("thread_create").c_str());
+                return lua_error(L);
+            }
+            return 1;
+        }
+    }
+
     static int create(lua_State* L) {
+        if (lua_istable(L, 1)) {
+            if (lua_getfield(L, 1, "thread") != LUA_TNIL && lua_toboolean(L, -1)) {
+                lua_pop(L, 1);
+                return thread::create(L);
+            }
+            lua_pop(L, 1);
+        }
         lua::newudata<filewatch::watch>(L, metatable);
         lua_newthread(L);
         lua_setiuservalue(L, -2, 1);
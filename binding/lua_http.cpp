@@ -0,0 +1,258 @@
+#include <bee/net/http.h>
+#include <bee/nonstd/unreachable.h>
+#include <binding/binding.h>
+
+#include <cctype>
+#include <cstdio>
+#include <string>
+
+namespace bee::lua {
+    template <>
+    struct udata<net::http::parser> {
+        static inline auto name = "bee::net::http::parser";
+    };
+}
+
+namespace bee::lua_http {
+    static void push_request(lua_State* L, net::http::request& req) {
+        lua_createtable(L, 0, 6);
+        lua_pushlstring(L, req.method.data(), req.method.size());
+        lua_setfield(L, -2, "method");
+        lua_pushlstring(L, req.path.data(), req.path.size());
+        lua_setfield(L, -2, "path");
+        lua_pushfstring(L, "1.%d", req.minor_version);
+        lua_setfield(L, -2, "version");
+        lua_createtable(L, 0, (int)req.headers.size());
+        for (auto& [name, value] : req.headers) {
+            for (auto& c : name) {
+                c = (char)tolower((unsigned char)c);
+            }
+            lua_pushlstring(L, name.data(), name.size());
+            if (LUA_TSTRING == lua_rawget(L, -2)) {
+                lua_pushlstring(L, ", ", 2);
+                lua_pushlstring(L, value.data(), value.size());
+                lua_concat(L, 3);
+            }
+            else {
+                lua_pop(L, 1);
+                lua_pushlstring(L, value.data(), value.size());
+            }
+            lua_pushlstring(L, name.data(), name.size());
+            lua_insert(L, -2);
+            lua_rawset(L, -3);
+        }
+        lua_setfield(L, -2, "headers");
+        lua_pushlstring(L, req.body.data(), req.body.size());
+        lua_setfield(L, -2, "body");
+        lua_pushboolean(L, req.keepalive);
+        lua_setfield(L, -2, "keepalive");
+    }
+
+    namespace parser {
+        static int feed(lua_State* L) {
+            auto& self = lua::checkudata<net::http::parser>(L, 1);
+            auto data  = lua::checkstrview(L, 2);
+            self.feed(data.data(), data.size());
+            return 0;
+        }
+        static int next(lua_State* L) {
+            auto& self = lua::checkudata<net::http::parser>(L, 1);
+            net::http::request req;
+            switch (self.next(req)) {
+            case net::http::parser::result::ok:
+                push_request(L, req);
+                return 1;
+            case net::http::parser::result::incomplete:
+                lua_pushboolean(L, 0);
+                return 1;
+            case net::http::parser::result::error: {
+                auto err = self.error();
+                lua_pushnil(L);
+                lua_pushlstring(L, err.data(), err.size());
+                return 2;
+            }
+            default:
+                std::unreachable();
+            }
+        }
+        static int buffered(lua_State* L) {
+            auto& self = lua::checkudata<net::http::parser>(L, 1);
+            lua_pushinteger(L, (lua_Integer)self.buffered());
+            return 1;
+        }
+        static void metatable(lua_State* L) {
+            luaL_Reg lib[] = {
+                { "feed", feed },
+                { "next", next },
+                { "buffered", buffered },
+                { NULL, NULL },
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+        }
+        static size_t optsize(lua_State* L, int idx, const char* name, size_t def) {
+            if (LUA_TNIL == lua_getfield(L, idx, name)) {
+                lua_pop(L, 1);
+                return def;
+            }
+            auto v = lua::checkinteger<lua_Integer>(L, -1);
+            lua_pop(L, 1);
+            if (v <= 0) {
+                luaL_error(L, "`%s` must be greater than zero", name);
+            }
+            return (size_t)v;
+        }
+        static int create(lua_State* L) {
+            net::http::parser::options opts;
+            if (!lua_isnoneornil(L, 1)) {
+                luaL_checktype(L, 1, LUA_TTABLE);
+                opts.max_header_size = optsize(L, 1, "max_header_size", opts.max_header_size);
+                opts.max_headers     = optsize(L, 1, "max_headers", opts.max_headers);
+                opts.max_body_size   = optsize(L, 1, "max_body_size", opts.max_body_size);
+            }
+            lua::newudata<net::http::parser>(L, metatable, opts);
+            return 1;
+        }
+    }
+
+    static bool is_header(std::string_view name, std::string_view expected) {
+        if (name.size() != expected.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < name.size(); ++i) {
+            if (tolower((unsigned char)name[i]) != expected[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static const char* add_field(lua_State* L, std::string& out, std::string_view name, int vidx) {
+        int t = lua_type(L, vidx);
+        if (t != LUA_TSTRING && t != LUA_TNUMBER) {
+            return "header value must be a string";
+        }
+        size_t sz;
+        const char* str = lua_tolstring(L, vidx, &sz);
+        std::string_view value { str, sz };
+        if (!net::http::valid_field_value(value)) {
+            return "invalid header value";
+        }
+        out.append(name.data(), name.size());
+        out.append(": ", 2);
+        out.append(value.data(), value.size());
+        out.append("\r\n", 2);
+        return nullptr;
+    }
+
+    static const char* add_headers(lua_State* L, std::string& out, bool& framed) {
+        lua_pushnil(L);
+        while (lua_next(L, 2)) {
+            if (lua_type(L, -2) != LUA_TSTRING) {
+                return "header name must be a string";
+            }
+            size_t sz;
+            const char* str = lua_tolstring(L, -2, &sz);
+            std::string_view name { str, sz };
+            if (!net::http::valid_token(name)) {
+                return "invalid header name";
+            }
+            if (is_header(name, "content-length") || is_header(name, "transfer-encoding")) {
+                framed = true;
+            }
+            if (lua_type(L, -1) == LUA_TTABLE) {
+                lua_Integer n = luaL_len(L, -1);
+                for (lua_Integer i = 1; i <= n; ++i) {
+                    lua_geti(L, -1, i);
+                    if (auto err = add_field(L, out, name, lua_gettop(L))) {
+                        return err;
+                    }
+                    lua_pop(L, 1);
+                }
+            }
+            else if (auto err = add_field(L, out, name, lua_gettop(L))) {
+                return err;
+            }
+            lua_pop(L, 1);
+        }
+        return nullptr;
+    }
+
+    static int response(lua_State* L) {
+        auto status = lua::checkinteger<int>(L, 1);
+        luaL_argcheck(L, status >= 100 && status <= 999, 1, "invalid status code");
+        if (!lua_isnoneornil(L, 2)) {
+            luaL_checktype(L, 2, LUA_TTABLE);
+        }
+        const bool has_body = !lua_isnoneornil(L, 3);
+        std::string_view body;
+        if (has_body) {
+            auto s = lua::checkstrview(L, 3);
+            body   = { s.data(), s.size() };
+        }
+        lua_settop(L, 3);
+        const char* err = nullptr;
+        {
+            auto reason = net::http::reason_phrase(status);
+            std::string out;
+            out.reserve(128 + body.size());
+            out.append("HTTP/1.1 ");
+            out.append(std::to_string(status));
+            out.push_back(' ');
+            out.append(reason.data(), reason.size());
+            out.append("\r\n", 2);
+            bool framed = false;
+            if (!lua_isnil(L, 2)) {
+                err = add_headers(L, out, framed);
+            }
+            if (!err) {
+                if (has_body && !framed) {
+                    out.append("Content-Length: ");
+                    out.append(std::to_string(body.size()));
+                    out.append("\r\n", 2);
+                }
+                out.append("\r\n", 2);
+                out.append(body.data(), body.size());
+                lua_pushlstring(L, out.data(), out.size());
+                return 1;
+            }
+        }
+        return luaL_error(L, "%s", err);
+    }
+
+    static int chunk(lua_State* L) {
+        std::string_view data;
+        if (!lua_isnoneornil(L, 1)) {
+            auto s = lua::checkstrview(L, 1);
+            data   = { s.data(), s.size() };
+        }
+        if (data.empty()) {
+            lua_pushliteral(L, "0\r\n\r\n");
+            return 1;
+        }
+        luaL_Buffer b;
+        luaL_buffinit(L, &b);
+        char size[sizeof(size_t) * 2 + 3];
+        int n = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+        luaL_addlstring(&b, size, (size_t)n);
+        luaL_addlstring(&b, data.data(), data.size());
+        luaL_addlstring(&b, "\r\n", 2);
+        luaL_pushresult(&b);
+        return 1;
+    }
+
+    static int luaopen(lua_State* L) {
+        luaL_Reg lib[] = {
+            { "parser", parser::create },
+            { "response", response },
+            { "chunk", chunk },
+            { NULL, NULL },
+        };
+        luaL_newlibtable(L, lib);
+        luaL_setfuncs(L, lib, 0);
+        return 1;
+    }
+}
+
+DEFINE_LUAOPEN(http)
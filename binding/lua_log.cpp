@@ -0,0 +1,336 @@
+#include <3rd/fmt/fmt/format.h>
+#include <binding/binding.h>
+#include <bee/error.h>
+#include <bee/log/sink.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace bee::lua_log {
+    struct logger {
+        log::sink* sink;
+    };
+}
+
+namespace bee::lua {
+    template <>
+    struct udata<lua_log::logger> {
+        static inline auto name = "bee::log::sink";
+    };
+}
+
+namespace bee::lua_log {
+    // Lines are built in a per-thread buffer, so the Lua side of a write
+    // allocates nothing unless an argument needs __tostring.
+    static thread_local fmt::memory_buffer t_line;
+
+    // Stack address of the outermost write on this thread. A write made by a
+    // __tostring while a line is being formatted runs deeper, so it appends
+    // its own line after the unfinished one and cuts it off again. An error
+    // can unwind a write without resetting this; the next write that is not
+    // deeper simply takes over.
+    static thread_local uintptr_t t_owner = 0;
+
+    struct clock_cache {
+        time_t sec = -1;
+        char str[32];
+        size_t len = 0;
+    };
+    static thread_local clock_cache t_clock;
+
+    static void append_timestamp(fmt::memory_buffer& buf) noexcept {
+        auto now   = std::chrono::system_clock::now();
+        auto ms    = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+        time_t sec = (time_t)(ms / 1000);
+        if (sec != t_clock.sec) {
+            struct tm tm;
+#if defined(_WIN32)
+            localtime_s(&tm, &sec);
+#else
+            localtime_r(&sec, &tm);
+#endif
+            t_clock.len = strftime(t_clock.str, sizeof(t_clock.str), "%Y-%m-%d %H:%M:%S", &tm);
+            t_clock.sec = sec;
+        }
+        unsigned frac = (unsigned)(ms % 1000);
+        char tail[5]  = { '.', (char)('0' + frac / 100), (char)('0' + frac / 10 % 10), (char)('0' + frac % 10), ' ' };
+        buf.append(t_clock.str, t_clock.str + t_clock.len);
+        buf.append(tail, tail + sizeof(tail));
+    }
+
+    static auto& to(lua_State* L, int idx) {
+        return *lua::checkudata<logger>(L, idx).sink;
+    }
+
+    static void append_value(lua_State* L, int idx, fmt::memory_buffer& buf, fmt::string_view spec) {
+        auto out = fmt::appender(buf);
+        switch (lua_type(L, idx)) {
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, idx)) {
+                fmt::format_to(out, fmt::runtime(spec), (int64_t)lua_tointeger(L, idx));
+            }
+            else {
+                fmt::format_to(out, fmt::runtime(spec), (double)lua_tonumber(L, idx));
+            }
+            break;
+        case LUA_TBOOLEAN:
+            fmt::format_to(out, fmt::runtime(spec), (bool)lua_toboolean(L, idx));
+            break;
+        case LUA_TNIL:
+            fmt::format_to(out, fmt::runtime(spec), fmt::string_view { "nil", 3 });
+            break;
+        case LUA_TSTRING: {
+            size_t len;
+            const char* str = lua_tolstring(L, idx, &len);
+            fmt::format_to(out, fmt::runtime(spec), fmt::string_view { str, len });
+            break;
+        }
+        default: {
+            size_t len;
+            const char* str = luaL_tolstring(L, idx, &len);
+            fmt::format_to(out, fmt::runtime(spec), fmt::string_view { str, len });
+            lua_pop(L, 1);
+            break;
+        }
+        }
+    }
+
+    // Formats arguments first..top into buf, one per "{...}" field of fmt,
+    // with any left over appended separated by spaces. Returns an error
+    // message, or nullptr on success.
+    static const char* format_line(lua_State* L, fmt::memory_buffer& buf, const char* fmt, size_t len, int arg, int top) {
+        const char* end = fmt + len;
+        const char* p   = fmt;
+        while (p < end) {
+            const char* brace = p;
+            while (brace < end && *brace != '{' && *brace != '}') {
+                brace++;
+            }
+            buf.append(p, brace);
+            if (brace == end) {
+                break;
+            }
+            if (brace + 1 < end && brace[1] == *brace) {
+                buf.push_back(*brace);
+                p = brace + 2;
+                continue;
+            }
+            if (*brace == '}') {
+                return "unmatched '}' in format string";
+            }
+            const char* close = brace + 1;
+            while (close < end && *close != '}') {
+                close++;
+            }
+            if (close == end) {
+                return "unmatched '{' in format string";
+            }
+            if (arg > top) {
+                return "missing argument for format field";
+            }
+            try {
+                append_value(L, arg++, buf, fmt::string_view { brace, (size_t)(close - brace + 1) });
+            } catch (const fmt::format_error&) {
+                return "invalid format field";
+            }
+            p = close + 1;
+        }
+        for (; arg <= top; ++arg) {
+            buf.push_back(' ');
+            append_value(L, arg, buf, "{}");
+        }
+        return nullptr;
+    }
+
+    static int write(lua_State* L) {
+        auto& self   = to(L, 1);
+        auto fmt     = lua::checkstrview(L, 2);
+        int top      = lua_gettop(L);
+        auto& buf    = t_line;
+        uintptr_t sp = reinterpret_cast<uintptr_t>(&top);
+        bool nested  = t_owner != 0 && sp < t_owner;
+        size_t start = nested ? buf.size() : 0;
+        if (!nested) {
+            buf.clear();
+            t_owner = sp;
+        }
+        if (self.opts().timestamp) {
+            append_timestamp(buf);
+        }
+        const char* err = format_line(L, buf, fmt.data(), fmt.size(), 3, top);
+        bool ok         = false;
+        if (!err) {
+            buf.push_back('\n');
+            ok = self.write(buf.data() + start, buf.size() - start);
+        }
+        if (nested) {
+            buf.resize(start);
+        }
+        else {
+            t_owner = 0;
+        }
+        if (err) {
+            return luaL_error(L, "%s", err);
+        }
+        lua_pushboolean(L, ok);
+        return 1;
+    }
+
+    static int flush(lua_State* L) {
+        auto& self = to(L, 1);
+        self.flush();
+        return 0;
+    }
+
+    static int close(lua_State* L) {
+        auto& self = to(L, 1);
+        self.close();
+        return 0;
+    }
+
+    static int stats(lua_State* L) {
+        auto& self = to(L, 1);
+        auto s     = self.stats();
+        lua_createtable(L, 0, 4);
+        lua_pushinteger(L, (lua_Integer)s.lines);
+        lua_setfield(L, -2, "lines");
+        lua_pushinteger(L, (lua_Integer)s.bytes);
+        lua_setfield(L, -2, "bytes");
+        lua_pushinteger(L, (lua_Integer)s.dropped);
+        lua_setfield(L, -2, "dropped");
+        lua_pushinteger(L, (lua_Integer)s.rotations);
+        lua_setfield(L, -2, "rotations");
+        return 1;
+    }
+
+    static void metatable(lua_State* L) {
+        static luaL_Reg lib[] = {
+            { "write", write },
+            { "flush", flush },
+            { "close", close },
+            { "stats", stats },
+            { NULL, NULL }
+        };
+        luaL_newlibtable(L, lib);
+        luaL_setfuncs(L, lib, 0);
+        lua_setfield(L, -2, "__index");
+    }
+
+    static lua_Integer optfield(lua_State* L, int idx, const char* name, lua_Integer def) {
+        if (LUA_TNIL == lua_getfield(L, idx, name)) {
+            lua_pop(L, 1);
+            return def;
+        }
+        auto v = lua::checkinteger<lua_Integer>(L, -1);
+        lua_pop(L, 1);
+        if (v < 0) {
+            luaL_error(L, "`%s` must not be negative", name);
+        }
+        return v;
+    }
+
+    static void pushsink(lua_State* L, log::sink* sink) {
+        lua::newudata<logger>(L, metatable).sink = sink;
+    }
+
+    static int open(lua_State* L) {
+        auto name = lua::checkstrview(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        auto rotate_bytes    = optfield(L, 2, "rotate_bytes", 0);
+        auto rotate_interval = optfield(L, 2, "rotate_interval", 0);
+        auto rotate_files    = optfield(L, 2, "rotate_files", 1);
+        auto buffer_size     = optfield(L, 2, "buffer_size", 1 << 20);
+        auto flush_interval  = optfield(L, 2, "flush_interval", 100);
+        bool timestamp       = true;
+        if (LUA_TNIL != lua_getfield(L, 2, "timestamp")) {
+            timestamp = lua_toboolean(L, -1);
+        }
+        lua_pop(L, 1);
+        auto fsync           = log::fsync_mode::none;
+        lua_Integer fsync_ms = 0;
+        switch (lua_getfield(L, 2, "fsync")) {
+        case LUA_TNIL:
+            break;
+        case LUA_TSTRING: {
+            auto mode = lua::checkstrview(L, -1);
+            if (mode == "batch") {
+                fsync = log::fsync_mode::batch;
+            }
+            else if (!(mode == "none")) {
+                return luaL_error(L, "invalid fsync mode `%s`", mode.data());
+            }
+            break;
+        }
+        case LUA_TNUMBER:
+            fsync    = log::fsync_mode::interval;
+            fsync_ms = (lua_Integer)(lua_tonumber(L, -1) * 1000);
+            if (fsync_ms < 0) {
+                return luaL_error(L, "`fsync` must not be negative");
+            }
+            break;
+        default:
+            return luaL_error(L, "`fsync` must be a string or number");
+        }
+        lua_pop(L, 1);
+        switch (lua_getfield(L, 2, "path")) {
+        case LUA_TSTRING:
+            break;
+        case LUA_TUSERDATA:
+            lua::checkudata<fs::path>(L, -1);
+            break;
+        default:
+            return luaL_error(L, "`path` must be a string or path");
+        }
+        log::sink* sink;
+        std::error_code ec;
+        {
+            log::options opts;
+            if (lua_type(L, -1) == LUA_TSTRING) {
+                opts.path = lua::checkstring(L, -1);
+            }
+            else {
+                opts.path = lua::checkudata<fs::path>(L, -1);
+            }
+            opts.rotate_bytes    = (uint64_t)rotate_bytes;
+            opts.rotate_interval = (int)rotate_interval;
+            opts.rotate_files    = (int)rotate_files;
+            opts.buffer_size     = (size_t)buffer_size;
+            opts.flush_interval  = (int)flush_interval;
+            opts.fsync           = fsync;
+            opts.fsync_interval  = (int)fsync_ms;
+            opts.timestamp       = timestamp;
+            sink                 = log::sink::open({ name.data(), name.size() }, std::move(opts), ec);
+        }
+        if (!sink) {
+            lua_pushnil(L);
+            lua_pushstring(L, make_error(ec, "log::open").c_str());
+            return 2;
+        }
+        pushsink(L, sink);
+        return 1;
+    }
+
+    static int get(lua_State* L) {
+        auto name  = lua::checkstrview(L, 1);
+        auto* sink = log::sink::find({ name.data(), name.size() });
+        if (!sink) {
+            return 0;
+        }
+        pushsink(L, sink);
+        return 1;
+    }
+
+    static int luaopen(lua_State* L) {
+        luaL_Reg lib[] = {
+            { "open", open },
+            { "get", get },
+            { NULL, NULL }
+        };
+        luaL_newlibtable(L, lib);
+        luaL_setfuncs(L, lib, 0);
+        return 1;
+    }
+}
+
+DEFINE_LUAOPEN(log)
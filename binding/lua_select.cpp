@@ -6,9 +6,18 @@
 #endif
 #include <bee/error.h>
 #include <bee/net/socket.h>
+#include <bee/nonstd/unreachable.h>
 #include <bee/thread/simplethread.h>
+#include <bee/thread/spinlock.h>
 
+#include <chrono>
 #include <set>
+#if defined(__linux__)
+#    include <bee/net/poller.h>
+
+#    include <memory>
+#    include <vector>
+#endif
 
 namespace bee::lua_select {
     static void push_neterror(lua_State* L, std::string_view msg) {
@@ -66,10 +75,18 @@ namespace bee::lua_select {
         fd_set writefds;
         int maxfd;
         int i;
+#endif
+        int busy_poll = 0; // microseconds
+#if defined(__linux__)
+        std::unique_ptr<net::poller> poller;
+        std::vector<net::poller_event> events;
 #endif
     };
     constexpr lua_Integer SELECT_READ  = 1;
     constexpr lua_Integer SELECT_WRITE = 2;
+#if defined(__linux__)
+    static_assert(SELECT_READ == net::poller::read && SELECT_WRITE == net::poller::write);
+#endif
     static void storeref(lua_State* L, net::fd_t k) {
         if (lua_isnoneornil(L, 4)) {
             lua_getiuservalue(L, 1, 1);
@@ -108,27 +125,35 @@ namespace bee::lua_select {
         lua_rawget(L, -2);
         lua_remove(L, -2);
     }
-    static int pairs_events(lua_State* L) {
-        auto& ctx = *(select_ctx*)lua_touserdata(L, lua_upvalueindex(1));
+    static bool next_event(select_ctx& ctx, net::fd_t& fd, lua_Integer& events) {
 #if defined(_WIN32)
         auto rset = ctx.readfds.ptr();
         auto wset = ctx.writefds.ptr();
         auto rlen = rset->fd_count;
         if (ctx.i < rset->fd_count) {
-            auto fd = rset->fd_array[ctx.i];
-            findref(L, lua_upvalueindex(1), (net::fd_t)fd);
-            lua_pushinteger(L, SELECT_READ);
+            fd     = (net::fd_t)rset->fd_array[ctx.i];
+            events = SELECT_READ;
             ++ctx.i;
-            return 2;
+            return true;
         }
         if (ctx.i < rlen + wset->fd_count) {
-            auto fd = wset->fd_array[ctx.i - rlen];
-            findref(L, lua_upvalueindex(1), (net::fd_t)fd);
-            lua_pushinteger(L, SELECT_WRITE);
+            fd     = (net::fd_t)wset->fd_array[ctx.i - rlen];
+            events = SELECT_WRITE;
             ++ctx.i;
-            return 2;
+            return true;
         }
 #else
+#    if defined(__linux__)
+        if (ctx.poller) {
+            if (ctx.i < (int)ctx.events.size()) {
+                auto& ev = ctx.events[ctx.i++];
+                fd       = ev.fd;
+                events   = ev.events;
+                return true;
+            }
+            return false;
+        }
+#    endif
         for (; ctx.i <= ctx.maxfd; ++ctx.i) {
             lua_Integer event = 0;
             if (FD_ISSET(ctx.i, &ctx.readfds)) {
@@ -138,31 +163,41 @@ namespace bee::lua_select {
                 event |= SELECT_WRITE;
             }
             if (event) {
-                findref(L, lua_upvalueindex(1), (net::fd_t)ctx.i);
-                lua_pushinteger(L, event);
+                fd     = (net::fd_t)ctx.i;
+                events = event;
                 ++ctx.i;
-                return 2;
+                return true;
             }
         }
 #endif
-        return 0;
+        return false;
+    }
+    static int pairs_events(lua_State* L) {
+        auto& ctx = *(select_ctx*)lua_touserdata(L, lua_upvalueindex(1));
+        net::fd_t fd;
+        lua_Integer events;
+        if (!next_event(ctx, fd, events)) {
+            return 0;
+        }
+        findref(L, lua_upvalueindex(1), fd);
+        lua_pushinteger(L, events);
+        return 2;
     }
     static int empty_events(lua_State* L) {
         return 0;
     }
-    static int wait(lua_State* L) {
-        auto& ctx         = lua::checkudata<select_ctx>(L, 1);
-        lua_Number timeo  = luaL_optnumber(L, 2, -1);
-        if (ctx.readset.empty() && ctx.writeset.empty()) {
-            if (timeo < 0) {
-                return luaL_error(L, "no open sockets to check and no timeout set");
-            }
-            else {
-                thread_sleep(static_cast<int>(timeo * 1000));
-                lua_getiuservalue(L, 1, 4);
-                return 1;
+    static int poll_once(lua_State* L, select_ctx& ctx, lua_Number timeo) {
+#if defined(__linux__)
+        if (ctx.poller) {
+            ctx.i  = 0;
+            int ok = ctx.poller->wait(ctx.events, timeo < 0 ? -1 : static_cast<int>(timeo * 1000));
+            if (ok < 0) {
+                push_neterror(L, "select");
+                lua_error(L);
             }
+            return ok;
         }
+#endif
         struct timeval timeout, *timeop = &timeout;
         if (timeo < 0) {
             timeop = NULL;
@@ -210,22 +245,156 @@ namespace bee::lua_select {
 #endif
         if (ok < 0) {
             push_neterror(L, "select");
-            return lua_error(L);
+            lua_error(L);
+        }
+        return ok;
+    }
+    // Returns false when there is nothing to wait for; the timeout has then
+    // already been slept through. With a busy poll budget, readiness is
+    // polled without blocking until the budget or the timeout runs out, and
+    // only then does the thread go to sleep in the kernel.
+    static bool poll(lua_State* L, select_ctx& ctx, lua_Number timeo) {
+        if (ctx.readset.empty() && ctx.writeset.empty()) {
+            if (timeo < 0) {
+                luaL_error(L, "no open sockets to check and no timeout set");
+            }
+            thread_sleep(static_cast<int>(timeo * 1000));
+            return false;
+        }
+        if (ctx.busy_poll > 0 && timeo != 0) {
+            using clock = std::chrono::steady_clock;
+            auto start  = clock::now();
+            auto budget = std::chrono::microseconds(ctx.busy_poll);
+            if (timeo > 0 && timeo * 1000000 < ctx.busy_poll) {
+                budget = std::chrono::microseconds(static_cast<int64_t>(timeo * 1000000));
+            }
+            for (;;) {
+                if (poll_once(L, ctx, 0) > 0) {
+                    return true;
+                }
+                for (int i = 0; i < 32; ++i) {
+                    cpu_relax();
+                }
+                if (clock::now() - start >= budget) {
+                    break;
+                }
+            }
+            if (timeo > 0) {
+                timeo -= std::chrono::duration<lua_Number>(clock::now() - start).count();
+                if (timeo < 0) {
+                    timeo = 0;
+                }
+            }
+        }
+        poll_once(L, ctx, timeo);
+        return true;
+    }
+    static int wait(lua_State* L) {
+        auto& ctx        = lua::checkudata<select_ctx>(L, 1);
+        lua_Number timeo = luaL_optnumber(L, 2, -1);
+        if (!poll(L, ctx, timeo)) {
+            lua_getiuservalue(L, 1, 4);
+            return 1;
         }
         lua_getiuservalue(L, 1, 3);
         return 1;
     }
+    // Fills results with object, events pairs from index 1 and returns the
+    // number of pairs. The entry after the last pair is set to nil, older
+    // entries beyond it are left alone so the table can be reused.
+    static int wait_into(lua_State* L) {
+        auto& ctx = lua::checkudata<select_ctx>(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_Number timeo = luaL_optnumber(L, 3, -1);
+        lua_Integer n    = 0;
+        if (poll(L, ctx, timeo)) {
+            lua_getiuservalue(L, 1, 1);
+            net::fd_t fd;
+            lua_Integer events;
+            while (next_event(ctx, fd, events)) {
+                lua_rawgeti(L, -1, (lua_Integer)fd);
+                lua_rawseti(L, 2, 2 * n + 1);
+                lua_pushinteger(L, events);
+                lua_rawseti(L, 2, 2 * n + 2);
+                n++;
+            }
+            lua_pop(L, 1);
+        }
+        lua_pushnil(L);
+        lua_rawseti(L, 2, 2 * n + 1);
+        lua_pushinteger(L, n);
+        return 1;
+    }
     static int close(lua_State* L) {
         auto& ctx = lua::checkudata<select_ctx>(L, 1);
         ctx.readset.clear();
         ctx.writeset.clear();
+#if defined(__linux__)
+        ctx.poller.reset();
+        ctx.events.clear();
+#endif
+        return 0;
+    }
+    static bool poller_add(select_ctx& ctx, net::fd_t fd, lua_Integer events) {
+#if defined(__linux__)
+        if (ctx.poller) {
+            return ctx.poller->add(fd, (int)(events & (SELECT_READ | SELECT_WRITE)));
+        }
+#endif
+        return true;
+    }
+    static int backend(lua_State* L) {
+        auto& ctx = lua::checkudata<select_ctx>(L, 1);
+#if defined(__linux__)
+        if (ctx.poller) {
+            switch (ctx.poller->type()) {
+            case net::poller::backend::epoll:
+                lua_pushstring(L, "epoll");
+                return 1;
+            case net::poller::backend::io_uring:
+                lua_pushstring(L, "io_uring");
+                return 1;
+            default:
+                std::unreachable();
+            }
+        }
+#else
+        (void)ctx;
+#endif
+        lua_pushstring(L, "select");
+        return 1;
+    }
+    // Sets the busy poll budget in microseconds; 0 turns it off. Registered
+    // sockets also get SO_BUSY_POLL where the platform has it, which lets
+    // the kernel poll the device queue instead of waiting for an interrupt.
+    // That is best effort: it needs CAP_NET_ADMIN beyond net.core.busy_read.
+    static int busy_poll(lua_State* L) {
+        auto& ctx     = lua::checkudata<select_ctx>(L, 1);
+        auto us       = lua::checkinteger<int>(L, 2);
+        ctx.busy_poll = us > 0 ? us : 0;
+        for (auto fd : ctx.readset) {
+            net::socket::setoption(fd, net::socket::option::busy_poll, ctx.busy_poll);
+        }
+        for (auto fd : ctx.writeset) {
+            if (ctx.readset.find(fd) == ctx.readset.end()) {
+                net::socket::setoption(fd, net::socket::option::busy_poll, ctx.busy_poll);
+            }
+        }
         return 0;
     }
     static int event_add(lua_State* L) {
         auto& ctx = lua::checkudata<select_ctx>(L, 1);
         auto fd     = lua::checkudata<net::fd_t>(L, 2);
         auto events = luaL_checkinteger(L, 3);
+        if (!poller_add(ctx, fd, events)) {
+            lua_pushnil(L);
+            push_neterror(L, "event_add");
+            return 2;
+        }
         storeref(L, fd);
+        if (ctx.busy_poll > 0) {
+            net::socket::setoption(fd, net::socket::option::busy_poll, ctx.busy_poll);
+        }
         if (events & SELECT_READ) {
             ctx.readset.insert(fd);
         }
@@ -245,6 +414,11 @@ namespace bee::lua_select {
         auto& ctx   = lua::checkudata<select_ctx>(L, 1);
         auto fd     = lua::checkudata<net::fd_t>(L, 2);
         auto events = luaL_checkinteger(L, 3);
+        if (!poller_add(ctx, fd, events)) {
+            lua_pushnil(L);
+            push_neterror(L, "event_mod");
+            return 2;
+        }
         if (events & SELECT_READ) {
             ctx.readset.insert(fd);
         }
@@ -264,18 +438,149 @@ namespace bee::lua_select {
         auto& ctx = lua::checkudata<select_ctx>(L, 1);
         auto fd   = lua::checkudata<net::fd_t>(L, 2);
         cleanref(L, fd);
+#if defined(__linux__)
+        if (ctx.poller) {
+            ctx.poller->del(fd);
+        }
+#endif
+        // the socket outlives the select context, don't leave it spinning
+        if (ctx.busy_poll > 0) {
+            net::socket::setoption(fd, net::socket::option::busy_poll, 0);
+        }
         ctx.readset.erase(fd);
         ctx.writeset.erase(fd);
         lua_pushboolean(L, 1);
         return 1;
     }
+    static net::fd_t checkfd(lua_State* L, int idx) {
+        net::fd_t fd = lua::checkudata<net::fd_t>(L, idx);
+        if (fd == net::retired_fd) {
+            luaL_error(L, "socket is already closed.");
+        }
+        return fd;
+    }
+    static int push_socketerror(lua_State* L, std::string_view msg) {
+        lua_pushnil(L);
+        push_neterror(L, msg);
+        return 2;
+    }
+#if defined(__linux__)
+    static net::poller* data_poller(select_ctx& ctx, net::fd_t fd) {
+        if (ctx.poller && ctx.poller->serves(fd)) {
+            return ctx.poller.get();
+        }
+        return nullptr;
+    }
+#endif
+    // s:recv, s:send and s:accept work like the socket methods. On io_uring
+    // they run as multishot recv/accept and batched sends for sockets added
+    // to this select (see net::poller), which must then be removed with
+    // event_del before they are closed. Elsewhere they are plain syscalls.
+    static int recv(lua_State* L) {
+        auto& ctx = lua::checkudata<select_ctx>(L, 1);
+        auto fd   = checkfd(L, 2);
+        auto len  = lua::optinteger<int, LUAL_BUFFERSIZE>(L, 3);
+        luaL_Buffer b;
+        luaL_buffinit(L, &b);
+        char* buf = luaL_prepbuffsize(&b, (size_t)len);
+        int rc;
+        net::socket::status status;
+#if defined(__linux__)
+        if (auto poller = data_poller(ctx, fd)) {
+            status = poller->recv(fd, rc, buf, len);
+        }
+        else
+#endif
+        {
+            (void)ctx;
+            status = net::socket::recv(fd, rc, buf, len);
+        }
+        switch (status) {
+        case net::socket::status::close:
+            lua_pushnil(L);
+            return 1;
+        case net::socket::status::wait:
+            lua_pushboolean(L, 0);
+            return 1;
+        case net::socket::status::success:
+            luaL_pushresultsize(&b, rc);
+            return 1;
+        case net::socket::status::failed:
+            return push_socketerror(L, "recv");
+        default:
+            std::unreachable();
+        }
+    }
+    static int send(lua_State* L) {
+        auto& ctx = lua::checkudata<select_ctx>(L, 1);
+        auto fd   = checkfd(L, 2);
+        auto buf  = lua::checkstrview(L, 3);
+        int rc;
+        net::socket::status status;
+#if defined(__linux__)
+        if (auto poller = data_poller(ctx, fd)) {
+            status = poller->send(fd, rc, buf.data(), (int)buf.size());
+        }
+        else
+#endif
+        {
+            (void)ctx;
+            status = net::socket::send(fd, rc, buf.data(), (int)buf.size());
+        }
+        switch (status) {
+        case net::socket::status::wait:
+            lua_pushboolean(L, 0);
+            return 1;
+        case net::socket::status::success:
+            lua_pushinteger(L, rc);
+            return 1;
+        case net::socket::status::failed:
+            return push_socketerror(L, "send");
+        default:
+            std::unreachable();
+        }
+    }
+    static int accept(lua_State* L) {
+        auto& ctx = lua::checkudata<select_ctx>(L, 1);
+        auto fd   = checkfd(L, 2);
+        net::fd_t newfd;
+        net::socket::fdstat status;
+#if defined(__linux__)
+        if (auto poller = data_poller(ctx, fd)) {
+            status = poller->accept(fd, newfd);
+        }
+        else
+#endif
+        {
+            (void)ctx;
+            status = net::socket::accept(fd, newfd);
+        }
+        if (status != net::socket::fdstat::success) {
+            return push_socketerror(L, "accept");
+        }
+        // same type as the listening socket, whose metatable is registered
+        auto& o = *static_cast<net::fd_t*>(lua_newuserdatauv(L, sizeof(net::fd_t), 0));
+        o       = newfd;
+        if (luaL_getmetatable(L, "bee::net::fd") == LUA_TNIL) {
+            lua_pop(L, 1);
+            lua_getmetatable(L, 2);
+        }
+        lua_setmetatable(L, -2);
+        return 1;
+    }
     static void metatable(lua_State* L) {
         luaL_Reg lib[] = {
             { "wait", wait },
+            { "wait_into", wait_into },
             { "close", close },
             { "event_add", event_add },
             { "event_mod", event_mod },
             { "event_del", event_del },
+            { "backend", backend },
+            { "busy_poll", busy_poll },
+            { "recv", recv },
+            { "send", send },
+            { "accept", accept },
             { NULL, NULL },
         };
         luaL_newlibtable(L, lib);
@@ -288,7 +593,21 @@ namespace bee::lua_select {
         luaL_setfuncs(L, mt, 0);
     }
     static int create(lua_State* L) {
-        lua::newudata<select_ctx>(L, metatable);
+        static const char* const opts[] = { "select", "epoll", "io_uring", NULL };
+        int backend = luaL_checkoption(L, 1, "select", opts);
+        auto& ctx   = lua::newudata<select_ctx>(L, metatable);
+#if defined(__linux__)
+        if (backend != 0) {
+            ctx.poller = net::poller::create(backend == 2 ? net::poller::backend::io_uring : net::poller::backend::epoll);
+            if (!ctx.poller) {
+                push_neterror(L, "select.create");
+                return lua_error(L);
+            }
+        }
+#else
+        (void)ctx;
+        (void)backend;
+#endif
         lua_newtable(L);
         lua_setiuservalue(L, -2, 1);
         lua_newtable(L);
@@ -1,9 +1,21 @@
 ﻿#include <bee/error.h>
 #include <bee/net/endpoint.h>
+#include <bee/net/relay.h>
 #include <bee/net/socket.h>
 #include <bee/nonstd/unreachable.h>
 #include <binding/binding.h>
 
+#include <string>
+#include <vector>
+
+namespace bee::lua {
+    template <>
+    struct udata<std::shared_ptr<net::relay>> {
+        static inline int nupvalue = 2;
+        static inline auto name    = "bee::net::relay";
+    };
+}
+
 namespace bee::lua_socket {
     static int push_neterror(lua_State* L, std::string_view msg) {
         auto error = make_neterror(msg);
@@ -46,6 +58,97 @@ namespace bee::lua_socket {
         pushfd(L, newfd);
         return 1;
     }
+    struct admission {
+        std::vector<std::string> allow;
+        int nodelay = -1;
+        int sndbuf  = -1;
+        int rcvbuf  = -1;
+    };
+    static admission check_admission(lua_State* L, int idx) {
+        admission a;
+        if (lua_isnoneornil(L, idx)) {
+            return a;
+        }
+        luaL_checktype(L, idx, LUA_TTABLE);
+        if (LUA_TNIL != lua_getfield(L, idx, "nodelay")) {
+            a.nodelay = lua_toboolean(L, -1) ? 1 : 0;
+        }
+        lua_pop(L, 1);
+        if (LUA_TNIL != lua_getfield(L, idx, "sndbuf")) {
+            a.sndbuf = lua::checkinteger<int>(L, -1);
+        }
+        lua_pop(L, 1);
+        if (LUA_TNIL != lua_getfield(L, idx, "rcvbuf")) {
+            a.rcvbuf = lua::checkinteger<int>(L, -1);
+        }
+        lua_pop(L, 1);
+        if (LUA_TNIL != lua_getfield(L, idx, "allow")) {
+            luaL_checktype(L, -1, LUA_TTABLE);
+            lua_Integer n = luaL_len(L, -1);
+            for (lua_Integer i = 1; i <= n; ++i) {
+                lua_geti(L, -1, i);
+                auto ip = lua::checkstrview(L, -1);
+                a.allow.emplace_back(ip.data(), ip.size());
+                lua_pop(L, 1);
+            }
+        }
+        lua_pop(L, 1);
+        return a;
+    }
+    static bool admit(const admission& a, net::fd_t fd, const net::endpoint& ep) {
+        if (!a.allow.empty() && !ep.is_unix()) {
+            auto [ip, port] = ep.info();
+            bool found      = false;
+            for (auto& allow : a.allow) {
+                if (allow == ip) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        if (a.nodelay >= 0) {
+            net::socket::setoption(fd, net::socket::option::nodelay, a.nodelay);
+        }
+        if (a.sndbuf >= 0) {
+            net::socket::setoption(fd, net::socket::option::sndbuf, a.sndbuf);
+        }
+        if (a.rcvbuf >= 0) {
+            net::socket::setoption(fd, net::socket::option::rcvbuf, a.rcvbuf);
+        }
+        return true;
+    }
+    static int accept_many(lua_State* L) {
+        auto fd  = checkfd(L, 1);
+        auto max = lua::optinteger<int, 128>(L, 2);
+        luaL_argcheck(L, max > 0, 2, "must be greater than zero");
+        auto a = check_admission(L, 3);
+        lua_createtable(L, max < 16 ? max : 16, 0);
+        lua_Integer n = 0;
+        for (int i = 0; i < max; ++i) {
+            net::fd_t newfd;
+            net::endpoint ep;
+            auto r = net::socket::accept(fd, newfd, ep);
+            if (r == net::socket::fdstat::wait) {
+                break;
+            }
+            if (r == net::socket::fdstat::failed) {
+                if (i == 0) {
+                    return push_neterror(L, "accept");
+                }
+                break;
+            }
+            if (!admit(a, newfd, ep)) {
+                net::socket::close(newfd);
+                continue;
+            }
+            pushfd(L, newfd);
+            lua_rawseti(L, -2, ++n);
+        }
+        return 1;
+    }
     static int recv(lua_State* L) {
         auto fd  = checkfd(L, 1);
         auto len = lua::optinteger<int, LUAL_BUFFERSIZE>(L, 2);
@@ -233,6 +336,44 @@ namespace bee::lua_socket {
         }
         return 0;
     }
+    static int stats(lua_State* L) {
+        auto fd      = checkfd(L, 1);
+        lua_createtable(L, 0, 11);
+        net::socket::traffic traffic;
+        if (net::socket::gettraffic(fd, traffic)) {
+            lua_pushinteger(L, (lua_Integer)traffic.bytes_sent);
+            lua_setfield(L, -2, "bytes_sent");
+            lua_pushinteger(L, (lua_Integer)traffic.bytes_recv);
+            lua_setfield(L, -2, "bytes_recv");
+            lua_pushinteger(L, (lua_Integer)traffic.send_calls);
+            lua_setfield(L, -2, "send_calls");
+            lua_pushinteger(L, (lua_Integer)traffic.recv_calls);
+            lua_setfield(L, -2, "recv_calls");
+        }
+        int inq, outq;
+        if (net::socket::getqueue(fd, inq, outq)) {
+            lua_pushinteger(L, inq);
+            lua_setfield(L, -2, "inq");
+            if (outq >= 0) {
+                lua_pushinteger(L, outq);
+                lua_setfield(L, -2, "outq");
+            }
+        }
+        net::socket::tcpinfo ti;
+        if (net::socket::gettcpinfo(fd, ti)) {
+            lua_pushinteger(L, ti.rtt);
+            lua_setfield(L, -2, "rtt");
+            lua_pushinteger(L, ti.rttvar);
+            lua_setfield(L, -2, "rttvar");
+            lua_pushinteger(L, ti.cwnd);
+            lua_setfield(L, -2, "cwnd");
+            lua_pushinteger(L, ti.retrans);
+            lua_setfield(L, -2, "retrans");
+            lua_pushinteger(L, ti.unacked);
+            lua_setfield(L, -2, "unacked");
+        }
+        return 1;
+    }
     static int handle(lua_State* L) {
         auto fd = checkfd(L, 1);
         lua_pushlightuserdata(L, (void*)(intptr_t)fd);
@@ -250,7 +391,7 @@ namespace bee::lua_socket {
     }
     static int option(lua_State* L) {
         auto fd                         = checkfd(L, 1);
-        static const char* const opts[] = { "reuseaddr", "sndbuf", "rcvbuf", NULL };
+        static const char* const opts[] = { "reuseaddr", "sndbuf", "rcvbuf", "nodelay", "busy_poll", NULL };
         auto opt                        = (net::socket::option)luaL_checkoption(L, 2, NULL, opts);
         auto value                      = lua::checkinteger<int>(L, 3);
         bool ok                         = net::socket::setoption(fd, opt, value);
@@ -302,6 +443,7 @@ namespace bee::lua_socket {
             { "bind", bind },
             { "listen", listen },
             { "accept", accept },
+            { "accept_many", accept_many },
             { "recv", recv },
             { "send", send },
             { "recvfrom", recvfrom },
@@ -310,6 +452,7 @@ namespace bee::lua_socket {
             { "shutdown", shutdown },
             { "status", status },
             { "info", info },
+            { "stats", stats },
             { "handle", handle },
             { "detach", detach },
             { "option", option },
@@ -332,6 +475,7 @@ namespace bee::lua_socket {
             { "bind", bind },
             { "listen", listen },
             { "accept", accept },
+            { "accept_many", accept_many },
             { "recv", recv },
             { "send", send },
             { "recvfrom", recvfrom },
@@ -339,6 +483,7 @@ namespace bee::lua_socket {
             { "shutdown", shutdown },
             { "status", status },
             { "info", info },
+            { "stats", stats },
             { "handle", handle },
             { "detach", detach },
             { "option", option },
@@ -379,6 +524,116 @@ namespace bee::lua_socket {
         }
         return 1;
     }
+    namespace relay {
+        static net::relay& to(lua_State* L, int idx) {
+            return *lua::checkudata<std::shared_ptr<net::relay>>(L, idx);
+        }
+        static int update(lua_State* L) {
+            auto& self = to(L, 1);
+            self.clear_event();
+            auto chunks = self.drain_tap();
+            if (!chunks.empty() && LUA_TFUNCTION == lua_getiuservalue(L, 1, 1)) {
+                for (auto& c : chunks) {
+                    lua_pushvalue(L, -1);
+                    lua_pushstring(L, c.dir == net::relay::direction::a2b ? "a2b" : "b2a");
+                    lua_pushlstring(L, c.data.data(), c.data.size());
+                    lua_call(L, 2, 0);
+                }
+            }
+            if (!self.done()) {
+                lua_pushboolean(L, 0);
+                return 1;
+            }
+            if (int err = self.error()) {
+                auto error = make_error(std::error_code(err, get_error_category()), "relay");
+                lua_pushnil(L);
+                lua_pushstring(L, error.c_str());
+                return 2;
+            }
+            lua_pushboolean(L, 1);
+            return 1;
+        }
+        static int status(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushboolean(L, self.done());
+            lua_pushinteger(L, (lua_Integer)self.bytes(net::relay::direction::a2b));
+            lua_pushinteger(L, (lua_Integer)self.bytes(net::relay::direction::b2a));
+            return 3;
+        }
+        static int event(lua_State* L) {
+            to(L, 1);
+            lua_getiuservalue(L, 1, 2);
+            return 1;
+        }
+        static int close(lua_State* L) {
+            auto& self = to(L, 1);
+            self.cancel();
+            return 0;
+        }
+        static void metatable(lua_State* L) {
+            luaL_Reg lib[] = {
+                { "update", update },
+                { "status", status },
+                { "event", event },
+                { "close", close },
+                { NULL, NULL },
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+            luaL_Reg mt[] = {
+                { "__close", close },
+                { NULL, NULL },
+            };
+            luaL_setfuncs(L, mt, 0);
+        }
+        static net::fd_t& checkowner(lua_State* L, int idx) {
+            auto& fd = lua::checkudata<net::fd_t>(L, idx);
+            if (fd == net::retired_fd) {
+                luaL_error(L, "socket is already closed.");
+            }
+            return fd;
+        }
+        static int create(lua_State* L) {
+            auto& a = checkowner(L, 1);
+            auto& b = checkowner(L, 2);
+            luaL_argcheck(L, a != b, 2, "cannot relay a socket to itself");
+            net::relay::options opts;
+            bool tap = false;
+            if (lua_istable(L, 3)) {
+                if (LUA_TBOOLEAN == lua_getfield(L, 3, "splice")) {
+                    opts.splice = lua_toboolean(L, -1);
+                }
+                lua_pop(L, 1);
+                if (LUA_TNUMBER == lua_getfield(L, 3, "bufsize")) {
+                    opts.bufsize = lua::checkinteger<size_t>(L, -1);
+                    luaL_argcheck(L, opts.bufsize > 0, 3, "invalid bufsize");
+                }
+                lua_pop(L, 1);
+                if (LUA_TFUNCTION == lua_getfield(L, 3, "tap")) {
+                    tap = true;
+                }
+                lua_pop(L, 1);
+            }
+            opts.tap = tap;
+            auto r   = net::relay::create(a, b, opts);
+            if (!r) {
+                return push_neterror(L, "relay");
+            }
+            a = net::retired_fd;
+            b = net::retired_fd;
+            net::fd_t event = r->event();
+            lua::newudata<std::shared_ptr<net::relay>>(L, metatable, std::move(r));
+            if (tap) {
+                lua_getfield(L, 3, "tap");
+                lua_setiuservalue(L, -2, 1);
+            }
+            pushfd_no_ownership(L, event);
+            lua_setiuservalue(L, -2, 2);
+            return 1;
+        }
+    }
+
     static int mt_call(lua_State* L) {
         static const char* const opts[] = {
             "tcp", "udp", "unix", "tcp6", "udp6",
@@ -401,6 +656,7 @@ namespace bee::lua_socket {
         luaL_Reg lib[] = {
             { "pair", pair },
             { "fd", fd },
+            { "relay", relay::create },
             { NULL, NULL }
         };
         luaL_newlibtable(L, lib);
@@ -0,0 +1,290 @@
+#include <binding/binding.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bee::lua_stats {
+    // Bucket i counts calls that finished in less than 2^i microseconds; the last bucket takes the rest.
+    static constexpr int kBuckets = 24;
+
+    struct callstat {
+        std::atomic<uint64_t> calls    = 0;
+        std::atomic<uint64_t> returns  = 0;
+        std::atomic<uint64_t> raised   = 0;
+        std::atomic<uint64_t> failed   = 0;
+        std::atomic<uint64_t> total_ns = 0;
+        std::atomic<uint64_t> max_ns   = 0;
+        std::atomic<uint64_t> histogram[kBuckets] = {};
+
+        void record(uint64_t ns) noexcept {
+            returns.fetch_add(1, std::memory_order_relaxed);
+            total_ns.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t max = max_ns.load(std::memory_order_relaxed);
+            while (ns > max && !max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+            }
+            int bucket = 0;
+            for (uint64_t us = ns / 1000; us > 0 && bucket < kBuckets - 1; us >>= 1) {
+                bucket++;
+            }
+            histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+        void reset() noexcept {
+            calls.store(0, std::memory_order_relaxed);
+            returns.store(0, std::memory_order_relaxed);
+            raised.store(0, std::memory_order_relaxed);
+            failed.store(0, std::memory_order_relaxed);
+            total_ns.store(0, std::memory_order_relaxed);
+            max_ns.store(0, std::memory_order_relaxed);
+            for (auto& h : histogram) {
+                h.store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    static bool env_enabled() noexcept {
+        const char* env = getenv("BEE_STATS");
+        return env && env[0] && strcmp(env, "0") != 0;
+    }
+
+    static std::atomic<bool> g_enabled = env_enabled();
+    static std::mutex g_mutex;
+    static std::map<std::string, std::unique_ptr<callstat>> g_stats;
+
+    static callstat* find(std::string name) {
+        std::unique_lock<std::mutex> lk(g_mutex);
+        auto& s = g_stats[std::move(name)];
+        if (!s) {
+            s.reset(new callstat);
+        }
+        return s.get();
+    }
+
+    static uint64_t now() noexcept {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Wrapped calls running on this thread, innermost last, with the C
+    // stack address of their wrapper. A binding that raises longjmps past
+    // its wrapper, so a frame at or below the stack position of a later
+    // wrapper was unwound. It is counted as raised then, or at thread exit.
+    struct framestack {
+        struct frame {
+            callstat* s;
+            uintptr_t sp;
+        };
+        std::vector<frame> frames;
+
+        void unwind(uintptr_t sp) noexcept {
+            while (!frames.empty() && frames.back().sp <= sp) {
+                frames.back().s->raised.fetch_add(1, std::memory_order_relaxed);
+                frames.pop_back();
+            }
+        }
+        ~framestack() {
+            unwind(UINTPTR_MAX);
+        }
+    };
+    static thread_local framestack t_frames;
+
+    // The wrapper replaces the original C function in its own frame, so
+    // error positions, argument names and tracebacks stay as they were.
+    // It carries copies of the original's N upvalues followed by the
+    // callstat and the function pointer. Returning nil and an error
+    // message counts as failed.
+    template <int N>
+    static int instrumented(lua_State* L) {
+        auto s = lua::tolightud<callstat*>(L, lua_upvalueindex(N + 1));
+        auto f = reinterpret_cast<lua_CFunction>(lua_touserdata(L, lua_upvalueindex(N + 2)));
+        char here;
+        uintptr_t sp = reinterpret_cast<uintptr_t>(&here);
+        t_frames.unwind(sp);
+        t_frames.frames.push_back({ s, sp });
+        s->calls.fetch_add(1, std::memory_order_relaxed);
+        uint64_t start = now();
+        int r          = f(L);
+        s->record(now() - start);
+        t_frames.unwind(sp - 1);
+        if (!t_frames.frames.empty() && t_frames.frames.back().sp == sp) {
+            t_frames.frames.pop_back();
+        }
+        if (r >= 2 && lua_isnil(L, -r) && lua_type(L, -r + 1) == LUA_TSTRING) {
+            s->failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        return r;
+    }
+
+    template <int... N>
+    static constexpr auto make_wrappers(std::integer_sequence<int, N...>) {
+        return std::array<lua_CFunction, sizeof...(N)> { instrumented<N>... };
+    }
+    static constexpr auto kWrappers = make_wrappers(std::make_integer_sequence<int, 8> {});
+
+    static bool is_instrumented(lua_CFunction f) noexcept {
+        return std::find(kWrappers.begin(), kWrappers.end(), f) != kWrappers.end();
+    }
+
+    // Replaces the C function on top of the stack by its wrapper, or leaves
+    // it alone when it has more upvalues than any wrapper supports.
+    static void wrap(lua_State* L, callstat* s) {
+        lua_Debug ar;
+        lua_pushvalue(L, -1);
+        lua_getinfo(L, ">u", &ar);
+        if (ar.nups >= kWrappers.size()) {
+            return;
+        }
+        int f = lua_absindex(L, -1);
+        for (int i = 1; i <= ar.nups; ++i) {
+            lua_getupvalue(L, f, i);
+        }
+        lua_pushlightuserdata(L, s);
+        lua_pushlightuserdata(L, reinterpret_cast<void*>(lua_tocfunction(L, f)));
+        lua_pushcclosure(L, kWrappers[ar.nups], ar.nups + 2);
+        lua_replace(L, f);
+    }
+
+    static void instrument_table(lua_State* L, int idx, std::string_view prefix) {
+        idx = lua_absindex(L, idx);
+        lua_pushnil(L);
+        while (lua_next(L, idx)) {
+            if (lua_type(L, -2) == LUA_TSTRING && lua_iscfunction(L, -1) && !is_instrumented(lua_tocfunction(L, -1))) {
+                const char* key = lua_tostring(L, -2);
+                if (strcmp(key, "__gc") != 0) {
+                    std::string name { prefix };
+                    name += ".";
+                    name += key;
+                    wrap(L, find(std::move(name)));
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, idx);
+                    continue;
+                }
+            }
+            lua_pop(L, 1);
+        }
+    }
+
+    static void push_callstat(lua_State* L, const callstat& s) {
+        lua_createtable(L, 0, 6);
+        uint64_t calls   = s.calls.load(std::memory_order_relaxed);
+        uint64_t returns = s.returns.load(std::memory_order_relaxed);
+        uint64_t raised  = s.raised.load(std::memory_order_relaxed);
+        uint64_t failed  = s.failed.load(std::memory_order_relaxed);
+        lua_pushinteger(L, (lua_Integer)calls);
+        lua_setfield(L, -2, "calls");
+        lua_pushinteger(L, (lua_Integer)(raised + failed));
+        lua_setfield(L, -2, "errors");
+        // still running, or raised on a thread that has not called a
+        // wrapped binding since
+        lua_pushinteger(L, (lua_Integer)(calls > returns + raised ? calls - returns - raised : 0));
+        lua_setfield(L, -2, "active");
+        lua_pushinteger(L, (lua_Integer)s.total_ns.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "total_ns");
+        lua_pushinteger(L, (lua_Integer)s.max_ns.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "max_ns");
+        lua_createtable(L, kBuckets, 0);
+        for (int i = 0; i < kBuckets; ++i) {
+            lua_pushinteger(L, (lua_Integer)s.histogram[i].load(std::memory_order_relaxed));
+            lua_rawseti(L, -2, i + 1);
+        }
+        lua_setfield(L, -2, "histogram");
+    }
+
+    static int snapshot(lua_State* L) {
+        std::vector<std::pair<std::string, callstat*>> list;
+        {
+            std::unique_lock<std::mutex> lk(g_mutex);
+            for (auto& [name, s] : g_stats) {
+                if (s->calls.load(std::memory_order_relaxed) != 0) {
+                    list.emplace_back(name, s.get());
+                }
+            }
+        }
+        lua_createtable(L, 0, (int)list.size());
+        for (auto& [name, s] : list) {
+            push_callstat(L, *s);
+            lua_setfield(L, -2, name.c_str());
+        }
+        return 1;
+    }
+
+    static int mt_call(lua_State* L) {
+        lua_remove(L, 1);
+        return snapshot(L);
+    }
+
+    static int reset(lua_State* L) {
+        std::unique_lock<std::mutex> lk(g_mutex);
+        for (auto& [_, s] : g_stats) {
+            s->reset();
+        }
+        return 0;
+    }
+
+    static int enable(lua_State* L) {
+        luaL_checktype(L, 1, LUA_TBOOLEAN);
+        g_enabled.store(lua_toboolean(L, 1), std::memory_order_relaxed);
+        return 0;
+    }
+
+    static int enabled(lua_State* L) {
+        lua_pushboolean(L, g_enabled.load(std::memory_order_relaxed));
+        return 1;
+    }
+
+    static int luaopen(lua_State* L) {
+        luaL_Reg lib[] = {
+            { "snapshot", snapshot },
+            { "reset", reset },
+            { "enable", enable },
+            { "enabled", enabled },
+            { NULL, NULL },
+        };
+        luaL_newlibtable(L, lib);
+        luaL_setfuncs(L, lib, 0);
+        luaL_Reg mt[] = {
+            { "__call", mt_call },
+            { NULL, NULL },
+        };
+        luaL_newlibtable(L, mt);
+        luaL_setfuncs(L, mt, 0);
+        lua_setmetatable(L, -2);
+        return 1;
+    }
+}
+
+namespace bee::lua {
+    void instrument_module(lua_State* L, const char* name) {
+        if (!lua_stats::g_enabled.load(std::memory_order_relaxed) || strcmp(name, "stats") == 0 || !lua_istable(L, -1)) {
+            return;
+        }
+        lua_stats::instrument_table(L, -1, name);
+    }
+
+    void instrument_metatable(lua_State* L, const char* name) {
+        if (!lua_stats::g_enabled.load(std::memory_order_relaxed) || !lua_istable(L, -1)) {
+            return;
+        }
+        std::string_view prefix { name };
+        if (prefix.substr(0, 5) == "bee::") {
+            prefix.remove_prefix(5);
+        }
+        lua_stats::instrument_table(L, -1, prefix);
+        if (lua_getfield(L, -1, "__index") == LUA_TTABLE) {
+            lua_stats::instrument_table(L, -1, prefix);
+        }
+        lua_pop(L, 1);
+    }
+}
+
+DEFINE_LUAOPEN(stats)
@@ -0,0 +1,601 @@
+#include <binding/binding.h>
+
+#include <climits>
+#include <cstring>
+#include <vector>
+
+namespace bee::lua_struct {
+    // A format string in the syntax of string.pack, parsed once. Every field
+    // keeps its own byte order and alignment, so decoding is a walk over the
+    // fields with no format handling left.
+    enum class kind : uint8_t {
+        integer,
+        unsigned_integer,
+        float32,
+        float64,
+        number,
+        fixed_string,
+        length_string,
+        zero_string,
+        padding,
+        align_only,
+    };
+
+    struct field {
+        kind k;
+        bool little;
+        uint16_t align;
+        uint32_t size;
+    };
+
+    struct codec {
+        std::vector<field> fields;
+        int nvalues      = 0;
+        bool has_names   = false;
+        bool fixed_size  = true;
+        size_t pack_size = 0;
+    };
+}
+
+namespace bee::lua {
+    template <>
+    struct udata<lua_struct::codec> {
+        static inline int nupvalue = 1;
+        static inline auto name    = "bee::struct";
+    };
+}
+
+namespace bee::lua_struct {
+    union max_align {
+        lua_Number n;
+        double u;
+        void* s;
+        lua_Integer i;
+        long l;
+    };
+    constexpr int kMaxAlign   = alignof(max_align);
+    constexpr int kMaxIntSize = 16;
+    constexpr int kIntSize    = (int)sizeof(lua_Integer);
+
+    static bool native_little() noexcept {
+        const union {
+            int dummy;
+            char little;
+        } nativeendian = { 1 };
+        return nativeendian.little;
+    }
+
+    static bool isdigit(char c) noexcept {
+        return c >= '0' && c <= '9';
+    }
+
+    static int getnum(const char*& fmt, int def) noexcept {
+        if (!isdigit(*fmt)) {
+            return def;
+        }
+        int a = 0;
+        do {
+            a = a * 10 + (*(fmt++) - '0');
+        } while (isdigit(*fmt) && a <= ((int)0x7fffffff - 9) / 10);
+        return a;
+    }
+
+    static int getnumlimit(lua_State* L, const char*& fmt, int def) {
+        int sz = getnum(fmt, def);
+        if (sz > kMaxIntSize || sz <= 0) {
+            return luaL_error(L, "integral size (%d) out of limits [1,%d]", sz, kMaxIntSize);
+        }
+        return sz;
+    }
+
+    struct parse_state {
+        bool little;
+        int maxalign;
+    };
+
+    // Reads one option. Returns false for options that only change the state.
+    static bool getoption(lua_State* L, parse_state& h, const char*& fmt, field& f) {
+        const char opt = *(fmt++);
+        f.little       = h.little;
+        f.align        = 1;
+        switch (opt) {
+        case 'b':
+            f.k    = kind::integer;
+            f.size = sizeof(char);
+            break;
+        case 'B':
+            f.k    = kind::unsigned_integer;
+            f.size = sizeof(char);
+            break;
+        case 'h':
+            f.k    = kind::integer;
+            f.size = sizeof(short);
+            break;
+        case 'H':
+            f.k    = kind::unsigned_integer;
+            f.size = sizeof(short);
+            break;
+        case 'l':
+            f.k    = kind::integer;
+            f.size = sizeof(long);
+            break;
+        case 'L':
+            f.k    = kind::unsigned_integer;
+            f.size = sizeof(long);
+            break;
+        case 'j':
+            f.k    = kind::integer;
+            f.size = sizeof(lua_Integer);
+            break;
+        case 'J':
+            f.k    = kind::unsigned_integer;
+            f.size = sizeof(lua_Integer);
+            break;
+        case 'T':
+            f.k    = kind::unsigned_integer;
+            f.size = sizeof(size_t);
+            break;
+        case 'f':
+            f.k    = kind::float32;
+            f.size = sizeof(float);
+            break;
+        case 'd':
+            f.k    = kind::float64;
+            f.size = sizeof(double);
+            break;
+        case 'n':
+            f.k    = kind::number;
+            f.size = sizeof(lua_Number);
+            break;
+        case 'i':
+            f.k    = kind::integer;
+            f.size = getnumlimit(L, fmt, sizeof(int));
+            break;
+        case 'I':
+            f.k    = kind::unsigned_integer;
+            f.size = getnumlimit(L, fmt, sizeof(int));
+            break;
+        case 's':
+            f.k    = kind::length_string;
+            f.size = getnumlimit(L, fmt, sizeof(size_t));
+            break;
+        case 'c': {
+            int sz = getnum(fmt, -1);
+            if (sz == -1) {
+                luaL_error(L, "missing size for format option 'c'");
+            }
+            f.k    = kind::fixed_string;
+            f.size = (uint32_t)sz;
+            return true;
+        }
+        case 'z':
+            f.k    = kind::zero_string;
+            f.size = 0;
+            return true;
+        case 'x':
+            f.k    = kind::padding;
+            f.size = 1;
+            return true;
+        case 'X': {
+            field next {};
+            if (*fmt == '\0' || !getoption(L, h, fmt, next) || next.k == kind::fixed_string || next.size == 0) {
+                luaL_argerror(L, 1, "invalid next option for option 'X'");
+            }
+            f.k    = kind::align_only;
+            f.size = next.size;
+            break;
+        }
+        case ' ':
+            return false;
+        case '<':
+            h.little = true;
+            return false;
+        case '>':
+            h.little = false;
+            return false;
+        case '=':
+            h.little = native_little();
+            return false;
+        case '!':
+            h.maxalign = getnumlimit(L, fmt, kMaxAlign);
+            return false;
+        default:
+            luaL_error(L, "invalid format option '%c'", opt);
+            return false;
+        }
+        int align = (int)f.size;
+        if (align > 1 && h.maxalign > 1) {
+            if (align > h.maxalign) {
+                align = h.maxalign;
+            }
+            if ((align & (align - 1)) != 0) {
+                luaL_argerror(L, 1, "format asks for alignment not power of 2");
+            }
+            f.align = (uint16_t)align;
+        }
+        if (f.k == kind::align_only) {
+            f.size = 0;
+        }
+        return true;
+    }
+
+    static bool produces_value(kind k) noexcept {
+        return k != kind::padding && k != kind::align_only;
+    }
+
+    static size_t padding(size_t pos, uint16_t align) noexcept {
+        return (align - (pos & (align - 1))) & (align - 1);
+    }
+
+    template <typename S, typename U>
+    static lua_Integer loadint(const char* str, bool issigned) noexcept {
+        U v;
+        memcpy(&v, str, sizeof(U));
+        return issigned ? (lua_Integer)(S)v : (lua_Integer)v;
+    }
+
+    static lua_Integer unpackint(lua_State* L, const char* str, bool little, int size, bool issigned) {
+        if (little == native_little()) {
+            switch (size) {
+            case 2:
+                return loadint<int16_t, uint16_t>(str, issigned);
+            case 4:
+                return loadint<int32_t, uint32_t>(str, issigned);
+            case 8:
+                return loadint<int64_t, uint64_t>(str, issigned);
+            default:
+                break;
+            }
+        }
+        lua_Unsigned res = 0;
+        const int limit  = (size <= kIntSize) ? size : kIntSize;
+        for (int i = limit - 1; i >= 0; i--) {
+            res <<= CHAR_BIT;
+            res |= (lua_Unsigned)(unsigned char)str[little ? i : size - 1 - i];
+        }
+        if (size < kIntSize) {
+            if (issigned) {
+                lua_Unsigned mask = (lua_Unsigned)1 << (size * CHAR_BIT - 1);
+                res               = ((res ^ mask) - mask);
+            }
+        }
+        else if (size > kIntSize) {
+            const int mask = (!issigned || (lua_Integer)res >= 0) ? 0 : 0xff;
+            for (int i = limit; i < size; i++) {
+                if ((unsigned char)str[little ? i : size - 1 - i] != mask) {
+                    luaL_error(L, "%d-byte integer does not fit into Lua Integer", size);
+                }
+            }
+        }
+        return (lua_Integer)res;
+    }
+
+    template <typename T>
+    static T unpackfloat(const char* str, bool little) noexcept {
+        T v;
+        if (little == native_little()) {
+            memcpy(&v, str, sizeof(T));
+        }
+        else {
+            char buf[sizeof(T)];
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                buf[i] = str[sizeof(T) - 1 - i];
+            }
+            memcpy(&v, buf, sizeof(T));
+        }
+        return v;
+    }
+
+    static void packint(luaL_Buffer* b, lua_Unsigned n, bool little, int size, bool neg) {
+        char* buff = luaL_prepbuffsize(b, size);
+        for (int i = 0; i < size; i++) {
+            buff[little ? i : size - 1 - i] = (char)(i < kIntSize ? (n >> (i * CHAR_BIT)) & 0xff : (neg ? 0xff : 0));
+        }
+        luaL_addsize(b, size);
+    }
+
+    template <typename T>
+    static void packfloat(luaL_Buffer* b, T v, bool little) {
+        char* buff = luaL_prepbuffsize(b, sizeof(T));
+        if (little == native_little()) {
+            memcpy(buff, &v, sizeof(T));
+        }
+        else {
+            char tmp[sizeof(T)];
+            memcpy(tmp, &v, sizeof(T));
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                buff[i] = tmp[sizeof(T) - 1 - i];
+            }
+        }
+        luaL_addsize(b, sizeof(T));
+    }
+
+    static auto& to(lua_State* L, int idx) {
+        return lua::checkudata<codec>(L, idx);
+    }
+
+    // A buffer is a string, or a lightuserdata followed by its length. idx is
+    // moved past the buffer arguments.
+    static const char* checkbuffer(lua_State* L, int& idx, size_t& len) {
+        switch (lua_type(L, idx)) {
+        case LUA_TSTRING: {
+            const char* data = lua_tolstring(L, idx, &len);
+            idx += 1;
+            return data;
+        }
+        case LUA_TLIGHTUSERDATA: {
+            const char* data = lua::tolightud<const char*>(L, idx);
+            len              = lua::checkinteger<size_t>(L, idx + 1);
+            idx += 2;
+            return data;
+        }
+        default:
+            luaL_typeerror(L, idx, "string or lightuserdata");
+            return nullptr;
+        }
+    }
+
+    static size_t checkpos(lua_State* L, int idx, size_t len) {
+        lua_Integer pos = luaL_optinteger(L, idx, 1);
+        if (pos < 0) {
+            pos = (size_t)-pos > len ? 0 : (lua_Integer)len + pos + 1;
+        }
+        luaL_argcheck(L, pos >= 1 && (size_t)pos - 1 <= len, idx, "initial position out of string");
+        return (size_t)pos - 1;
+    }
+
+    // Pushes the value of every field, calling store after each one with its
+    // value index, and returns the position after the data.
+    template <typename Store>
+    static size_t decode_fields(lua_State* L, const codec& self, const char* data, size_t len, size_t pos, Store&& store) {
+        int n = 0;
+        for (auto const& f : self.fields) {
+            const size_t pad = f.align > 1 ? padding(pos, f.align) : 0;
+            if (pad > len - pos || f.size > len - pos - pad) {
+                luaL_argerror(L, 2, "data string too short");
+            }
+            pos += pad;
+            const char* p = data + pos;
+            switch (f.k) {
+            case kind::integer:
+            case kind::unsigned_integer:
+                lua_pushinteger(L, unpackint(L, p, f.little, (int)f.size, f.k == kind::integer));
+                break;
+            case kind::float32:
+                lua_pushnumber(L, (lua_Number)unpackfloat<float>(p, f.little));
+                break;
+            case kind::float64:
+                lua_pushnumber(L, (lua_Number)unpackfloat<double>(p, f.little));
+                break;
+            case kind::number:
+                lua_pushnumber(L, unpackfloat<lua_Number>(p, f.little));
+                break;
+            case kind::fixed_string:
+                lua_pushlstring(L, p, f.size);
+                break;
+            case kind::length_string: {
+                size_t sz = (size_t)unpackint(L, p, f.little, (int)f.size, false);
+                if (sz > len - pos - f.size) {
+                    luaL_argerror(L, 2, "data string too short");
+                }
+                lua_pushlstring(L, p + f.size, sz);
+                pos += sz;
+                break;
+            }
+            case kind::zero_string: {
+                const void* end = memchr(p, '\0', len - pos);
+                if (!end) {
+                    luaL_argerror(L, 2, "unfinished string for format 'z'");
+                }
+                size_t sz = (size_t)((const char*)end - p);
+                lua_pushlstring(L, p, sz);
+                pos += sz + 1;
+                break;
+            }
+            case kind::padding:
+            case kind::align_only:
+                pos += f.size;
+                continue;
+            }
+            pos += f.size;
+            store(++n);
+        }
+        return pos;
+    }
+
+    static int decode(lua_State* L) {
+        auto& self       = to(L, 1);
+        int idx          = 2;
+        size_t len       = 0;
+        const char* data = checkbuffer(L, idx, len);
+        size_t pos       = checkpos(L, idx, len);
+        luaL_checkstack(L, self.nvalues + 1, "too many results");
+        pos = decode_fields(L, self, data, len, pos, [](int) {});
+        lua_pushinteger(L, (lua_Integer)pos + 1);
+        return self.nvalues + 1;
+    }
+
+    static int decode_into(lua_State* L) {
+        auto& self = to(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        int idx          = 3;
+        size_t len       = 0;
+        const char* data = checkbuffer(L, idx, len);
+        size_t pos       = checkpos(L, idx, len);
+        lua_settop(L, idx);
+        luaL_checkstack(L, 2, "too many results");
+        if (self.has_names) {
+            lua_getiuservalue(L, 1, 1);
+            const int names = lua_gettop(L);
+            pos             = decode_fields(L, self, data, len, pos, [&](int n) {
+                lua_rawgeti(L, names, n);
+                lua_insert(L, -2);
+                lua_rawset(L, 2);
+            });
+        }
+        else {
+            pos = decode_fields(L, self, data, len, pos, [&](int n) {
+                lua_rawseti(L, 2, n);
+            });
+        }
+        lua_pushinteger(L, (lua_Integer)pos + 1);
+        return 1;
+    }
+
+    static int encode(lua_State* L) {
+        auto& self = to(L, 1);
+        luaL_Buffer b;
+        luaL_buffinit(L, &b);
+        int arg      = 1;
+        size_t total = 0;
+        for (auto const& f : self.fields) {
+            if (f.align > 1) {
+                for (size_t pad = padding(total, f.align); pad > 0; --pad) {
+                    luaL_addchar(&b, '\0');
+                    total++;
+                }
+            }
+            if (produces_value(f.k)) {
+                arg++;
+            }
+            switch (f.k) {
+            case kind::integer: {
+                lua_Integer n = luaL_checkinteger(L, arg);
+                if ((int)f.size < kIntSize) {
+                    lua_Integer lim = (lua_Integer)1 << ((f.size * CHAR_BIT) - 1);
+                    luaL_argcheck(L, -lim <= n && n < lim, arg, "integer overflow");
+                }
+                packint(&b, (lua_Unsigned)n, f.little, (int)f.size, n < 0);
+                break;
+            }
+            case kind::unsigned_integer: {
+                lua_Integer n = luaL_checkinteger(L, arg);
+                if ((int)f.size < kIntSize) {
+                    luaL_argcheck(L, (lua_Unsigned)n < ((lua_Unsigned)1 << (f.size * CHAR_BIT)), arg, "unsigned overflow");
+                }
+                packint(&b, (lua_Unsigned)n, f.little, (int)f.size, false);
+                break;
+            }
+            case kind::float32:
+                packfloat<float>(&b, (float)luaL_checknumber(L, arg), f.little);
+                break;
+            case kind::float64:
+                packfloat<double>(&b, (double)luaL_checknumber(L, arg), f.little);
+                break;
+            case kind::number:
+                packfloat<lua_Number>(&b, luaL_checknumber(L, arg), f.little);
+                break;
+            case kind::fixed_string: {
+                size_t len;
+                const char* s = luaL_checklstring(L, arg, &len);
+                luaL_argcheck(L, len <= f.size, arg, "string longer than given size");
+                luaL_addlstring(&b, s, len);
+                for (size_t i = len; i < f.size; ++i) {
+                    luaL_addchar(&b, '\0');
+                }
+                break;
+            }
+            case kind::length_string: {
+                size_t len;
+                const char* s = luaL_checklstring(L, arg, &len);
+                luaL_argcheck(L, f.size >= sizeof(size_t) || len < ((size_t)1 << (f.size * CHAR_BIT)), arg, "string length does not fit in given size");
+                packint(&b, (lua_Unsigned)len, f.little, (int)f.size, false);
+                luaL_addlstring(&b, s, len);
+                total += len;
+                break;
+            }
+            case kind::zero_string: {
+                size_t len;
+                const char* s = luaL_checklstring(L, arg, &len);
+                luaL_argcheck(L, strlen(s) == len, arg, "string contains zeros");
+                luaL_addlstring(&b, s, len);
+                luaL_addchar(&b, '\0');
+                total += len + 1;
+                break;
+            }
+            case kind::padding:
+                luaL_addchar(&b, '\0');
+                break;
+            case kind::align_only:
+                break;
+            }
+            total += f.size;
+        }
+        luaL_pushresult(&b);
+        return 1;
+    }
+
+    static int size(lua_State* L) {
+        auto& self = to(L, 1);
+        if (!self.fixed_size) {
+            return 0;
+        }
+        lua_pushinteger(L, (lua_Integer)self.pack_size);
+        return 1;
+    }
+
+    static void metatable(lua_State* L) {
+        static luaL_Reg lib[] = {
+            { "decode", decode },
+            { "decode_into", decode_into },
+            { "encode", encode },
+            { "size", size },
+            { NULL, NULL }
+        };
+        luaL_newlibtable(L, lib);
+        luaL_setfuncs(L, lib, 0);
+        lua_setfield(L, -2, "__index");
+    }
+
+    static int compile(lua_State* L) {
+        const char* fmt      = luaL_checkstring(L, 1);
+        const bool has_names = !lua_isnoneornil(L, 2);
+        if (has_names) {
+            luaL_checktype(L, 2, LUA_TTABLE);
+        }
+        // The codec owns the field list from the start, so a format error
+        // leaves it to the collector.
+        auto& self = lua::newudata<codec>(L, metatable);
+        parse_state h { native_little(), 1 };
+        while (*fmt != '\0') {
+            field f;
+            if (!getoption(L, h, fmt, f)) {
+                continue;
+            }
+            if (f.k == kind::length_string || f.k == kind::zero_string) {
+                self.fixed_size = false;
+            }
+            else {
+                self.pack_size += (f.align > 1 ? padding(self.pack_size, f.align) : 0) + f.size;
+            }
+            if (produces_value(f.k)) {
+                self.nvalues++;
+            }
+            self.fields.push_back(f);
+        }
+        if (has_names) {
+            luaL_argcheck(L, (lua_Integer)luaL_len(L, 2) == self.nvalues, 2, "names do not match the values of the format");
+            lua_createtable(L, self.nvalues, 0);
+            for (int i = 1; i <= self.nvalues; ++i) {
+                lua_rawgeti(L, 2, i);
+                luaL_argcheck(L, lua_type(L, -1) == LUA_TSTRING, 2, "names must be strings");
+                lua_rawseti(L, -2, i);
+            }
+            lua_setiuservalue(L, -2, 1);
+            self.has_names = true;
+        }
+        return 1;
+    }
+
+    static int luaopen(lua_State* L) {
+        luaL_Reg lib[] = {
+            { "compile", compile },
+            { NULL, NULL }
+        };
+        luaL_newlibtable(L, lib);
+        luaL_setfuncs(L, lib, 0);
+        return 1;
+    }
+}
+
+DEFINE_LUAOPEN(struct)
@@ -1,6 +1,8 @@
 #include <bee/error.h>
 #include <bee/nonstd/filesystem.h>
 #include <bee/subprocess.h>
+#include <bee/subprocess/output_log.h>
+#include <bee/subprocess/process_sample.h>
 #include <bee/subprocess/process_select.h>
 #include <bee/utility/assume.h>
 #include <binding/binding.h>
@@ -9,22 +11,40 @@
 #include <errno.h>
 #include <signal.h>
 
+#include <memory>
 #include <optional>
+#include <vector>
 #if defined(_WIN32)
 #    include <Windows.h>
 #    include <bee/platform/win/unicode.h>
 #    include <fcntl.h>
 #    include <io.h>
 #else
+#    include <sys/stat.h>
 #    include <unistd.h>
 #endif
 
+namespace bee::lua_subprocess {
+    struct prepared;
+    struct logged_output {
+        std::shared_ptr<subprocess::output_log> log;
+    };
+}
+
 namespace bee::lua {
     template <>
     struct udata<subprocess::process> {
         static inline int nupvalue = 1;
         static inline auto name    = "bee::subprocess";
     };
+    template <>
+    struct udata<lua_subprocess::prepared> {
+        static inline auto name = "bee::subprocess::template";
+    };
+    template <>
+    struct udata<lua_subprocess::logged_output> {
+        static inline auto name = "bee::subprocess::output";
+    };
 }
 
 namespace bee::lua_subprocess {
@@ -134,6 +154,37 @@ namespace bee::lua_subprocess {
             return 1;
         }
 
+        static void push_sample(lua_State* L, const subprocess::process_sample& s) {
+            lua_createtable(L, 0, 7);
+            lua_pushnumber(L, (lua_Number)s.user_time / 1e6);
+            lua_setfield(L, -2, "cpu_user");
+            lua_pushnumber(L, (lua_Number)s.system_time / 1e6);
+            lua_setfield(L, -2, "cpu_system");
+            lua_pushinteger(L, (lua_Integer)s.rss);
+            lua_setfield(L, -2, "rss");
+            lua_pushinteger(L, (lua_Integer)s.read_bytes);
+            lua_setfield(L, -2, "read_bytes");
+            lua_pushinteger(L, (lua_Integer)s.write_bytes);
+            lua_setfield(L, -2, "write_bytes");
+            lua_pushinteger(L, (lua_Integer)s.threads);
+            lua_setfield(L, -2, "threads");
+            lua_pushinteger(L, (lua_Integer)s.processes);
+            lua_setfield(L, -2, "processes");
+        }
+
+        static int sample(lua_State* L) {
+            auto& self = to(L, 1);
+            bool tree  = lua_toboolean(L, 2);
+            auto r     = subprocess::sample_processes({ self.get_id() }, tree);
+            if (!r[0]) {
+                lua_pushnil(L);
+                lua_pushstring(L, make_syserror("subprocess::sample").c_str());
+                return 2;
+            }
+            push_sample(L, *r[0]);
+            return 1;
+        }
+
         static int mt_index(lua_State* L) {
             lua_pushvalue(L, 2);
             if (LUA_TNIL != lua_rawget(L, lua_upvalueindex(1))) {
@@ -174,6 +225,7 @@ namespace bee::lua_subprocess {
                 { "resume", resume },
                 { "native_handle", native_handle },
                 { "detach", detach },
+                { "sample", sample },
                 { NULL, NULL }
             };
             luaL_newlibtable(L, lib);
@@ -194,9 +246,116 @@ namespace bee::lua_subprocess {
         }
     }
 
+    namespace output {
+        static auto& to(lua_State* L, int idx) {
+            return *lua::checkudata<logged_output>(L, idx).log;
+        }
+
+        static int tail(lua_State* L) {
+            auto& self = to(L, 1);
+            auto str   = self.tail();
+            lua_pushlstring(L, str.data(), str.size());
+            return 1;
+        }
+
+        static int bytes(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushinteger(L, (lua_Integer)self.bytes());
+            return 1;
+        }
+
+        static int rotations(lua_State* L) {
+            auto& self = to(L, 1);
+            lua_pushinteger(L, (lua_Integer)self.rotations());
+            return 1;
+        }
+
+        static int wait(lua_State* L) {
+            auto& self   = to(L, 1);
+            auto timeout = lua::optinteger<int, -1>(L, 2);
+            lua_pushboolean(L, self.wait(timeout));
+            return 1;
+        }
+
+        static void metatable(lua_State* L) {
+            static luaL_Reg lib[] = {
+                { "tail", tail },
+                { "bytes", bytes },
+                { "rotations", rotations },
+                { "wait", wait },
+                { NULL, NULL }
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+        }
+
+        static lua_Integer optfield(lua_State* L, int idx, const char* name, lua_Integer def) {
+            if (LUA_TNIL == lua_getfield(L, idx, name)) {
+                lua_pop(L, 1);
+                return def;
+            }
+            auto v = lua::checkinteger<lua_Integer>(L, -1);
+            lua_pop(L, 1);
+            if (v < 0) {
+                luaL_error(L, "`%s` must not be negative", name);
+            }
+            return v;
+        }
+
+        // The option table is at the top of the stack; on success it is
+        // replaced by the output object and the pipe's write end is returned.
+        static file_handle create(lua_State* L) {
+            const int idx     = lua_gettop(L);
+            auto rotate_bytes = optfield(L, idx, "rotate_bytes", 0);
+            auto keep_tail    = optfield(L, idx, "keep_tail", 0);
+            auto rotate_files = optfield(L, idx, "rotate_files", 1);
+            switch (lua_getfield(L, idx, "file")) {
+            case LUA_TSTRING:
+                break;
+            case LUA_TUSERDATA:
+                lua::checkudata<fs::path>(L, -1);
+                break;
+            default:
+                luaL_error(L, "`file` must be a string or path");
+                break;
+            }
+            auto pipe = subprocess::pipe::open();
+            if (!pipe) {
+                lua_pop(L, 2);
+                return {};
+            }
+            bool ok;
+            {
+                subprocess::output_log::options opts;
+                if (lua_type(L, -1) == LUA_TSTRING) {
+                    opts.path = lua::checkstring(L, -1);
+                }
+                else {
+                    opts.path = lua::checkudata<fs::path>(L, -1);
+                }
+                opts.rotate_bytes = (uint64_t)rotate_bytes;
+                opts.keep_tail    = (size_t)keep_tail;
+                opts.rotate_files = (int)rotate_files;
+                auto log          = subprocess::output_log::start(pipe.rd, std::move(opts));
+                ok                = !!log;
+                if (ok) {
+                    lua_pop(L, 2);
+                    lua::newudata<logged_output>(L, metatable).log = std::move(log);
+                }
+            }
+            if (!ok) {
+                pipe.wr.close();
+                lua_pushstring(L, make_syserror("subprocess::spawn").c_str());
+                lua_error(L);
+            }
+            return pipe.wr;
+        }
+    }
+
     namespace spawn {
-        static std::optional<lua::string_type> cast_cwd(lua_State* L) {
-            lua_getfield(L, 1, "cwd");
+        static std::optional<lua::string_type> cast_cwd(lua_State* L, int idx) {
+            lua_getfield(L, idx, "cwd");
             switch (lua_type(L, -1)) {
             case LUA_TSTRING: {
                 auto ret = lua::checkstring(L, -1);
@@ -239,9 +398,9 @@ namespace bee::lua_subprocess {
             }
         }
 
-        static subprocess::args_t cast_args(lua_State* L) {
+        static subprocess::args_t cast_args(lua_State* L, int idx) {
             subprocess::args_t args;
-            cast_args_array(L, 1, args);
+            cast_args_array(L, idx, args);
             return args;
         }
 
@@ -271,8 +430,8 @@ namespace bee::lua_subprocess {
             return (luaL_Stream*)r;
         }
 
-        static file_handle cast_stdio(lua_State* L, const char* name, const file_handle handle) {
-            switch (lua_getfield(L, 1, name)) {
+        static file_handle cast_stdio(lua_State* L, int idx, const char* name, const file_handle handle) {
+            switch (lua_getfield(L, idx, name)) {
             case LUA_TUSERDATA: {
                 luaL_Stream* p = get_file(L, -1);
                 if (!p->closef) {
@@ -307,6 +466,11 @@ namespace bee::lua_subprocess {
                     return pipe.wr;
                 }
             }
+            case LUA_TTABLE:
+                if (strcmp(name, "stdin") == 0) {
+                    break;
+                }
+                return output::create(L);
             case LUA_TSTRING: {
                 if (strcmp(name, "stderr") == 0 && strcmp(lua_tostring(L, -1), "stdout") == 0 && handle) {
                     lua_pop(L, 1);
@@ -321,17 +485,17 @@ namespace bee::lua_subprocess {
             return {};
         }
 
-        static file_handle cast_stdio(lua_State* L, subprocess::spawn& self, const char* name, subprocess::stdio type, const file_handle handle = {}) {
-            file_handle f = cast_stdio(L, name, handle);
+        static file_handle cast_stdio(lua_State* L, int idx, subprocess::spawn& self, const char* name, subprocess::stdio type, const file_handle handle = {}) {
+            file_handle f = cast_stdio(L, idx, name, handle);
             if (f) {
                 self.redirect(type, f);
             }
             return f;
         }
 
-        static void cast_env(lua_State* L, subprocess::spawn& self) {
+        static subprocess::environment cast_env(lua_State* L, int idx, bool snapshot = false) {
             subprocess::envbuilder builder;
-            if (LUA_TTABLE == lua_getfield(L, 1, "env")) {
+            if (LUA_TTABLE == lua_getfield(L, idx, "env")) {
                 lua_pushnil(L);
                 while (lua_next(L, -2)) {
                     if (LUA_TSTRING == lua_type(L, -1)) {
@@ -344,101 +508,425 @@ namespace bee::lua_subprocess {
                 }
             }
             lua_pop(L, 1);
-            self.env(builder.release());
+            return builder.release(snapshot);
         }
 
-        static void cast_suspended(lua_State* L, subprocess::spawn& self) {
-            if (LUA_TBOOLEAN == lua_getfield(L, 1, "suspended")) {
-                if (lua_toboolean(L, -1)) {
-                    self.suspended();
-                }
-            }
+        static bool cast_boolean(lua_State* L, int idx, const char* name) {
+            bool ok = LUA_TBOOLEAN == lua_getfield(L, idx, name) && lua_toboolean(L, -1);
             lua_pop(L, 1);
+            return ok;
         }
 
-        static void cast_detached(lua_State* L, subprocess::spawn& self) {
-            if (LUA_TBOOLEAN == lua_getfield(L, 1, "detached")) {
-                if (lua_toboolean(L, -1)) {
-                    self.detached();
-                }
+        static void cast_suspended(lua_State* L, int idx, subprocess::spawn& self) {
+            if (cast_boolean(L, idx, "suspended")) {
+                self.suspended();
+            }
+        }
+
+        static void cast_detached(lua_State* L, int idx, subprocess::spawn& self) {
+            if (cast_boolean(L, idx, "detached")) {
+                self.detached();
             }
-            lua_pop(L, 1);
         }
 
 #if defined(_WIN32)
-        static void cast_option(lua_State* L, subprocess::spawn& self) {
-            if (LUA_TSTRING == lua_getfield(L, 1, "console")) {
+        static std::optional<subprocess::console> cast_console(lua_State* L, int idx) {
+            std::optional<subprocess::console> r;
+            if (LUA_TSTRING == lua_getfield(L, idx, "console")) {
                 auto console = lua::checkstrview(L, -1);
                 if (console == "new") {
-                    self.set_console(subprocess::console::eNew);
+                    r = subprocess::console::eNew;
                 }
                 else if (console == "disable") {
-                    self.set_console(subprocess::console::eDisable);
+                    r = subprocess::console::eDisable;
                 }
                 else if (console == "inherit") {
-                    self.set_console(subprocess::console::eInherit);
+                    r = subprocess::console::eInherit;
                 }
                 else if (console == "detached") {
-                    self.set_console(subprocess::console::eDetached);
+                    r = subprocess::console::eDetached;
                 }
                 else if (console == "hide") {
-                    self.set_console(subprocess::console::eHide);
+                    r = subprocess::console::eHide;
                 }
             }
             lua_pop(L, 1);
+            return r;
+        }
 
-            if (LUA_TBOOLEAN == lua_getfield(L, 1, "hideWindow")) {
-                if (lua_toboolean(L, -1)) {
-                    self.hide_window();
-                }
+        static void cast_option(lua_State* L, int idx, subprocess::spawn& self) {
+            if (auto console = cast_console(L, idx)) {
+                self.set_console(*console);
             }
-            lua_pop(L, 1);
-
-            if (LUA_TBOOLEAN == lua_getfield(L, 1, "searchPath")) {
-                if (lua_toboolean(L, -1)) {
-                    self.search_path();
-                }
+            if (cast_boolean(L, idx, "hideWindow")) {
+                self.hide_window();
+            }
+            if (cast_boolean(L, idx, "searchPath")) {
+                self.search_path();
             }
-            lua_pop(L, 1);
         }
 #else
-        static void cast_option(lua_State*, subprocess::spawn&) {}
+        static void cast_option(lua_State*, int, subprocess::spawn&) {}
 #endif
 
+        static int exec(lua_State* L, int idx, subprocess::spawn& spawn, subprocess::args_t& args, const lua::string_type::value_type* cwd) {
+            file_handle f_stdin  = cast_stdio(L, idx, spawn, "stdin", subprocess::stdio::eInput);
+            file_handle f_stdout = cast_stdio(L, idx, spawn, "stdout", subprocess::stdio::eOutput);
+            file_handle f_stderr = cast_stdio(L, idx, spawn, "stderr", subprocess::stdio::eError, f_stdout);
+            if (!spawn.exec(args, cwd)) {
+                lua_pushnil(L);
+                lua_pushstring(L, make_syserror("subprocess::spawn").c_str());
+                return 2;
+            }
+            process::constructor(L, spawn);
+            if (f_stderr) {
+                process::set_uservalue(L, "stderr");
+            }
+            if (f_stdout) {
+                process::set_uservalue(L, "stdout");
+            }
+            if (f_stdin) {
+                process::set_uservalue(L, "stdin");
+            }
+            return 1;
+        }
+
         static int spawn(lua_State* L) {
             luaL_checktype(L, 1, LUA_TTABLE);
             subprocess::spawn spawn;
-            subprocess::args_t args = cast_args(L);
+            subprocess::args_t args = cast_args(L, 1);
             if (args.size() == 0) {
                 lua_pushnil(L);
                 lua_pushstring(L, "no process");
                 return 2;
             }
 
-            auto cwd = cast_cwd(L);
-            cast_env(L, spawn);
-            cast_suspended(L, spawn);
-            cast_option(L, spawn);
-            cast_detached(L, spawn);
+            auto cwd = cast_cwd(L, 1);
+            spawn.env(cast_env(L, 1));
+            cast_suspended(L, 1, spawn);
+            cast_option(L, 1, spawn);
+            cast_detached(L, 1, spawn);
+
+            return exec(L, 1, spawn, args, cwd ? cwd->c_str() : 0);
+        }
+
+        static void pipeline_abort(lua_State* L, int procs, file_handle& prev, file_handle& capture) {
+            prev.close();
+            capture.close();
+            const lua_Integer n = luaL_len(L, procs);
+            for (lua_Integer i = 1; i <= n; ++i) {
+                lua_geti(L, procs, i);
+                auto& p = process::to(L, -1);
+                p.kill(SIGTERM);
+                p.wait();
+                lua_pop(L, 1);
+            }
+        }
+
+        static void pipeline_capture(lua_State* L, file_handle& capture) {
+            FILE* f = capture.to_file(file_handle::mode::read);
+            if (!f) {
+                capture.close();
+                lua_pushliteral(L, "");
+                return;
+            }
+            luaL_Buffer b;
+            luaL_buffinit(L, &b);
+            for (;;) {
+                char* p  = luaL_prepbuffer(&b);
+                size_t n = fread(p, 1, LUAL_BUFFERSIZE, f);
+                luaL_addsize(&b, n);
+                if (n < LUAL_BUFFERSIZE) {
+                    break;
+                }
+            }
+            fclose(f);
+            luaL_pushresult(&b);
+        }
 
-            file_handle f_stdin  = cast_stdio(L, spawn, "stdin", subprocess::stdio::eInput);
-            file_handle f_stdout = cast_stdio(L, spawn, "stdout", subprocess::stdio::eOutput);
-            file_handle f_stderr = cast_stdio(L, spawn, "stderr", subprocess::stdio::eError, f_stdout);
-            if (!spawn.exec(args, cwd ? cwd->c_str() : 0)) {
+        // capture reads the last stage's output to the end before returning,
+        // so nobody could feed a stdin pipe or drain a stderr pipe meanwhile.
+        static void pipeline_check_capture(lua_State* L, lua_Integer n) {
+            if (cast_boolean(L, 1, "stdin")) {
+                luaL_argerror(L, 1, "stdin = true can not be used with capture");
+            }
+            for (lua_Integer i = 1; i <= n; ++i) {
+                if (lua_geti(L, 1, i) == LUA_TTABLE && cast_boolean(L, -1, "stderr")) {
+                    luaL_argerror(L, 1, "stderr = true can not be used with capture");
+                }
+                lua_pop(L, 1);
+            }
+        }
+
+        // Each stage's stdout is connected to the next stage's stdin by a pipe
+        // created just before the next spawn, so no child inherits a write end
+        // that belongs to a later stage.
+        static int pipeline(lua_State* L) {
+            luaL_checktype(L, 1, LUA_TTABLE);
+            const lua_Integer n = luaL_len(L, 1);
+            if (n == 0) {
                 lua_pushnil(L);
-                lua_pushstring(L, make_syserror("subprocess::spawn").c_str());
+                lua_pushstring(L, "no process");
                 return 2;
             }
-            process::constructor(L, spawn);
-            if (f_stderr) {
-                process::set_uservalue(L, "stderr");
+            lua_getfield(L, 1, "capture");
+            const bool capture = lua_toboolean(L, -1);
+            lua_settop(L, 1);
+            if (capture) {
+                pipeline_check_capture(L, n);
             }
-            if (f_stdout) {
-                process::set_uservalue(L, "stdout");
+            lua_createtable(L, (int)n, 0);
+            const int procs = lua_gettop(L);
+            file_handle prev;
+            file_handle output;
+            for (lua_Integer i = 1; i <= n; ++i) {
+                luaL_argexpected(L, lua_geti(L, 1, i) == LUA_TTABLE, 1, "table of stages");
+                const int stage = lua_gettop(L);
+                subprocess::spawn spawn;
+                subprocess::args_t args = cast_args(L, stage);
+                if (args.size() == 0) {
+                    pipeline_abort(L, procs, prev, output);
+                    lua_pushnil(L);
+                    lua_pushstring(L, "no process");
+                    return 2;
+                }
+                auto cwd = cast_cwd(L, stage);
+                spawn.env(cast_env(L, stage));
+                cast_option(L, stage, spawn);
+
+                file_handle f_stdin;
+                file_handle f_stdout;
+                file_handle next;
+                if (i == 1) {
+                    f_stdin = cast_stdio(L, 1, spawn, "stdin", subprocess::stdio::eInput);
+                }
+                else {
+                    spawn.redirect(subprocess::stdio::eInput, prev);
+                }
+                if (i == n && !capture) {
+                    f_stdout = cast_stdio(L, 1, spawn, "stdout", subprocess::stdio::eOutput);
+                }
+                else {
+                    auto pipe = subprocess::pipe::open();
+                    if (!pipe) {
+                        pipeline_abort(L, procs, prev, output);
+                        lua_pushnil(L);
+                        lua_pushstring(L, make_syserror("subprocess::pipeline").c_str());
+                        return 2;
+                    }
+                    spawn.redirect(subprocess::stdio::eOutput, pipe.wr);
+                    (i == n ? output : next) = pipe.rd;
+                    f_stdout                 = pipe.wr;
+                }
+                file_handle f_stderr = cast_stdio(L, stage, spawn, "stderr", subprocess::stdio::eError, i == n && !capture ? f_stdout : file_handle {});
+                if (!spawn.exec(args, cwd ? cwd->c_str() : 0)) {
+                    auto error = make_syserror("subprocess::pipeline");
+                    if (f_stderr && f_stderr != f_stdout) {
+                        f_stderr.close();
+                    }
+                    f_stdin.close();
+                    f_stdout.close();
+                    next.close();
+                    pipeline_abort(L, procs, prev, output);
+                    lua_pushnil(L);
+                    lua_pushstring(L, error.c_str());
+                    return 2;
+                }
+                prev = next;
+                process::constructor(L, spawn);
+                if (f_stderr) {
+                    process::set_uservalue(L, "stderr");
+                }
+                if (f_stdout && i == n && !capture) {
+                    process::set_uservalue(L, "stdout");
+                }
+                if (f_stdin) {
+                    process::set_uservalue(L, "stdin");
+                }
+                lua_rawseti(L, procs, i);
+                lua_settop(L, procs);
             }
-            if (f_stdin) {
-                process::set_uservalue(L, "stdin");
+            if (!capture) {
+                return 1;
+            }
+            pipeline_capture(L, output);
+            lua_createtable(L, (int)n, 0);
+            for (lua_Integer i = 1; i <= n; ++i) {
+                lua_geti(L, procs, i);
+                auto status = process::to(L, -1).wait();
+                lua_pop(L, 1);
+                if (status) {
+                    lua_pushinteger(L, (lua_Integer)*status);
+                }
+                else {
+                    lua_pushboolean(L, 0);
+                }
+                lua_rawseti(L, -2, i);
+            }
+            return 3;
+        }
+    }
+
+    // A spawn description whose option table has been parsed once: the
+    // executable is resolved against PATH, cwd is checked and the environment
+    // block is built up front, so each spawn only appends its own arguments.
+    struct prepared {
+        std::vector<lua::string_type> args;
+        std::optional<lua::string_type> cwd;
+        subprocess::environment env = nullptr;
+        bool suspended              = false;
+        bool detached               = false;
+#if defined(_WIN32)
+        std::optional<subprocess::console> console;
+        bool hide_window = false;
+#endif
+    };
+
+    namespace prepared_spawn {
+#if defined(_WIN32)
+        static bool resolve_executable(std::wstring& exe) {
+            DWORD n = ::SearchPathW(NULL, exe.c_str(), L".exe", 0, NULL, NULL);
+            if (n == 0) {
+                return false;
+            }
+            std::wstring path(n, L'\0');
+            n = ::SearchPathW(NULL, exe.c_str(), L".exe", n, path.data(), NULL);
+            if (n == 0 || n >= path.size()) {
+                return false;
             }
+            path.resize(n);
+            exe = std::move(path);
+            return true;
+        }
+#else
+        static bool resolve_executable(std::string& exe) {
+            if (exe.find('/') != std::string::npos) {
+                return true;
+            }
+            const char* env       = getenv("PATH");
+            std::string_view path = env ? env : "/bin:/usr/bin";
+            for (;;) {
+                auto pos = path.find(':');
+                auto dir = path.substr(0, pos);
+                std::string candidate { dir.empty() ? "." : dir };
+                candidate += '/';
+                candidate += exe;
+                struct stat st;
+                if (::stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && ::access(candidate.c_str(), X_OK) == 0) {
+                    exe = std::move(candidate);
+                    return true;
+                }
+                if (pos == std::string_view::npos) {
+                    break;
+                }
+                path.remove_prefix(pos + 1);
+            }
+            errno = ENOENT;
+            return false;
+        }
+#endif
+
+        static int spawn(lua_State* L) {
+            auto& self            = lua::checkudata<prepared>(L, 1);
+            const bool has_option = !lua_isnoneornil(L, 2);
+            if (has_option) {
+                luaL_checktype(L, 2, LUA_TTABLE);
+            }
+            lua_settop(L, 2);
+            subprocess::spawn spawn;
+            subprocess::args_t args;
+            for (auto const& arg : self.args) {
+#if defined(_WIN32)
+                args.push(std::wstring { arg });
+#else
+                args.push(zstring_view { arg });
+#endif
+            }
+            if (has_option) {
+                spawn::cast_args_array(L, 2, args);
+            }
+            if (self.env) {
+                spawn.share_env(self.env);
+            }
+            if (self.suspended) {
+                spawn.suspended();
+            }
+#if defined(_WIN32)
+            if (self.console) {
+                spawn.set_console(*self.console);
+            }
+            if (self.hide_window) {
+                spawn.hide_window();
+            }
+#endif
+            if (self.detached) {
+                spawn.detached();
+            }
+            if (!has_option) {
+                if (!spawn.exec(args, self.cwd ? self.cwd->c_str() : 0)) {
+                    lua_pushnil(L);
+                    lua_pushstring(L, make_syserror("subprocess::spawn").c_str());
+                    return 2;
+                }
+                return process::constructor(L, spawn);
+            }
+            return spawn::exec(L, 2, spawn, args, self.cwd ? self.cwd->c_str() : 0);
+        }
+
+        static void metatable(lua_State* L) {
+            static luaL_Reg lib[] = {
+                { "spawn", spawn },
+                { NULL, NULL }
+            };
+            luaL_newlibtable(L, lib);
+            luaL_setfuncs(L, lib, 0);
+            lua_setfield(L, -2, "__index");
+        }
+
+        static int create(lua_State* L) {
+            luaL_checktype(L, 1, LUA_TTABLE);
+            auto& self = lua::newudata<prepared>(L, metatable);
+            {
+                subprocess::args_t args = spawn::cast_args(L, 1);
+                for (size_t i = 0; i < args.size(); ++i) {
+                    self.args.emplace_back(args[i]);
+                }
+            }
+            if (self.args.empty()) {
+                lua_pushnil(L);
+                lua_pushstring(L, "no process");
+                return 2;
+            }
+#if defined(_WIN32)
+            const bool search = spawn::cast_boolean(L, 1, "searchPath");
+#else
+            const bool search = true;
+#endif
+            if (search && !resolve_executable(self.args[0])) {
+                lua_pushnil(L);
+                lua_pushstring(L, make_syserror("subprocess::template").c_str());
+                return 2;
+            }
+            self.cwd = spawn::cast_cwd(L, 1);
+            if (self.cwd) {
+                std::error_code ec;
+                if (!fs::is_directory(fs::path { *self.cwd }, ec)) {
+                    if (!ec) {
+                        ec = std::make_error_code(std::errc::not_a_directory);
+                    }
+                    lua_pushnil(L);
+                    lua_pushstring(L, make_error(ec, "subprocess::template").c_str());
+                    return 2;
+                }
+            }
+            // a snapshot, so later subprocess.setenv calls do not leak in
+            self.env       = spawn::cast_env(L, 1, true);
+            self.suspended = spawn::cast_boolean(L, 1, "suspended");
+            self.detached  = spawn::cast_boolean(L, 1, "detached");
+#if defined(_WIN32)
+            self.console     = spawn::cast_console(L, 1);
+            self.hide_window = spawn::cast_boolean(L, 1, "hideWindow");
+#endif
             return 1;
         }
     }
@@ -472,6 +960,43 @@ namespace bee::lua_subprocess {
         }
     }
 
+    static int sample(lua_State* L) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        bool tree     = lua_toboolean(L, 2);
+        lua_Integer n = luaL_len(L, 1);
+        for (lua_Integer i = 1; i <= n; ++i) {
+            if (LUA_TNUMBER == lua_geti(L, 1, i)) {
+                lua::checkinteger<subprocess::process_id>(L, -1);
+            }
+            else {
+                process::to(L, -1);
+            }
+            lua_pop(L, 1);
+        }
+        std::vector<subprocess::process_id> pids((size_t)n);
+        for (lua_Integer i = 0; i < n; ++i) {
+            if (LUA_TNUMBER == lua_geti(L, 1, i + 1)) {
+                pids[(size_t)i] = (subprocess::process_id)lua_tointeger(L, -1);
+            }
+            else {
+                pids[(size_t)i] = process::to(L, -1).get_id();
+            }
+            lua_pop(L, 1);
+        }
+        auto r = subprocess::sample_processes(pids, tree);
+        lua_createtable(L, (int)n, 0);
+        for (lua_Integer i = 0; i < n; ++i) {
+            if (auto& s = r[(size_t)i]) {
+                process::push_sample(L, *s);
+            }
+            else {
+                lua_pushboolean(L, 0);
+            }
+            lua_rawseti(L, -2, i + 1);
+        }
+        return 1;
+    }
+
     static int peek(lua_State* L) {
         luaL_Stream* p = spawn::get_file(L, 1);
         if (!p->closef) {
@@ -597,7 +1122,10 @@ return table.concat(t)
     static int luaopen(lua_State* L) {
         static luaL_Reg lib[] = {
             { "spawn", spawn::spawn },
+            { "pipeline", spawn::pipeline },
+            { "template", prepared_spawn::create },
             { "select", select },
+            { "sample", sample },
             { "peek", peek },
             { "filemode", filemode },
             { "setenv", lsetenv },
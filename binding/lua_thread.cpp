@@ -2,13 +2,18 @@
 #include <bee/nonstd/format.h>
 #include <bee/nonstd/print.h>
 #include <bee/nonstd/semaphore.h>
+#include <bee/thread/adaptive_mutex.h>
 #include <bee/thread/atomic_semaphore.h>
+#include <bee/thread/lockstats.h>
 #include <bee/thread/setname.h>
 #include <bee/thread/simplethread.h>
 #include <bee/thread/spinlock.h>
 #include <binding/binding.h>
+#include <binding/channel.h>
 
 #include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <mutex>
@@ -20,19 +25,82 @@ extern "C" {
 }
 
 namespace bee::lua_thread {
+    struct waitstats {
+        std::atomic<uint64_t> waits   = 0;
+        std::atomic<uint64_t> wait_ns = 0;
+
+        static uint64_t start() noexcept {
+            return lockstats::enabled.load(std::memory_order_relaxed) ? lockstats::now() : 0;
+        }
+        void finish(uint64_t start) noexcept {
+            if (start) {
+                waits.fetch_add(1, std::memory_order_relaxed);
+                wait_ns.fetch_add(lockstats::now() - start, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // The channel lock is an adaptive_mutex; benchmarks can ask for the old
+    // spinlock to compare the two on the same workload.
+    class channel_lock {
+    public:
+        channel_lock(lockstats* stats, bool spin) noexcept
+            : adaptive(stats)
+            , stats(stats)
+            , spin(spin) {}
+        void lock() noexcept {
+            if (!spin) {
+                adaptive.lock();
+                return;
+            }
+            if (spinner.try_lock()) {
+                if (lockstats::active(stats)) {
+                    stats->acquires.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+            if (!lockstats::active(stats)) {
+                spinner.lock();
+                return;
+            }
+            uint64_t start = lockstats::now();
+            spinner.lock();
+            stats->acquires.fetch_add(1, std::memory_order_relaxed);
+            stats->contended.fetch_add(1, std::memory_order_relaxed);
+            stats->wait_ns.fetch_add(lockstats::now() - start, std::memory_order_relaxed);
+        }
+        void unlock() noexcept {
+            if (spin) {
+                spinner.unlock();
+            }
+            else {
+                adaptive.unlock();
+            }
+        }
+
+    private:
+        adaptive_mutex adaptive;
+        spinlock spinner;
+        lockstats* stats;
+        bool spin;
+    };
+
     class channel {
     public:
         using value_type = void*;
 
+        explicit channel(bool spin = false)
+            : mutex(&lock_stats, spin) {}
+
         void push(value_type data) {
             do {
-                std::unique_lock<spinlock> lk(mutex);
+                std::unique_lock<channel_lock> lk(mutex);
                 queue.push(data);
             } while (0);
             sem.release();
         }
         bool pop(value_type& data) {
-            std::unique_lock<spinlock> lk(mutex);
+            std::unique_lock<channel_lock> lk(mutex);
             if (queue.empty()) {
                 return false;
             }
@@ -40,42 +108,65 @@ namespace bee::lua_thread {
             queue.pop();
             return true;
         }
-        void blocked_pop(value_type& data) {
+        bool blocked_pop(value_type& data) {
+            if (pop(data)) {
+                return false;
+            }
+            uint64_t start = waitstats::start();
             for (;;) {
+                sem.acquire();
                 if (pop(data)) {
-                    return;
+                    break;
                 }
-                sem.acquire();
             }
+            wait_stats.finish(start);
+            return true;
         }
         template <class Rep, class Period>
-        bool timed_pop(value_type& data, const std::chrono::duration<Rep, Period>& timeout) {
+        bool timed_pop(value_type& data, const std::chrono::duration<Rep, Period>& timeout, bool& waited) {
             auto now = std::chrono::steady_clock::now();
+            waited   = false;
             if (pop(data)) {
                 return true;
             }
-            if (!sem.try_acquire_for(timeout)) {
-                return false;
-            }
-            auto time = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
-            while (!pop(data)) {
-                if (!sem.try_acquire_until(time)) {
-                    return false;
+            waited         = true;
+            uint64_t start = waitstats::start();
+            bool ok        = sem.try_acquire_for(timeout);
+            if (ok) {
+                auto time = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+                while (!(ok = pop(data))) {
+                    if (!sem.try_acquire_until(time)) {
+                        break;
+                    }
                 }
             }
-            return true;
+            wait_stats.finish(start);
+            return ok;
+        }
+        void add_caller(std::string_view where) {
+            std::unique_lock<std::mutex> lk(callers_mutex);
+            callers[std::string { where }]++;
+        }
+        std::map<std::string, uint64_t> get_callers() {
+            std::unique_lock<std::mutex> lk(callers_mutex);
+            return callers;
         }
 
+        lockstats lock_stats;
+        waitstats wait_stats;
+
     private:
         std::queue<value_type> queue;
-        spinlock mutex;
+        channel_lock mutex;
         std::binary_semaphore sem = std::binary_semaphore(0);
+        std::mutex callers_mutex;
+        std::map<std::string, uint64_t> callers;
     };
 
-    using boxchannel = std::shared_ptr<channel>;
+    static lockstats g_rpc_lock_stats;
 
     struct rpc {
-        atomic_semaphore sem;
+        atomic_semaphore sem { &g_rpc_lock_stats };
         void* data = nullptr;
     };
 }
@@ -97,18 +188,18 @@ namespace bee::lua_thread {
         channelmgr() {
             channels.emplace(std::make_pair("errlog", std::make_shared<channel>()));
         }
-        bool create(zstring_view name) {
-            std::unique_lock<spinlock> lk(mutex);
+        bool create(zstring_view name, bool spin = false) {
+            std::unique_lock<adaptive_mutex> lk(mutex);
             std::string namestr { name.data(), name.size() };
             auto it = channels.find(namestr);
             if (it != channels.end()) {
                 return false;
             }
-            channels.emplace(std::make_pair(namestr, new channel));
+            channels.emplace(std::make_pair(namestr, new channel(spin)));
             return true;
         }
         void clear() {
-            std::unique_lock<spinlock> lk(mutex);
+            std::unique_lock<adaptive_mutex> lk(mutex);
             auto it = channels.find("errlog");
             if (it != channels.end()) {
                 auto errlog = it->second;
@@ -120,7 +211,7 @@ namespace bee::lua_thread {
             }
         }
         boxchannel query(zstring_view name) {
-            std::unique_lock<spinlock> lk(mutex);
+            std::unique_lock<adaptive_mutex> lk(mutex);
             std::string namestr { name.data(), name.size() };
             auto it = channels.find(namestr);
             if (it != channels.end()) {
@@ -129,12 +220,30 @@ namespace bee::lua_thread {
             return nullptr;
         }
 
+        std::map<std::string, boxchannel> list() {
+            std::unique_lock<adaptive_mutex> lk(mutex);
+            return channels;
+        }
+
+        lockstats lock_stats;
+
     private:
         std::map<std::string, boxchannel> channels;
-        spinlock mutex;
+        adaptive_mutex mutex { &lock_stats };
     };
 
     static channelmgr g_channel;
+    static waitstats g_rpc_stats;
+
+    boxchannel channel_open(std::string_view name) {
+        std::string namestr { name.data(), name.size() };
+        g_channel.create(namestr);
+        return g_channel.query(namestr);
+    }
+
+    void channel_push(channel& c, void* data) {
+        c.push(data);
+    }
     static std::atomic<int> g_thread_id = -1;
     static int THREADID;
 
@@ -145,10 +254,30 @@ namespace bee::lua_thread {
         return 0;
     }
 
+    static void record_caller(lua_State* L, channel& c) {
+        if (!lockstats::enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        lua_Debug ar;
+        for (int level = 1; lua_getstack(L, level, &ar); ++level) {
+            lua_getinfo(L, "Sl", &ar);
+            if (ar.currentline > 0) {
+                lua_pushfstring(L, "%s:%d:", ar.short_src, ar.currentline);
+                size_t sz;
+                const char* where = lua_tolstring(L, -1, &sz);
+                c.add_caller({ where, sz });
+                lua_pop(L, 1);
+                return;
+            }
+        }
+    }
+
     static int lchannel_bpop(lua_State* L) {
         auto& bc = lua::checkudata<boxchannel>(L, 1);
         void* data;
-        bc->blocked_pop(data);
+        if (bc->blocked_pop(data)) {
+            record_caller(L, *bc);
+        }
         return seri_unpackptr(L, data);
     }
 
@@ -164,7 +293,12 @@ namespace bee::lua_thread {
             }
         }
         else {
-            if (!bc->timed_pop(data, std::chrono::duration<double>(sec))) {
+            bool waited;
+            bool ok = bc->timed_pop(data, std::chrono::duration<double>(sec), waited);
+            if (waited) {
+                record_caller(L, *bc);
+            }
+            if (!ok) {
                 lua_pushboolean(L, 0);
                 return 1;
             }
@@ -174,8 +308,10 @@ namespace bee::lua_thread {
     }
 
     static int lnewchannel(lua_State* L) {
+        static const char* const locks[] = { "adaptive", "spinlock", NULL };
         auto name = lua::checkstrview(L, 1);
-        if (!g_channel.create(name)) {
+        bool spin = luaL_checkoption(L, 2, "adaptive", locks) == 1;
+        if (!g_channel.create(name, spin)) {
             return luaL_error(L, "Duplicate channel '%s'", name.data());
         }
         return 0;
@@ -274,6 +410,7 @@ namespace bee::lua_thread {
             }
         }
         lua_close(L);
+        seri_threadexit();
     }
 
     static int lthread(lua_State* L) {
@@ -325,8 +462,10 @@ namespace bee::lua_thread {
     }
 
     static int lrpc_wait(lua_State* L) {
-        auto r = lua::checklightud<struct rpc*>(L, 1);
+        auto r         = lua::checklightud<struct rpc*>(L, 1);
+        uint64_t start = waitstats::start();
         r->sem.acquire();
+        g_rpc_stats.finish(start);
         return seri_unpackptr(L, r->data);
     }
 
@@ -337,6 +476,59 @@ namespace bee::lua_thread {
         return 0;
     }
 
+    static void push_lockstats(lua_State* L, const lockstats& s) {
+        lua_pushinteger(L, (lua_Integer)s.acquires.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "acquires");
+        lua_pushinteger(L, (lua_Integer)s.contended.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "contended");
+        lua_pushinteger(L, (lua_Integer)s.spins.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "spins");
+        lua_pushinteger(L, (lua_Integer)s.parks.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "parks");
+        lua_pushinteger(L, (lua_Integer)s.wait_ns.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "lock_wait_ns");
+    }
+
+    static void push_waitstats(lua_State* L, const waitstats& s) {
+        lua_pushinteger(L, (lua_Integer)s.waits.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "waits");
+        lua_pushinteger(L, (lua_Integer)s.wait_ns.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "wait_ns");
+    }
+
+    static int llockstats(lua_State* L) {
+        if (!lua_isnoneornil(L, 1)) {
+            luaL_checktype(L, 1, LUA_TBOOLEAN);
+            lockstats::enabled.store(lua_toboolean(L, 1), std::memory_order_relaxed);
+            return 0;
+        }
+        lua_createtable(L, 0, 4);
+        lua_pushboolean(L, lockstats::enabled.load(std::memory_order_relaxed));
+        lua_setfield(L, -2, "enabled");
+        lua_createtable(L, 0, 5);
+        push_lockstats(L, g_channel.lock_stats);
+        lua_setfield(L, -2, "channelmgr");
+        lua_createtable(L, 0, 7);
+        push_lockstats(L, g_rpc_lock_stats);
+        push_waitstats(L, g_rpc_stats);
+        lua_setfield(L, -2, "rpc");
+        lua_newtable(L);
+        for (auto& [name, c] : g_channel.list()) {
+            lua_createtable(L, 0, 8);
+            push_lockstats(L, c->lock_stats);
+            push_waitstats(L, c->wait_stats);
+            lua_newtable(L);
+            for (auto& [where, n] : c->get_callers()) {
+                lua_pushinteger(L, (lua_Integer)n);
+                lua_setfield(L, -2, where.c_str());
+            }
+            lua_setfield(L, -2, "callers");
+            lua_setfield(L, -2, name.c_str());
+        }
+        lua_setfield(L, -2, "channels");
+        return 1;
+    }
+
     static void init_threadid(lua_State* L) {
         if (lua_rawgetp(L, LUA_REGISTRYINDEX, &THREADID) != LUA_TNIL) {
             return;
@@ -360,12 +552,16 @@ namespace bee::lua_thread {
             { "rpc_create", lrpc_create },
             { "rpc_wait", lrpc_wait },
             { "rpc_return", lrpc_return },
+            { "lockstats", llockstats },
             { "preload_module", ::bee::lua::preload_module },
             { "id", NULL },
             { NULL, NULL },
         };
         luaL_newlibtable(L, lib);
         luaL_setfuncs(L, lib, 0);
+        if (const char* env = getenv("BEE_LOCKSTATS"); env && env[0] && strcmp(env, "0") != 0) {
+            lockstats::enabled.store(true, std::memory_order_relaxed);
+        }
         init_threadid(L);
         lua_setfield(L, -2, "id");
         return 1;
@@ -11,8 +11,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>
 #include <lua.hpp>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #if !defined(ENABLE_VIRTUAL_TERMINAL_PROCESSING)
 #    define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
@@ -101,6 +105,311 @@ static int docall(lua_State *L, int narg, int nres) {
     return status;
 }
 
+/*
+** Startup tracer. Enabled by the environment variable BEE_STARTUP_TRACE or
+** by a leading '--trace-startup[=file]' option. A value of "1" prints a
+** report to stderr; anything else is the path of a Chrome trace JSON file.
+*/
+typedef struct TraceEvent {
+    std::string name;
+    const char *cat;
+    uint64_t start; /* nanoseconds */
+    uint64_t dur;
+    int parent;
+} TraceEvent;
+
+static bool trace_enabled = false;
+static std::string trace_output;
+static std::vector<TraceEvent> trace_events;
+static std::vector<int> trace_stack;
+
+static uint64_t trace_now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int trace_begin(std::string name, const char *cat) {
+    if (!trace_enabled) return -1;
+    int idx = (int)trace_events.size();
+    trace_events.push_back({ std::move(name), cat, trace_now(), 0, trace_stack.empty() ? -1 : trace_stack.back() });
+    trace_stack.push_back(idx);
+    return idx;
+}
+
+static void trace_end(int idx) {
+    if (idx < 0) return;
+    trace_events[idx].dur = trace_now() - trace_events[idx].start;
+    while (!trace_stack.empty() && trace_stack.back() >= idx) /* also close spans skipped by an error */
+        trace_stack.pop_back();
+}
+
+struct TraceScope {
+    int idx;
+    TraceScope(std::string name, const char *cat)
+        : idx(trace_begin(std::move(name), cat)) {}
+    ~TraceScope() { trace_end(idx); }
+};
+
+static void trace_setoutput(const char *value) {
+    trace_enabled = true;
+    if (strcmp(value, "1") == 0 || strcmp(value, "report") == 0)
+        trace_output.clear();
+    else
+        trace_output = value;
+}
+
+static void trace_report(FILE *f) {
+    std::vector<uint64_t> self(trace_events.size());
+    std::vector<size_t> order(trace_events.size());
+    uint64_t category[6] = {};
+    static const char *const categories[6] = { "lookup", "read", "parse", "execute", "search", "require" };
+    for (size_t i = 0; i < trace_events.size(); i++) {
+        const TraceEvent &ev = trace_events[i];
+        self[i] += ev.dur;
+        if (ev.parent >= 0) self[ev.parent] -= ev.dur;
+        order[i] = i;
+        for (int c = 0; c < 4; c++)
+            if (strcmp(ev.cat, categories[c]) == 0) category[c] += ev.dur;
+    }
+    std::sort(order.begin(), order.end(), [](size_t a, size_t b) { return trace_events[a].dur > trace_events[b].dur; });
+    uint64_t total = 0;
+    for (auto &ev : trace_events)
+        if (ev.parent < 0) total += ev.dur;
+    fprintf(f, "startup trace: %.3f ms, %zu events\n", total / 1e6, trace_events.size());
+    fprintf(f, "%12s %12s  %s\n", "total(ms)", "self(ms)", "event");
+    for (size_t i : order) {
+        const TraceEvent &ev = trace_events[i];
+        fprintf(f, "%12.3f %12.3f  %s\n", ev.dur / 1e6, self[i] / 1e6, ev.name.c_str());
+    }
+    fprintf(f, "module loads:");
+    for (int c = 0; c < 4; c++) fprintf(f, " %s %.3f ms%s", categories[c], category[c] / 1e6, c < 3 ? "," : "\n");
+}
+
+static void trace_jsonstring(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void trace_json(FILE *f) {
+    uint64_t base = trace_events.empty() ? 0 : trace_events[0].start;
+    fprintf(f, "{\"traceEvents\":[");
+    for (size_t i = 0; i < trace_events.size(); i++) {
+        const TraceEvent &ev = trace_events[i];
+        fprintf(f, "%s\n{\"name\":", i ? "," : "");
+        trace_jsonstring(f, ev.name.c_str());
+        fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}", ev.cat, (ev.start - base) / 1e3, ev.dur / 1e3);
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+static void trace_finish() {
+    if (!trace_enabled || trace_events.empty()) return;
+    while (!trace_stack.empty()) /* spans left open by os.exit */
+        trace_end(trace_stack.back());
+    if (trace_output.empty()) {
+        trace_report(stderr);
+        return;
+    }
+#if defined(_WIN32)
+    FILE *f = _wfopen(fs::u8path(trace_output).c_str(), L"wb");
+#else
+    FILE *f = fopen(trace_output.c_str(), "wb");
+#endif
+    if (f == NULL) {
+        l_message(progname, (std::string("cannot write startup trace ") + trace_output + ": " + strerror(errno)).c_str());
+        return;
+    }
+    trace_json(f);
+    fclose(f);
+}
+
+
+/*
+** Reads the configuration and removes '--trace-startup' from the options,
+** so that the script never sees it.
+*/
+static void trace_init(int &argc, char **argv) {
+    atexit(trace_finish); /* also covers os.exit */
+    const char *env = getenv("BEE_STARTUP_TRACE");
+    if (env && env[0] && strcmp(env, "0") != 0) trace_setoutput(env);
+    for (int i = 1; i < argc && argv[i][0] == '-'; i++) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "--trace-startup") == 0)
+            trace_setoutput("1");
+        else if (strncmp(opt, "--trace-startup=", 16) == 0)
+            trace_setoutput(opt + 16);
+        else
+            continue;
+        for (int j = i; j < argc; j++) argv[j] = argv[j + 1];
+        argc--;
+        break;
+    }
+}
+
+/*
+** Ends a span when its slot is closed. require, searchers and loaders run
+** under lua_call with the span in a to-be-closed slot, so an error still
+** ends the span but keeps the traceback of the place that raised it.
+*/
+static int trace_closespan(lua_State *L) {
+    int *idx = (int *)lua_touserdata(L, 1);
+    if (*idx >= 0) {
+        trace_end(*idx);
+        *idx = -1;
+    }
+    return 0;
+}
+
+static void trace_insertspan(lua_State *L, int pos, int idx) {
+    int *ud = (int *)lua_newuserdatauv(L, sizeof(int), 0);
+    *ud     = idx;
+    if (luaL_newmetatable(L, "bee::trace_span")) {
+        lua_pushcfunction(L, trace_closespan);
+        lua_setfield(L, -2, "__close");
+    }
+    lua_setmetatable(L, -2);
+    lua_insert(L, pos);
+    lua_toclose(L, pos);
+}
+
+static int trace_loader(lua_State *L) {
+    size_t sz;
+    const char *name = lua_tolstring(L, lua_upvalueindex(2), &sz);
+    trace_insertspan(L, 1, trace_begin(std::string("execute ").append(name, sz), "execute"));
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 2);
+    lua_call(L, lua_gettop(L) - 2, LUA_MULTRET);
+    lua_closeslot(L, 1);
+    return lua_gettop(L) - 1;
+}
+
+static void trace_wraploader(lua_State *L, int loader, int name) {
+    lua_pushvalue(L, loader);
+    lua_pushvalue(L, name);
+    lua_pushcclosure(L, trace_loader, 2);
+    lua_replace(L, loader);
+}
+
+static int trace_searcher(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    lua_settop(L, 1);
+    trace_insertspan(L, 2, trace_begin(std::string("search ") + name, "search"));
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_pushvalue(L, 1);
+    lua_call(L, 1, LUA_MULTRET);
+    lua_closeslot(L, 2);
+    if (lua_isfunction(L, 3)) trace_wraploader(L, 3, 1);
+    return lua_gettop(L) - 2;
+}
+
+static bool trace_readfile(const char *filename, std::string &content) {
+#if defined(_WIN32)
+    FILE *f = _wfopen(fs::u8path(filename).c_str(), L"rb");
+#else
+    FILE *f = fopen(filename, "rb");
+#endif
+    if (f == NULL) return false;
+    char buff[BUFSIZ];
+    size_t n;
+    while ((n = fread(buff, 1, sizeof(buff), f)) > 0) content.append(buff, n);
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+/*
+** Replacement for the Lua file searcher that splits the load into lookup,
+** read and parse. Mirrors 'searcher_Lua' and 'luaL_loadfilex': a UTF-8 BOM
+** and a first line starting with '#' are skipped.
+*/
+static int trace_luasearcher(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    lua_settop(L, 1);
+    int idx = trace_begin(std::string("lookup ") + name, "lookup");
+    lua_getfield(L, lua_upvalueindex(1), "searchpath");
+    lua_pushvalue(L, 1);
+    if (lua_getfield(L, lua_upvalueindex(1), "path") != LUA_TSTRING) {
+        trace_end(idx);
+        return luaL_error(L, "'package.path' must be a string");
+    }
+    lua_call(L, 2, 2);
+    trace_end(idx);
+    if (lua_isnil(L, 2)) return 1; /* error message */
+    lua_pop(L, 1);
+    const char *filename = lua_tostring(L, 2);
+    int status;
+    {
+        std::string content;
+        idx     = trace_begin(std::string("read ") + name, "read");
+        bool ok = trace_readfile(filename, content);
+        trace_end(idx);
+        if (ok) {
+            std::string_view chunk = content;
+            if (chunk.substr(0, 3) == "\xEF\xBB\xBF") chunk.remove_prefix(3);
+            if (!chunk.empty() && chunk[0] == '#') {
+                size_t eol = chunk.find('\n');
+                chunk.remove_prefix(eol == std::string_view::npos ? chunk.size() : eol);
+            }
+            lua_pushfstring(L, "@%s", filename);
+            idx    = trace_begin(std::string("parse ") + name, "parse");
+            status = luaL_loadbufferx(L, chunk.data(), chunk.size(), lua_tostring(L, -1), NULL);
+            trace_end(idx);
+            lua_remove(L, -2);
+        }
+        else {
+            lua_pushfstring(L, "cannot read %s: %s", filename, strerror(errno));
+            status = LUA_ERRFILE;
+        }
+    }
+    if (status != LUA_OK)
+        return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s", name, filename, lua_tostring(L, -1));
+    trace_wraploader(L, 3, 1);
+    lua_pushvalue(L, 2);
+    return 2;
+}
+
+static int trace_require(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    bool loaded = lua_getfield(L, -1, name) != LUA_TNIL && lua_toboolean(L, -1);
+    lua_pop(L, 2);
+    trace_insertspan(L, 1, loaded ? -1 : trace_begin(std::string("require ") + name, "require"));
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 2);
+    lua_call(L, lua_gettop(L) - 2, LUA_MULTRET);
+    lua_closeslot(L, 1);
+    return lua_gettop(L) - 1;
+}
+
+static void trace_install(lua_State *L) {
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchers");
+    lua_Integer n = luaL_len(L, -1);
+    for (lua_Integer i = 1; i <= n; i++) {
+        if (i == 2) {
+            lua_pushvalue(L, -2);
+            lua_pushcclosure(L, trace_luasearcher, 1);
+        }
+        else {
+            lua_geti(L, -1, i);
+            lua_pushcclosure(L, trace_searcher, 1);
+        }
+        lua_seti(L, -2, i);
+    }
+    lua_pop(L, 2);
+    lua_getglobal(L, "require");
+    lua_pushcclosure(L, trace_require, 1);
+    lua_setglobal(L, "require");
+}
+
 static void createargtable(lua_State *L, char **argv, int argc) {
     int i;
     lua_createtable(L, argc - 1, 2);
@@ -215,10 +524,14 @@ static int loadfile(lua_State *L, const fs::path &filename, const char *chunknam
 
 static int handle_script(lua_State *L) {
     auto progdir = pushprogdir(L);
+    int idx      = trace_begin("load main.lua", "bootstrap");
     int status   = loadfile(L, progdir / "main.lua", "=(bootstrap.lua)");
+    trace_end(idx);
     if (status == LUA_OK) {
         int n  = pushargs(L); /* push arguments to script */
+        idx    = trace_begin("run main.lua", "bootstrap");
         status = docall(L, n, LUA_MULTRET);
+        trace_end(idx);
     }
     return report(L, status);
 }
@@ -234,9 +547,19 @@ static int pmain(lua_State *L) {
     if (argv[0] && argv[0][0]) progname = argv[0];
     lua_pushboolean(L, 1); /* signal for libraries to ignore env. vars. */
     lua_setfield(L, LUA_REGISTRYINDEX, "LUA_NOENV");
-    luaL_openlibs(L); /* open standard libraries */
-    ::bee::lua::preload_module(L);
-    init_cpath(L);
+    {
+        TraceScope scope("luaL_openlibs", "bootstrap");
+        luaL_openlibs(L); /* open standard libraries */
+    }
+    {
+        TraceScope scope("preload_module", "bootstrap");
+        ::bee::lua::preload_module(L);
+    }
+    {
+        TraceScope scope("init_cpath", "bootstrap");
+        init_cpath(L);
+    }
+    if (trace_enabled) trace_install(L);
     createargtable(L, argv, argc); /* create table 'arg' */
     lua_gc(L, LUA_GCGEN, 0, 0);    /* GC in generational mode */
     if (handle_script(L) != LUA_OK)
@@ -251,7 +574,10 @@ int umain(int argc, char **argv) {
 int main(int argc, char **argv) {
 #endif
     int status, result;
+    trace_init(argc, argv);
+    int idx      = trace_begin("luaL_newstate", "bootstrap");
     lua_State *L = luaL_newstate(); /* create state */
+    trace_end(idx);
     if (L == NULL) {
         l_message(argv[0], "cannot create state: not enough memory");
         return EXIT_FAILURE;
@@ -259,10 +585,14 @@ int main(int argc, char **argv) {
     lua_pushcfunction(L, &pmain);   /* to call 'pmain' in protected mode */
     lua_pushinteger(L, argc);       /* 1st argument */
     lua_pushlightuserdata(L, argv); /* 2nd argument */
+    idx    = trace_begin("pmain", "bootstrap");
     status = lua_pcall(L, 2, 1, 0); /* do the call */
-    result = lua_toboolean(L, -1);  /* get result */
+    trace_end(idx);
+    result = lua_toboolean(L, -1); /* get result */
     report(L, status);
+    idx = trace_begin("lua_close", "bootstrap");
     lua_close(L);
+    trace_end(idx);
     return (result && status == LUA_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -198,7 +198,10 @@ lm:source_set "source_lua" {
         "3rd/lua/onelua.c",
         "3rd/lua/linit.c",
     },
-    defines = "MAKE_LIB",
+    defines = {
+        "MAKE_LIB",
+        lm.fasthash and "LUAI_FASTHASH",
+    },
     windows = {
         defines = "LUA_BUILD_AS_DLL",
     },
@@ -20,6 +20,7 @@ lm:lua_src "source_bee" {
     includes = ".",
     sources = {
         "bee/platform/version.cpp",
+        "bee/thread/adaptive_mutex.cpp",
         "bee/thread/simplethread_posix.cpp",
         "bee/thread/setname.cpp",
         "bee/thread/spinlock.cpp",
@@ -33,6 +34,8 @@ lm:lua_src "source_bee" {
     sources = {
         "binding/lua_platform.cpp",
         "binding/lua_serialization.cpp",
+        "binding/lua_stats.cpp",
+        "binding/lua_struct.cpp",
         "binding/lua_filesystem.cpp",
         "binding/lua_thread.cpp",
         "binding/lua_time.cpp",
@@ -23,6 +23,7 @@ if lm.os == "windows" then
         defines = {
             "MAKE_LIB",
             "LUA_BUILD_AS_DLL",
+            lm.fasthash and "LUAI_FASTHASH",
         },
         msvc = {
             flags = "/wd4334",
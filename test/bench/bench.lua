@@ -0,0 +1,49 @@
+local time = require "bee.time"
+
+local m = {}
+
+-- Milliseconds from a high resolution monotonic clock.
+m.clock = time.counter
+
+-- Returns the best wall time of `rounds` calls to f(...), in milliseconds.
+function m.best(rounds, f, ...)
+    local best = math.huge
+    for _ = 1, rounds do
+        collectgarbage "collect"
+        local t = m.clock()
+        f(...)
+        local dt = m.clock() - t
+        if dt < best then
+            best = dt
+        end
+    end
+    return best
+end
+
+-- Sorts samples in place and returns the requested percentiles (0-100).
+function m.percentiles(samples, ...)
+    table.sort(samples)
+    local n = #samples
+    local r = {}
+    for i, p in ipairs { ... } do
+        r[i] = samples[math.max(1, math.min(n, math.ceil(n * p / 100)))]
+    end
+    return table.unpack(r)
+end
+
+function m.printf(fmt, ...)
+    io.write(fmt:format(...), "\n")
+end
+
+-- Integer command line option `--name=value`, or def.
+function m.option(name, def)
+    for _, a in ipairs(arg) do
+        local v = a:match("^%-%-"..name.."=(.+)$")
+        if v then
+            return math.tointeger(tonumber(v)) or v
+        end
+    end
+    return def
+end
+
+return m
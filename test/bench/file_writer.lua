@@ -0,0 +1,52 @@
+-- Steady large-file write throughput: io.open against fs.open_writer.
+--
+--   bootstrap test/bench/file_writer.lua [--size=MB] [--chunk=KB] [--path=FILE]
+--
+-- Writes `size` megabytes in `chunk` kilobyte pieces. MB/s includes the
+-- final close, the latency columns are per write call. Put --path on the
+-- disk under test; direct writes fall back to cached ones on file systems
+-- that refuse them, which the mode column shows.
+
+package.path = arg[0]:match "(.+)[/\\][%w_.-]+$" .. "/?.lua"
+
+local bench = require "bench"
+local fs = require "bee.filesystem"
+
+local SIZE = bench.option("size", 256) << 20
+local CHUNK = bench.option("chunk", 64) << 10
+local PATH = bench.option("path", "bench_file_writer.bin")
+
+local chunk = ("0123456789abcdef"):rep(CHUNK // 16)
+
+local function run(name, open)
+    fs.remove(PATH)
+    collectgarbage "collect"
+    local lat = {}
+    local t = bench.clock()
+    local f, mode = open()
+    for i = 1, SIZE // CHUNK do
+        local w = bench.clock()
+        f:write(chunk)
+        lat[i] = (bench.clock() - w) * 1000
+    end
+    f:close()
+    local ms = bench.clock() - t
+    local p50, p99, max = bench.percentiles(lat, 50, 99, 100)
+    bench.printf("%-14s %-7s %10.1f %10.1f %10.1f %10.1f", name, mode, SIZE / ms / 1000 / 1.048576, p50, p99, max)
+end
+
+bench.printf("%-14s %-7s %10s %10s %10s %10s", "writer", "mode", "MB/s", "p50 us", "p99 us", "max us")
+run("io.open", function ()
+    return assert(io.open(PATH, "wb")), "cached"
+end)
+run("open_writer", function ()
+    return assert(fs.open_writer(PATH)), "cached"
+end)
+run("+preallocate", function ()
+    return assert(fs.open_writer(PATH, { preallocate = SIZE })), "cached"
+end)
+run("+direct", function ()
+    local w = assert(fs.open_writer(PATH, { preallocate = SIZE, direct = true }))
+    return w, w:direct() and "direct" or "cached"
+end)
+fs.remove(PATH)
@@ -0,0 +1,65 @@
+-- Wakeup latency of select:wait with and without busy polling.
+--
+--   bootstrap test/bench/select_latency.lua [--samples=N] [--busy=US]
+--
+-- A sender thread writes a timestamp into a socket pair every millisecond
+-- and the main thread measures how long after the send its wait returned.
+-- Busy polling needs a spare core for the waiting thread; on a single core
+-- machine it only delays the sender.
+
+package.path = arg[0]:match "(.+)[/\\][%w_.-]+$" .. "/?.lua"
+
+local bench = require "bench"
+local thread = require "bee.thread"
+local socket = require "bee.socket"
+local select = require "bee.select"
+
+local N = bench.option("samples", 2000)
+local BUSY = bench.option("busy", 50)
+
+local function run(backend, busy)
+    local ok, s = pcall(select.create, backend)
+    if not ok then
+        return
+    end
+    local a, b = assert(socket.pair())
+    local sender = thread.thread([[
+        local n, fd = ...
+        local thread = require "bee.thread"
+        local time = require "bee.time"
+        local b = require "bee.socket".fd(fd)
+        for _ = 1, n do
+            thread.sleep(0.001)
+            b:send(string.pack("d", time.counter()))
+        end
+        b:close()
+    ]], N, b:detach())
+    s:event_add(a, select.SELECT_READ)
+    s:busy_poll(busy)
+    local samples = {}
+    local res = {}
+    while #samples < N do
+        if s:wait_into(res, 1) > 0 then
+            local now = bench.clock()
+            local data = a:recv()
+            if not data then
+                break
+            end
+            for i = 1, #data - 7, 8 do
+                samples[#samples + 1] = (now - string.unpack("d", data, i)) * 1000
+            end
+        end
+    end
+    s:event_del(a)
+    s:close()
+    a:close()
+    thread.wait(sender)
+    local p50, p90, p99, max = bench.percentiles(samples, 50, 90, 99, 100)
+    bench.printf("%10s %8d %10.1f %10.1f %10.1f %10.1f", backend, busy, p50, p90, p99, max)
+end
+
+bench.printf("%10s %8s %10s %10s %10s %10s", "backend", "busy us", "p50 us", "p90 us", "p99 us", "max us")
+for _, backend in ipairs { "select", "epoll", "io_uring" } do
+    run(backend, 0)
+    run(backend, BUSY)
+end
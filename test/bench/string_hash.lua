@@ -0,0 +1,94 @@
+-- Short string interning: seri unpack and socket recv throughput.
+--
+--   bootstrap test/bench/string_hash.lua [--records=N] [--strings=N]
+--
+-- Every string made here is short, so each one is hashed and interned.
+-- Compare a build made with `luamake --fasthash` against a default build.
+
+package.path = arg[0]:match "(.+)[/\\][%w_.-]+$" .. "/?.lua"
+
+local bench = require "bench"
+local seri = require "bee.serialization"
+local socket = require "bee.socket"
+
+local RECORDS = bench.option("records", 2000)
+local STRINGS = bench.option("strings", 1000000)
+local ROUNDS = 5
+
+local function report(name, n, ms)
+    bench.printf("%-14s %10d %10.1f %12.2f", name, n, ms, n / ms / 1000)
+end
+
+local function unpack_records()
+    local t = {}
+    for i = 1, RECORDS do
+        t[i] = {
+            name = "user"..i,
+            mail = "user"..i.."@example.com",
+            city = "city"..(i % 97),
+            tags = { "t"..i, "g"..(i % 13), "k"..(i * 7) },
+        }
+    end
+    local data = seri.packstring(t)
+    local passes = 200
+    local ms = bench.best(ROUNDS, function ()
+        for _ = 1, passes do
+            seri.unpack(data)
+        end
+    end)
+    -- four keys and six values per record
+    report("seri.unpack", passes * RECORDS * 10, ms)
+end
+
+local function recv_strings()
+    local SIZE = 16
+    local CHUNK = 4096
+    local a, b = assert(socket.pair())
+    local lines = {}
+    for i = 1, CHUNK do
+        lines[i] = ("%015d\n"):format(i)
+    end
+    local chunk = table.concat(lines)
+    local batches = STRINGS // CHUNK
+    local total = 0
+    for _ = 1, ROUNDS do
+        collectgarbage "collect"
+        local ms = 0
+        for _ = 1, batches do
+            local off = 1
+            while off <= #chunk do
+                local n = assert(b:send(chunk:sub(off)))
+                off = off + n
+                local t = bench.clock()
+                for _ = 1, n // SIZE do
+                    assert(a:recv(SIZE))
+                end
+                ms = ms + bench.clock() - t
+            end
+        end
+        if total == 0 or ms < total then
+            total = ms
+        end
+    end
+    a:close()
+    b:close()
+    report("socket.recv", batches * CHUNK, total)
+end
+
+local function gmatch_strings()
+    local lines = {}
+    for i = 1, STRINGS do
+        lines[i] = ("%x"):format(i * 2654435761 % 4294967296)
+    end
+    local text = table.concat(lines, " ")
+    local ms = bench.best(ROUNDS, function ()
+        for _ in text:gmatch "%S+" do
+        end
+    end)
+    report("string.gmatch", STRINGS, ms)
+end
+
+bench.printf("%-14s %10s %10s %12s", "source", "strings", "ms", "M strings/s")
+unpack_records()
+recv_strings()
+gmatch_strings()
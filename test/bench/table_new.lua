@@ -0,0 +1,54 @@
+-- Array building with table.new and buffer reuse with table.clear.
+--
+--   bootstrap test/bench/table_new.lua [--size=N] [--rounds=N]
+--
+-- Each case fills `rounds` tables of `size` array items and `size / 4`
+-- string keys. The "new" cases allocate a table per round, the "clear"
+-- case refills one table that is cleared between rounds.
+
+package.path = arg[0]:match "(.+)[/\\][%w_.-]+$" .. "/?.lua"
+
+local bench = require "bench"
+
+local SIZE = bench.option("size", 10000)
+local ROUNDS = bench.option("rounds", 200)
+
+local keys = {}
+for i = 1, SIZE // 4 do
+    keys[i] = "k"..i
+end
+
+local function fill(t)
+    for i = 1, SIZE do
+        t[i] = i
+    end
+    for i = 1, #keys do
+        t[keys[i]] = i
+    end
+end
+
+local cases = {
+    { "{}", function ()
+        for _ = 1, ROUNDS do
+            fill {}
+        end
+    end },
+    { "table.new", function ()
+        for _ = 1, ROUNDS do
+            fill(table.new(SIZE, #keys))
+        end
+    end },
+    { "table.clear", function ()
+        local t = {}
+        for _ = 1, ROUNDS do
+            table.clear(t)
+            fill(t)
+        end
+    end },
+}
+
+bench.printf("%-12s %10s %12s", "case", "ms", "M items/s")
+for _, c in ipairs(cases) do
+    local ms = bench.best(5, c[2])
+    bench.printf("%-12s %10.1f %12.2f", c[1], ms, ROUNDS * (SIZE + #keys) / ms / 1000)
+end
@@ -76,14 +76,17 @@ if supported "subprocess" then
         return ("package.cpath = [[%s]]"):format(table.concat(cpaths, ";"))
     end)()
 
-    function shell:runlua(script, option)
-        option = option or {}
-        local filename = option[1]
-        option[1] = {
+    function shell:luacommand(script, filename)
+        return {
             luaexe,
             "-e", initscript.."\n"..script.."\nos.exit(true)",
             filename
         }
+    end
+
+    function shell:runlua(script, option)
+        option = option or {}
+        option[1] = shell:luacommand(script, option[1])
         local process, errmsg = subprocess.spawn(option)
         lt.assertIsUserdata(process, errmsg)
         return process
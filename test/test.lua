@@ -31,13 +31,18 @@ if not lt.options.list then
 end
 
 --require 'test_lua'
+require "test_table"
 require "test_serialization"
+require "test_struct"
 require "test_filesystem"
 require "test_thread"
 if platform.os ~= "emscripten" then
     require "test_subprocess"
     require "test_socket"
     require "test_filewatch"
+    require "test_log"
+    require "test_http"
+    require "test_stats"
 end
 require "test_time"
 
@@ -937,3 +937,153 @@ function test_fs:test_file_size()
     lt.assertEquals(fs.file_size "temp1.txt", 10)
     fs.remove_all "temp1.txt"
 end
+
+function test_fs:test_cache()
+    local root = fs.absolute(fs.path "temp_cache"):lexically_normal()
+    pcall(fs.remove_all, root)
+    fs.create_directories(root / "dir")
+    local file = root / "dir" / "a.txt"
+    create_file(file, "hello")
+    local cache <close> = assert(fs.cache(root))
+    lt.assertEquals(cache:exists(file), true)
+    lt.assertEquals(cache:exists(file), true)
+    lt.assertEquals(cache:is_regular_file(file), true)
+    lt.assertEquals(cache:file_size(file), 5)
+    lt.assertEquals(cache:file_size(file), 5)
+    lt.assertEquals(cache:last_write_time(file), fs.last_write_time(file))
+    lt.assertEquals(cache:status(file):type(), "regular")
+    local stats = cache:stats()
+    lt.assertEquals(stats.misses, 1)
+    lt.assertEquals(stats.hits, 6)
+
+    lt.assertEquals(cache:exists(root / "b.txt"), false)
+    create_file(root / "b.txt", "")
+    lt.assertEquals(cache:sync(), true)
+    lt.assertEquals(cache:exists(root / "b.txt"), true)
+
+    create_file(file, "hello world")
+    lt.assertEquals(cache:sync(), true)
+    lt.assertEquals(cache:file_size(file), 11)
+
+    fs.rename(root / "dir", root / "dir2")
+    lt.assertEquals(cache:sync(), true)
+    lt.assertEquals(cache:exists(file), false)
+    lt.assertEquals(cache:exists(root / "dir2" / "a.txt"), true)
+
+    lt.assertEquals(cache:exists(fs.current_path()), true)
+    lt.assertEquals(cache:stats().uncached, 1)
+    lt.assertEquals(cache:stats().invalidations > 0, true)
+    cache:close()
+    local stats = cache:stats()
+    create_file(root / "c.txt", "")
+    lt.assertEquals(cache:exists(root / "c.txt"), true)
+    lt.assertEquals(cache:stats().misses, stats.misses)
+    lt.assertEquals(cache:stats().hits, stats.hits)
+    lt.assertEquals(cache:sync(), false)
+    fs.remove_all(root)
+end
+
+function test_fs:test_cache_alias()
+    if not fs.create_directory_symlink then
+        return
+    end
+    local root = fs.absolute(fs.path "temp_cache"):lexically_normal()
+    local link = fs.absolute(fs.path "temp_cache_link"):lexically_normal()
+    pcall(fs.remove_all, root)
+    pcall(fs.remove, link)
+    fs.create_directories(root)
+    create_file(root / "a.txt", "hello")
+    if not pcall(fs.create_directory_symlink, root, link) then
+        fs.remove_all(root)
+        return
+    end
+    local cache <close> = assert(fs.cache(link))
+    lt.assertEquals(cache:file_size(link / "a.txt"), 5)
+    lt.assertEquals(cache:file_size(root / "a.txt"), 5)
+    lt.assertEquals(cache:stats().misses, 1)
+    lt.assertEquals(cache:stats().hits, 1)
+    create_file(root / "a.txt", "hello world")
+    lt.assertEquals(cache:sync(), true)
+    lt.assertEquals(cache:file_size(link / "a.txt"), 11)
+    cache:close()
+    fs.remove(link)
+    fs.remove_all(root)
+end
+
+function test_fs:test_cas()
+    local root = fs.absolute(fs.path "temp_cas"):lexically_normal()
+    pcall(fs.remove_all, root)
+    fs.create_directories(root)
+    local store <close> = fs.cas(root / "store")
+    create_file(root / "a.txt", "hello")
+    create_file(root / "b.txt", "hello")
+    create_file(root / "c.txt", ("x"):rep(100000))
+    local a = store:put(root / "a.txt")
+    lt.assertEquals(a, "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824")
+    lt.assertEquals(store:put(root / "b.txt"), a)
+    lt.assertEquals(store:has(a), true)
+    lt.assertEquals(fs.exists(store:blob(a)), true)
+
+    local keys, errs = store:put_many { root / "a.txt", root / "c.txt", root / "missing.txt" }
+    lt.assertEquals(keys[1], a)
+    lt.assertEquals(keys[2], "d69e68988157833272305aaf21f453c800346e8a3640db6578e260215542e5d4")
+    lt.assertEquals(keys[3], false)
+    lt.assertIsString(errs[3])
+    for _ in fs.pairs(root / "store" / "tmp") do
+        lt.assertEquals(true, false)
+    end
+
+    local method = store:get(a, root / "out.txt")
+    lt.assertEquals(method == "reflink" or method == "hardlink" or method == "copy", true)
+    lt.assertEquals(read_file(root / "out.txt"), "hello")
+    lt.assertEquals(store:get(a, root / "out2.txt", false) ~= "hardlink", true)
+    lt.assertEquals(read_file(root / "out2.txt"), "hello")
+    lt.assertEquals(store:get(a, root / "out.txt") == method, true)
+    lt.assertEquals(store:get(a, root / "out2.txt", false) ~= "hardlink", true)
+    lt.assertEquals(fs.permissions(store:blob(a)) & USER_WRITE, 0)
+    lt.assertEquals(fs.permissions(root / "out2.txt") & USER_WRITE, USER_WRITE)
+    lt.assertError(store.get, store, ("0123456789abcdef"):rep(4), root / "out3.txt")
+    lt.assertError(store.get, store, "0123456789abcdef0123456789abcdef", root / "out3.txt")
+
+    local removed, freed, remaining = store:gc(100000)
+    lt.assertEquals(removed, 1)
+    lt.assertEquals(freed, 100000)
+    lt.assertEquals(remaining, 5)
+    lt.assertEquals(store:has(a), true)
+    lt.assertEquals(store:has(keys[2]), false)
+    lt.assertEquals(select(3, store:gc(0)), 0)
+    store:close()
+    fs.remove_all(root)
+end
+
+function test_fs:test_writer()
+    for _, direct in ipairs { false, true } do
+        local filename = "temp_writer.bin"
+        fs.remove(filename)
+        local chunk = ("0123456789abcdef"):rep(1000)
+        local w <close> = fs.open_writer(filename, {
+            preallocate = 1 << 20,
+            direct = direct,
+            buffers = 3,
+            block_size = 8192,
+            sync_bytes = 65536,
+        })
+        if not direct then
+            lt.assertEquals(w:direct(), false)
+        end
+        for _ = 1, 20 do
+            w:write(chunk)
+        end
+        w:write "tail!"
+        lt.assertEquals(w:size(), #chunk * 20 + 5)
+        w:close()
+        w:close()
+        lt.assertError(w.write, w, "x")
+        lt.assertEquals(fs.file_size(filename), #chunk * 20 + 5)
+        local content = read_file(filename)
+        lt.assertEquals(content, chunk:rep(20) .. "tail!")
+        fs.remove(filename)
+    end
+    lt.assertError(fs.open_writer, "temp_writer.bin", { buffers = -1 })
+    lt.assertError(fs.open_writer, "temp_writer_dir/missing/file.bin")
+end
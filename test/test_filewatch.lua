@@ -93,3 +93,123 @@ function test_fw:test_symlink()
     fw:add(root:string())
     pcall(fs.remove_all, root)
 end
+
+function test_fw:test_thread()
+    local root = fs.absolute("./temp/"):lexically_normal()
+    pcall(fs.remove_all, root)
+    fs.create_directories(root)
+    local fw <close> = filewatch.create { thread = true, channel = "fsevents", ignore = { "ignored" } }
+    fw:set_recursive(true)
+    fw:add(root:string())
+    create_file(root / "ignored.txt")
+    create_file(root / "test1.txt", "1")
+    local ch = thread.channel "fsevents"
+    local list = {}
+    for _ = 1, 200 do
+        local ok, batch = ch:pop(0.01)
+        if ok then
+            for _, ev in ipairs(batch) do
+                lt.assertIsString(ev[1])
+                list[fs.path(ev[2]):string()] = true
+            end
+        end
+        if list[(root / "test1.txt"):string()] then
+            break
+        end
+    end
+    lt.assertEquals(list[(root / "test1.txt"):string()], true)
+    lt.assertEquals(list[(root / "ignored.txt"):string()], nil)
+    fw:close()
+    pcall(fs.remove_all, root)
+end
+
+function test_fw:test_thread_content_filter()
+    local root = fs.absolute("./temp/"):lexically_normal()
+    pcall(fs.remove_all, root)
+    fs.create_directories(root)
+    local fw <close> = filewatch.create { thread = true, channel = "fsevents_content", content_filter = true, interval = 60 }
+    fw:set_recursive(true)
+    fw:add(root:string())
+    create_file(root / "test1.txt", "1")
+    local ch = thread.channel "fsevents_content"
+    local found
+    for _ = 1, 200 do
+        local ok, batch = ch:pop(0.01)
+        if ok then
+            for _, ev in ipairs(batch) do
+                if fs.path(ev[2]):string() == (root / "test1.txt"):string() then
+                    found = true
+                end
+            end
+        end
+        if found then
+            break
+        end
+    end
+    lt.assertEquals(found, true)
+    fw:close()
+    pcall(fs.remove_all, root)
+end
+
+function test_fw:test_thread_interval()
+    for _, interval in ipairs { 0, -1, 0 / 0, 1e10 } do
+        lt.assertError(filewatch.create, { thread = true, channel = "fsevents_interval", interval = interval })
+    end
+end
+
+function test_fw:test_content_filter()
+    local root = fs.absolute("./temp/"):lexically_normal()
+    pcall(fs.remove_all, root)
+    fs.create_directories(root)
+    local fw <close> = filewatch.create()
+    fw:set_recursive(true)
+    lt.assertEquals(fw:set_content_filter(true), true)
+    fw:add(root:string())
+    local file = root / "test.txt"
+    local function write(content)
+        local f <close> = assert(io.open(file:string(), "wb"))
+        f:write(content)
+    end
+    local function modified()
+        local found = false
+        local n = 50
+        while n > 0 do
+            local w, v = fw:select()
+            if w then
+                n = 50
+                if w == "modify" and fs.path(v) == file then
+                    found = true
+                end
+            else
+                n = n - 1
+                thread.sleep(0.002)
+            end
+        end
+        return found
+    end
+    write "hello"
+    lt.assertEquals(modified(), true)
+    write "hello"
+    lt.assertEquals(modified(), false)
+    write "hello world"
+    lt.assertEquals(modified(), true)
+    write "HELLO WORLD"
+    lt.assertEquals(modified(), true)
+    local hashed, suppressed = fw:content_stats()
+    lt.assertEquals(hashed >= 3, true)
+    lt.assertEquals(suppressed > 0, true)
+    -- events already queued in the filter survive turning it off
+    write "hello again"
+    thread.sleep(0.05)
+    local w, v = fw:select()
+    local found = w == "modify" and fs.path(v) == file
+    lt.assertEquals(fw:set_content_filter(false), true)
+    lt.assertEquals(modified() or found, true)
+    write "hello again"
+    lt.assertEquals(modified(), true)
+    lt.assertEquals(fw:content_stats(), 0)
+    lt.assertEquals(fw:set_content_filter(true), true)
+    write "hello again"
+    lt.assertEquals(modified(), true)
+    pcall(fs.remove_all, root)
+end
@@ -0,0 +1,128 @@
+local lt = require "ltest"
+local http = require "bee.http"
+
+local test_http = lt.test "http"
+
+local function feed_all(p, data)
+    p:feed(data)
+    local res = {}
+    while true do
+        local req, err = p:next()
+        if req == nil then
+            return nil, err
+        elseif req == false then
+            return res
+        end
+        res[#res+1] = req
+    end
+end
+
+function test_http:test_request()
+    local p = http.parser()
+    local res = feed_all(p, "GET /index.html?a=1 HTTP/1.1\r\nHost: example.com\r\nX-Foo:  bar  \r\nX-Foo: baz\r\n\r\n")
+    lt.assertEquals(#res, 1)
+    local req = res[1]
+    lt.assertEquals(req.method, "GET")
+    lt.assertEquals(req.path, "/index.html?a=1")
+    lt.assertEquals(req.version, "1.1")
+    lt.assertEquals(req.headers, { host = "example.com", ["x-foo"] = "bar, baz" })
+    lt.assertEquals(req.body, "")
+    lt.assertEquals(req.keepalive, true)
+    lt.assertEquals(p:buffered(), 0)
+    lt.assertEquals(feed_all(http.parser(), "GET / HTTP/1.0\r\n\r\n")[1].version, "1.0")
+    lt.assertEquals(feed_all(http.parser(), "GET / HTTP/1.2\r\n\r\n")[1].version, "1.2")
+    local path = "/"..("x"):rep(100)
+    local value = ("\t v"):rep(30)
+    p:feed("GET "..path.." HTTP/1.1\r\nX-Long: "..value.."\r\n\r\n")
+    req = p:next()
+    lt.assertEquals(req.path, path)
+    lt.assertEquals(req.headers["x-long"], value:sub(3))
+end
+
+function test_http:test_incremental()
+    local p = http.parser()
+    local data = "POST /submit HTTP/1.1\r\nContent-Length: 11\r\n\r\nhello world"
+    for i = 1, #data - 1 do
+        p:feed(data:sub(i, i))
+        lt.assertEquals(p:next(), false)
+    end
+    p:feed(data:sub(-1))
+    local req = p:next()
+    lt.assertEquals(req.method, "POST")
+    lt.assertEquals(req.body, "hello world")
+    lt.assertEquals(p:next(), false)
+end
+
+function test_http:test_pipelining()
+    local p = http.parser()
+    local res = feed_all(p, table.concat {
+        "GET /a HTTP/1.1\r\n\r\n",
+        "POST /b HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc",
+        "GET /c HTTP/1.0\r\n\r\n",
+        "GET /d HTTP/1.1\r\n",
+    })
+    lt.assertEquals(#res, 3)
+    lt.assertEquals(res[1].path, "/a")
+    lt.assertEquals(res[2].body, "abc")
+    lt.assertEquals(res[3].path, "/c")
+    lt.assertEquals(res[3].keepalive, false)
+    p:feed "\r\n"
+    lt.assertEquals(p:next().path, "/d")
+end
+
+function test_http:test_keepalive()
+    local p = http.parser()
+    p:feed "GET / HTTP/1.1\r\nConnection: close\r\n\r\nGET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"
+    lt.assertEquals(p:next().keepalive, false)
+    lt.assertEquals(p:next().keepalive, true)
+end
+
+function test_http:test_chunked()
+    local p = http.parser()
+    local data = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\nGET /next HTTP/1.1\r\n\r\n"
+    for i = 1, #data, 7 do
+        p:feed(data:sub(i, i + 6))
+    end
+    local req = p:next()
+    lt.assertEquals(req.body, "hello world")
+    lt.assertEquals(p:next().path, "/next")
+end
+
+function test_http:test_error()
+    local function check(s, msg)
+        local res, err = feed_all(http.parser(), s)
+        lt.assertEquals(res, nil)
+        lt.assertEquals(err, msg)
+    end
+    check("GET  / HTTP/1.1\r\n\r\n", "invalid request target")
+    check("G(T / HTTP/1.1\r\n\r\n", "invalid method")
+    check("GET / HTTP/2.0\r\n\r\n", "invalid version")
+    check("GET / HTTP/1.1\r\nBad Name: x\r\n\r\n", "invalid header name")
+    check("GET / HTTP/1.1\r\n folded\r\n\r\n", "invalid header name")
+    check("GET / HTTP/1.1\r\nX: a\1b\r\n\r\n", "invalid header value")
+    check("GET / HTTP/1.1\r\nX: "..("a"):rep(40).."\127\r\n\r\n", "invalid header value")
+    check("GET /"..("a"):rep(40).."\0 HTTP/1.1\r\n\r\n", "invalid request target")
+    check("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", "invalid content-length")
+    check("POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n", "invalid content-length")
+    check("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", "unsupported transfer-encoding")
+    check("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 1\r\n\r\n", "both content-length and transfer-encoding")
+    check("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", "invalid chunk size")
+    lt.assertEquals(feed_all(http.parser { max_header_size = 16 }, "GET / HTTP/1.1\r\nHost: example.com\r\n"), nil)
+    lt.assertEquals(feed_all(http.parser { max_body_size = 2 }, "POST / HTTP/1.1\r\nContent-Length: 3\r\n\r\n"), nil)
+end
+
+function test_http:test_response()
+    lt.assertEquals(http.response(200, nil, "ok"), "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok")
+    lt.assertEquals(http.response(204), "HTTP/1.1 204 No Content\r\n\r\n")
+    lt.assertEquals(http.response(200, { ["Set-Cookie"] = { "a=1", "b=2" } }), "HTTP/1.1 200 OK\r\nSet-Cookie: a=1\r\nSet-Cookie: b=2\r\n\r\n")
+    lt.assertEquals(http.response(200, { ["Transfer-Encoding"] = "chunked" }, ""), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n")
+    lt.assertEquals(http.chunk "hello", "5\r\nhello\r\n")
+    lt.assertEquals(http.chunk(), "0\r\n\r\n")
+    lt.assertError(http.response, 200, { ["X-Bad"] = "a\r\nb" })
+    lt.assertError(http.response, 200, { ["Bad Name"] = "a" })
+    local p = http.parser()
+    p:feed((http.response(200, { ["Content-Type"] = "text/plain" }, "body"):gsub("^HTTP/1.1 200 OK", "GET / HTTP/1.1")))
+    local req = p:next()
+    lt.assertEquals(req.headers["content-type"], "text/plain")
+    lt.assertEquals(req.body, "body")
+end
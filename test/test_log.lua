@@ -0,0 +1,167 @@
+local lt = require "ltest"
+local log = require "bee.log"
+local fs = require "bee.filesystem"
+local thread = require "bee.thread"
+
+local test_log = lt.test "log"
+
+local function readfile(path)
+    local f <close> = assert(io.open(path, "rb"))
+    return f:read "a"
+end
+
+local function lines(path)
+    local r = {}
+    for l in readfile(path):gmatch "([^\n]*)\n" do
+        r[#r + 1] = l
+    end
+    return r
+end
+
+function test_log:test_write()
+    local path = "test_log_write.log"
+    fs.remove(path)
+    local sink = assert(log.open("test_write", { path = path, timestamp = false }))
+    lt.assertEquals(log.get "test_write" ~= nil, true)
+    lt.assertEquals(sink:write("int={} float={:.2f} str={:>3} bool={}", 42, 1.5, "ab", true), true)
+    lt.assertEquals(sink:write("{{literal}} {}", nil), true)
+    lt.assertEquals(sink:write("extra", 1, "two", false), true)
+    lt.assertError(sink.write, sink, "{}")
+    lt.assertError(sink.write, sink, "{:d}", "str")
+    lt.assertError(sink.write, sink, "}", 1)
+    sink:flush()
+    lt.assertEquals(lines(path), {
+        "int=42 float=1.50 str= ab bool=true",
+        "{literal} nil",
+        "extra 1 two false",
+    })
+    local s = sink:stats()
+    lt.assertEquals(s.lines, 3)
+    lt.assertEquals(s.dropped, 0)
+    lt.assertEquals(s.bytes, #readfile(path))
+    sink:close()
+    lt.assertEquals(sink:write "closed", false)
+    lt.assertEquals(#lines(path), 3)
+    lt.assertEquals(log.get "test_write", nil)
+    fs.remove(path)
+end
+
+function test_log:test_nested_write()
+    local path = "test_log_nested.log"
+    fs.remove(path)
+    local sink = assert(log.open("test_nested", { path = path, timestamp = false }))
+    local inner = setmetatable({}, { __tostring = function ()
+        sink:write("inner {}", ("x"):rep(1000))
+        return "obj"
+    end })
+    local broken = setmetatable({}, { __tostring = function ()
+        sink:write("unfinished")
+        error "broken"
+    end })
+    lt.assertEquals(sink:write("before {} after {}", inner, 7), true)
+    lt.assertError(sink.write, sink, "{}", broken)
+    lt.assertEquals(sink:write("last {}", inner), true)
+    sink:close()
+    lt.assertEquals(lines(path), {
+        "inner "..("x"):rep(1000),
+        "before obj after 7",
+        "unfinished",
+        "inner "..("x"):rep(1000),
+        "last obj",
+    })
+    fs.remove(path)
+end
+
+function test_log:test_reopen()
+    local path = "test_log_reopen.log"
+    fs.remove(path)
+    local sink = assert(log.open("test_reopen", { path = path, timestamp = false }))
+    lt.assertEquals(log.open("test_reopen", { path = path }), nil)
+    sink:write "first"
+    sink:close()
+    local sink2 = assert(log.open("test_reopen", { path = path, timestamp = false }))
+    lt.assertEquals(sink:write "dropped", false)
+    sink2:write "second"
+    sink2:close()
+    lt.assertEquals(lines(path), { "first", "second" })
+    fs.remove(path)
+end
+
+function test_log:test_flush_on_demand()
+    local path = "test_log_on_demand.log"
+    fs.remove(path)
+    local sink = assert(log.open("test_on_demand", { path = path, timestamp = false, flush_interval = 0 }))
+    for i = 1, 3 do
+        sink:write("line {}", i)
+        sink:flush()
+        lt.assertEquals(#lines(path), i)
+    end
+    sink:close()
+    lt.assertEquals(sink:stats().lines, 3)
+    fs.remove(path)
+end
+
+function test_log:test_timestamp()
+    local path = "test_log_timestamp.log"
+    fs.remove(path)
+    local sink = assert(log.open("test_timestamp", { path = path }))
+    sink:write "hello"
+    sink:close()
+    local l = lines(path)
+    lt.assertEquals(#l, 1)
+    lt.assertEquals(l[1]:match "^%d%d%d%d%-%d%d%-%d%d %d%d:%d%d:%d%d%.%d%d%d hello$" ~= nil, true)
+    fs.remove(path)
+end
+
+function test_log:test_rotate()
+    local path = "test_log_rotate.log"
+    fs.remove(path)
+    fs.remove(path..".1")
+    fs.remove(path..".2")
+    local sink = assert(log.open("test_rotate", { path = path, timestamp = false, rotate_bytes = 64, rotate_files = 2, fsync = "batch" }))
+    for i = 1, 10 do
+        sink:write("line {:02}", i)
+        sink:flush()
+    end
+    sink:close()
+    lt.assertEquals(sink:stats().rotations, 1)
+    lt.assertEquals(#readfile(path..".1"), 64)
+    lt.assertEquals(lines(path), { "line 09", "line 10" })
+    lt.assertEquals(fs.exists(path..".2"), false)
+    fs.remove(path)
+    fs.remove(path..".1")
+end
+
+function test_log:test_threads()
+    local path = "test_log_threads.log"
+    fs.remove(path)
+    local sink = assert(log.open("test_threads", { path = path, timestamp = false, fsync = 0.01 }))
+    local thds = {}
+    for i = 1, 4 do
+        thds[i] = thread.thread(([[
+            local log = require "bee.log"
+            local sink = log.get "test_threads"
+            for j = 1, 1000 do
+                sink:write("{} {}", %d, j)
+            end
+        ]]):format(i))
+    end
+    for i = 1, 4 do
+        thread.wait(thds[i])
+    end
+    sink:close()
+    local s = sink:stats()
+    lt.assertEquals(s.lines + s.dropped, 4000)
+    lt.assertEquals(s.dropped, 0)
+    local last = {}
+    for _, l in ipairs(lines(path)) do
+        local i, j = l:match "^(%d) (%d+)$"
+        i, j = tonumber(i), tonumber(j)
+        lt.assertEquals((last[i] or 0) + 1, j)
+        last[i] = j
+    end
+    for i = 1, 4 do
+        lt.assertEquals(last[i], 1000)
+    end
+    fs.remove(path)
+end
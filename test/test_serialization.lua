@@ -66,6 +66,29 @@ function test_seri:test_ref()
     end
 end
 
+function test_seri:test_ref_many()
+    local N <const> = 1000
+    local t = {}
+    for i = 1, N do
+        t[i] = { i }
+    end
+    for i = 1, N do
+        t[i].next = t[i % N + 1]
+    end
+    t.self = t
+    for _ = 1, 2 do
+        local newt = seri.unpack(seri.pack(t))
+        lt.assertEquals(rawequal(newt.self, newt), true)
+        for i = 1, N do
+            lt.assertEquals(newt[i][1], i)
+            lt.assertEquals(rawequal(newt[i].next, newt[i % N + 1]), true)
+        end
+    end
+    TestErr("Unsupport type thread to serialize", t, coroutine.create(function () end))
+    local newt = seri.unpack(seri.pack(t))
+    lt.assertEquals(rawequal(newt[N].next, newt[1]), true)
+end
+
 function test_seri:test_lightuserdata()
     lt.assertError(seri.lightuserdata, "")
     lt.assertError(seri.lightuserdata, 1.1)
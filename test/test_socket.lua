@@ -389,3 +389,290 @@ function test_socket:test_SIGPIPE()
     end
     client:close()
 end
+
+local function testRelay(opts)
+    local a1, a2 = assert(socket.pair())
+    local b1, b2 = assert(socket.pair())
+    local r <close> = assert(socket.relay(a2, b1, opts))
+    lt.assertEquals(tostring(a2), "socket (closed)")
+    syncEcho(a1, b2, "hello")
+    syncEcho(b2, a1, "world")
+    a1:shutdown "w"
+    lt.assertEquals(syncRecv(b2, 1), nil)
+    b2:close()
+    lt.assertEquals(syncRecv(a1, 1), nil)
+    a1:close()
+    while not r:update() do
+        simple_select(r:event(), "r")
+    end
+    lt.assertEquals({ r:status() }, { true, 5, 5 })
+end
+
+function test_socket:test_relay()
+    testRelay()
+    testRelay { splice = false, bufsize = 2 }
+    local tap = {}
+    testRelay {
+        tap = function (dir, data)
+            tap[#tap+1] = dir..":"..data
+        end
+    }
+    lt.assertEquals(table.concat(tap, ","), "a2b:hello,b2a:world")
+    local a1, a2 = assert(socket.pair())
+    lt.assertError(socket.relay, a2, a2)
+    lt.assertEquals(tostring(a2) ~= "socket (closed)", true)
+    a1:close()
+    a2:close()
+end
+
+function test_socket:test_select_backend()
+    local platform = require "bee.platform"
+    for _, backend in ipairs { "select", "epoll", "io_uring" } do
+        local s <close> = select.create(backend)
+        if platform.os == "linux" and backend == "epoll" then
+            lt.assertEquals(s:backend(), "epoll")
+        elseif platform.os ~= "linux" then
+            lt.assertEquals(s:backend(), "select")
+        end
+        local a, b = assert(socket.pair())
+        local function wait(timeout)
+            local res = {}
+            for fd, event in s:wait(timeout) do
+                res[#res+1] = { fd, event }
+            end
+            return res
+        end
+        s:event_add(a, select.SELECT_READ)
+        lt.assertEquals(wait(0), {})
+        lt.assertEquals(syncSend(b, "x"), true)
+        lt.assertEquals(wait(), { { a, select.SELECT_READ } })
+        lt.assertEquals(wait(), { { a, select.SELECT_READ } })
+        s:event_mod(a, select.SELECT_READ | select.SELECT_WRITE)
+        lt.assertEquals(wait(), { { a, select.SELECT_READ | select.SELECT_WRITE } })
+        lt.assertEquals(a:recv(), "x")
+        lt.assertEquals(wait(), { { a, select.SELECT_WRITE } })
+        s:event_mod(a, select.SELECT_READ)
+        lt.assertEquals(wait(0.01), {})
+        s:event_del(a)
+        s:event_add(a, select.SELECT_READ)
+        lt.assertEquals(syncSend(b, "y"), true)
+        lt.assertEquals(wait(), { { a, select.SELECT_READ } })
+        lt.assertEquals(a:recv(), "y")
+        lt.assertEquals(wait(0.01), {})
+        s:event_del(a)
+        a:close()
+        b:close()
+    end
+end
+
+function test_socket:test_select_wait_into()
+    for _, backend in ipairs { "select", "epoll" } do
+        local s <close> = select.create(backend)
+        local a, b = assert(socket.pair())
+        local c, d = assert(socket.pair())
+        local res = { "stale", "stale", "stale", "stale", "stale" }
+        s:event_add(a, select.SELECT_READ)
+        s:event_add(c, select.SELECT_READ, "c")
+        lt.assertEquals(s:wait_into(res, 0), 0)
+        lt.assertEquals(res[1], nil)
+        lt.assertEquals(syncSend(b, "x"), true)
+        lt.assertEquals(syncSend(d, "y"), true)
+        lt.assertEquals(s:wait_into(res), 2)
+        local got = {}
+        for i = 1, 4, 2 do
+            got[res[i]] = res[i + 1]
+        end
+        lt.assertEquals(got, { [a] = select.SELECT_READ, c = select.SELECT_READ })
+        lt.assertEquals(res[5], nil)
+        lt.assertEquals(a:recv(), "x")
+        lt.assertEquals(s:wait_into(res), 1)
+        lt.assertEquals(res[1], "c")
+        lt.assertEquals(res[2], select.SELECT_READ)
+        lt.assertEquals(res[3], nil)
+        s:event_del(a)
+        s:event_del(c)
+        lt.assertEquals(s:wait_into(res, 0), 0)
+        lt.assertError(s.wait_into, s, res)
+        a:close()
+        b:close()
+        c:close()
+        d:close()
+    end
+end
+
+function test_socket:test_select_busy_poll()
+    local time = require "bee.time"
+    for _, backend in ipairs { "select", "epoll" } do
+        local s <close> = select.create(backend)
+        local a, b = assert(socket.pair())
+        local res = {}
+        s:event_add(a, select.SELECT_READ)
+        s:busy_poll(2000)
+        local t = time.monotonic()
+        lt.assertEquals(s:wait_into(res, 0.02), 0)
+        lt.assertEquals(time.monotonic() - t >= 15, true)
+        lt.assertEquals(syncSend(b, "x"), true)
+        lt.assertEquals(s:wait_into(res), 1)
+        lt.assertEquals(res[1], a)
+        lt.assertEquals(a:recv(), "x")
+        s:busy_poll(0)
+        lt.assertEquals(s:wait_into(res, 0), 0)
+        s:event_del(a)
+        a:close()
+        b:close()
+    end
+end
+
+function test_socket:test_select_data_ops()
+    for _, backend in ipairs { "select", "epoll", "io_uring" } do
+        local s <close> = select.create(backend)
+        local server = lt.assertIsUserdata(socket "tcp")
+        lt.assertIsBoolean(server:bind("127.0.0.1", 0))
+        lt.assertIsBoolean(server:listen())
+        local _, port = server:info("socket")
+        s:event_add(server, select.SELECT_READ)
+        local function accept()
+            while true do
+                local fd = s:accept(server)
+                if fd then
+                    return fd
+                end
+                s:wait(1)
+            end
+        end
+        local function recv(fd, n)
+            local r = {}
+            while n > 0 do
+                local data = s:recv(fd)
+                if data == nil then
+                    break
+                elseif data then
+                    r[#r + 1] = data
+                    n = n - #data
+                else
+                    s:wait(1)
+                end
+            end
+            return table.concat(r)
+        end
+        local clients = {}
+        local sessions = {}
+        for i = 1, 3 do
+            clients[i] = lt.assertIsUserdata(socket "tcp")
+            lt.assertIsBoolean(clients[i]:connect("127.0.0.1", port))
+            sessions[i] = accept()
+            lt.assertEquals(tostring(sessions[i]):match "^socket", "socket")
+            s:event_add(sessions[i], select.SELECT_READ)
+        end
+        lt.assertEquals(syncSend(clients[1], "hello"), true)
+        lt.assertEquals(recv(sessions[1], 5), "hello")
+        lt.assertEquals(s:recv(sessions[1]), false)
+        lt.assertEquals(syncSend(clients[1], "world"), true)
+        lt.assertEquals(recv(sessions[1], 5), "world")
+        local big = ("0123456789abcdef"):rep(1 << 14)
+        lt.assertEquals(s:send(sessions[2], "a"), 1)
+        lt.assertEquals(s:send(sessions[2], "b"), 1)
+        local n = s:send(sessions[2], big)
+        local got = {}
+        local total = 0
+        while total < 2 + #big do
+            if n and n < #big then
+                n = n + (s:send(sessions[2], big:sub(n + 1)) or 0)
+            end
+            s:wait(0)
+            local data = clients[2]:recv()
+            if data then
+                got[#got + 1] = data
+                total = total + #data
+            else
+                simple_select(clients[2], "r")
+            end
+        end
+        lt.assertEquals(table.concat(got), "ab"..big)
+        clients[3]:close()
+        lt.assertEquals(recv(sessions[3], 1), "")
+        lt.assertEquals(s:recv(sessions[3]), nil)
+        for i = 1, 3 do
+            s:event_del(sessions[i])
+            sessions[i]:close()
+        end
+        clients[1]:close()
+        clients[2]:close()
+        s:event_del(server)
+        server:close()
+    end
+end
+
+function test_socket:test_accept_many()
+    local server = lt.assertIsUserdata(socket "tcp")
+    lt.assertIsBoolean(server:bind("127.0.0.1", 0))
+    lt.assertIsBoolean(server:listen())
+    local _, port = server:info("socket")
+    local function connect(n)
+        local clients = {}
+        for i = 1, n do
+            clients[i] = lt.assertIsUserdata(socket "tcp")
+            lt.assertIsBoolean(clients[i]:connect("127.0.0.1", port))
+            simple_select(clients[i], "w")
+        end
+        simple_select(server, "r")
+        return clients
+    end
+    local function closeall(t)
+        for _, fd in ipairs(t) do
+            fd:close()
+        end
+    end
+    lt.assertEquals(server:accept_many(), {})
+    local clients = connect(3)
+    local sessions = server:accept_many(2, { nodelay = true })
+    lt.assertEquals(#sessions, 2)
+    local rest = server:accept_many()
+    lt.assertEquals(#rest, 1)
+    closeall(sessions)
+    closeall(rest)
+    closeall(clients)
+    clients = connect(2)
+    lt.assertEquals(server:accept_many(8, { allow = { "10.0.0.1" } }), {})
+    closeall(clients)
+    clients = connect(2)
+    sessions = server:accept_many(8, { allow = { "127.0.0.1" } })
+    lt.assertEquals(#sessions, 2)
+    closeall(sessions)
+    closeall(clients)
+    server:close()
+end
+
+function test_socket:test_stats()
+    local platform = require "bee.platform"
+    local server = lt.assertIsUserdata(socket "tcp")
+    lt.assertIsBoolean(server:bind("127.0.0.1", 0))
+    lt.assertIsBoolean(server:listen())
+    local _, port = server:info("socket")
+    local client = lt.assertIsUserdata(socket "tcp")
+    lt.assertIsBoolean(client:connect("127.0.0.1", port))
+    simple_select(server, "r")
+    local session = lt.assertIsUserdata(server:accept())
+    simple_select(client, "w")
+    local stats = client:stats()
+    lt.assertEquals(stats.bytes_sent, 0)
+    lt.assertEquals(stats.send_calls, 0)
+    lt.assertEquals(syncSend(client, "hello"), true)
+    simple_select(session, "r")
+    if platform.os == "linux" then
+        lt.assertEquals(session:stats().inq, 5)
+        lt.assertIsNumber(client:stats().rtt)
+        lt.assertIsNumber(client:stats().cwnd)
+    end
+    lt.assertEquals(syncRecv(session, 5), "hello")
+    stats = client:stats()
+    lt.assertEquals(stats.bytes_sent, 5)
+    lt.assertEquals(stats.bytes_recv, 0)
+    stats = session:stats()
+    lt.assertEquals(stats.bytes_recv, 5)
+    lt.assertEquals(stats.bytes_sent, 0)
+    lt.assertEquals(stats.recv_calls >= 1, true)
+    session:close()
+    client:close()
+    server:close()
+end
@@ -0,0 +1,61 @@
+local lt = require "ltest"
+local stats = require "bee.stats"
+local thread = require "bee.thread"
+
+local test_stats = lt.test "stats"
+
+function test_stats:test_instrument()
+    local enabled = stats.enabled()
+    stats.enable(true)
+    stats.reset()
+    thread.newchannel "testStats"
+    local thd = thread.thread [[
+        local thread = require "bee.thread"
+        local time = require "bee.time"
+        for _ = 1, 10 do
+            time.time()
+        end
+        assert(time.counter() > 0)
+        local fs = require "bee.filesystem"
+        pcall(fs.status, 1)
+        local ok, err = pcall(function () return fs.status(1) end)
+        local _, tb = xpcall(function () return fs.status(1) end, debug.traceback)
+        assert(fs.filelock "bee_stats_missing/dir/lock" == nil)
+        thread.channel "testStats":push(ok, err, tb)
+        local socket = require "bee.socket"
+        local a, b = socket.pair()
+        a:send "x"
+        a:close()
+        b:close()
+    ]]
+    thread.wait(thd)
+    stats.enable(enabled)
+    local _, ok, err, tb = thread.channel "testStats":pop()
+    lt.assertEquals(ok, false)
+    lt.assertEquals(err:match ":%d+: bad argument #1 to 'status'" ~= nil, true)
+    lt.assertEquals(tb:find("[C]: in function 'bee.filesystem.status'\n", 1, true) ~= nil, true)
+    lt.assertEquals(tb:match "\n[^\n]+:%d+: in function <" ~= nil, true)
+    thread.reset()
+    local s = stats()
+    lt.assertEquals(s["time.time"].calls, 10)
+    lt.assertEquals(s["time.time"].errors, 0)
+    lt.assertEquals(s["time.time"].active, 0)
+    lt.assertEquals(#s["time.time"].histogram, 24)
+    local n = 0
+    for _, v in ipairs(s["time.time"].histogram) do
+        n = n + v
+    end
+    lt.assertEquals(n, 10)
+    lt.assertEquals(s["time.time"].max_ns <= s["time.time"].total_ns, true)
+    lt.assertEquals(s["time.counter"].calls, 1)
+    lt.assertEquals(s["filesystem.status"].calls, 3)
+    lt.assertEquals(s["filesystem.status"].errors, 3)
+    lt.assertEquals(s["filesystem.status"].active, 0)
+    lt.assertEquals(s["filesystem.filelock"].calls, 1)
+    lt.assertEquals(s["filesystem.filelock"].errors, 1)
+    lt.assertEquals(s["socket.pair"].calls, 1)
+    lt.assertEquals(s["net::fd.send"].calls, 1)
+    lt.assertEquals(s["net::fd.close"].calls, 2)
+    stats.reset()
+    lt.assertEquals(stats()["time.time"], nil)
+end
@@ -0,0 +1,89 @@
+local lt = require "ltest"
+local struct = require "bee.struct"
+local seri = require "bee.serialization"
+
+local test_struct = lt.test "struct"
+
+local function pack(...)
+    return { n = select("#", ...), ... }
+end
+
+function test_struct:test_compat()
+    local cases = {
+        { "<i4", -5 },
+        { ">I2 b B", 65535, -128, 255 },
+        { "<h H l L j J T", -1, 2, -3, 4, math.mininteger, -1, 7 },
+        { ">d f n", 1.5, 0.25, -2.75 },
+        { "<s1 s2 z", "abc", "", "zero" },
+        { "c5 c3", "hello", "ab\0" },
+        { "!4 b i4 b h", 1, 2, 3, 4 },
+        { "!8 >b d Xi8 b", 1, 2.5, 3 },
+        { "<i3 >I3 i16 x", -100000, 100000, -7 },
+    }
+    for _, case in ipairs(cases) do
+        local fmt = case[1]
+        local args = table.pack(table.unpack(case, 2))
+        local codec = struct.compile(fmt)
+        local bin = codec:encode(table.unpack(args, 1, args.n))
+        lt.assertEquals(bin, string.pack(fmt, table.unpack(args, 1, args.n)))
+        lt.assertEquals(pack(codec:decode(bin)), pack(string.unpack(fmt, bin)))
+        if not fmt:find "[sz]" then
+            lt.assertEquals(codec:size(), string.packsize(fmt))
+        else
+            lt.assertEquals(codec:size(), nil)
+        end
+    end
+end
+
+function test_struct:test_position()
+    local codec = struct.compile "<I2"
+    local bin = "xx" .. string.pack("<I2I2", 1, 2)
+    lt.assertEquals(pack(codec:decode(bin, 3)), pack(1, 5))
+    lt.assertEquals(pack(codec:decode(bin, 5)), pack(2, 7))
+    lt.assertEquals(pack(codec:decode(bin, -2)), pack(2, 7))
+    lt.assertError(codec.decode, codec, bin, 6)
+    lt.assertError(codec.decode, codec, bin, 8)
+    lt.assertError(struct.compile "z".decode, struct.compile "z", "abc")
+end
+
+function test_struct:test_decode_into()
+    local codec = struct.compile("<I4 s1 d", { "id", "name", "value" })
+    local bin = codec:encode(42, "bee", 0.5)
+    local t = {}
+    lt.assertEquals(codec:decode_into(t, bin), #bin + 1)
+    lt.assertEquals(t, { id = 42, name = "bee", value = 0.5 })
+    local plain = struct.compile "<I4 s1 d"
+    local a = {}
+    lt.assertEquals(plain:decode_into(a, bin), #bin + 1)
+    lt.assertEquals(a, { 42, "bee", 0.5 })
+    lt.assertError(struct.compile, "<I4 s1 d", { "id" })
+    lt.assertError(struct.compile, "<I4", { 1 })
+end
+
+function test_struct:test_lightuserdata()
+    -- a packed buffer starts with its length as a native 4-byte integer
+    local str = seri.packstring("hello", 42)
+    local ptr = seri.pack("hello", 42)
+    local codec = struct.compile "=i4"
+    lt.assertEquals(pack(codec:decode(ptr, #str)), pack(codec:decode(str)))
+    lt.assertEquals(pack(codec:decode(ptr, 4)), pack(#str - 4, 5))
+    lt.assertError(codec.decode, codec, ptr, 3)
+    lt.assertError(codec.decode, codec, ptr)
+    local t = {}
+    lt.assertEquals(codec:decode_into(t, ptr, #str), 5)
+    lt.assertEquals(t, { #str - 4 })
+    lt.assertEquals(pack(seri.unpack(ptr)), pack("hello", 42))
+end
+
+function test_struct:test_errors()
+    lt.assertError(struct.compile, "i17")
+    lt.assertError(struct.compile, "c")
+    lt.assertError(struct.compile, "q")
+    lt.assertError(struct.compile, "!3 i4")
+    lt.assertError(struct.compile, "Xc1")
+    local codec = struct.compile "<b c2 z"
+    lt.assertError(codec.encode, codec, 128, "ab", "z")
+    lt.assertError(codec.encode, codec, 1, "abc", "z")
+    lt.assertError(codec.encode, codec, 1, "ab", "z\0z")
+    lt.assertError(codec.decode, codec, "\1a")
+end
@@ -385,3 +385,240 @@ function test_subprocess:test_select()
         end
     end
 end
+
+function test_subprocess:test_pipeline()
+    local procs, output, statuses = subprocess.pipeline {
+        shell:luacommand [[io.write "b\na\nc\n"]],
+        shell:luacommand [[
+            local t = {}
+            for l in io.lines() do t[#t+1] = l end
+            table.sort(t)
+            io.write(table.concat(t, "\n"), "\n")
+        ]],
+        shell:luacommand [[io.write((io.read "a"):upper())]],
+        capture = true,
+    }
+    lt.assertEquals(#procs, 3)
+    lt.assertEquals(output, "A\nB\nC\n")
+    lt.assertEquals(statuses, { 0, 0, 0 })
+
+    local procs = subprocess.pipeline {
+        shell:luacommand [[io.write((io.read "a"):upper())]],
+        shell:luacommand [[io.write((io.read "a"):reverse()); os.exit(3)]],
+        stdin = true,
+        stdout = true,
+    }
+    lt.assertIsUserdata(procs[1].stdin)
+    lt.assertIsUserdata(procs[2].stdout)
+    procs[1].stdin:write "abc"
+    procs[1].stdin:close()
+    lt.assertEquals(procs[2].stdout:read "a", "CBA")
+    safe_exit(procs[1])
+    safe_exit(procs[2], 3)
+
+    local ok, err = subprocess.pipeline {
+        shell:luacommand " ",
+        { "bee-pipeline-no-such-command" },
+    }
+    lt.assertEquals(ok, nil)
+    lt.assertIsString(err)
+end
+
+function test_subprocess:test_pipeline_capture_pipes()
+    local ok, err = pcall(subprocess.pipeline, {
+        shell:luacommand [[io.write(io.read "a")]],
+        stdin = true,
+        capture = true,
+    })
+    lt.assertEquals(ok, false)
+    lt.assertEquals(err:find("stdin = true", 1, true) ~= nil, true)
+    local stage = shell:luacommand [[io.stderr:write(("x"):rep(1 << 20)); io.write "ok"]]
+    stage.stderr = true
+    ok, err = pcall(subprocess.pipeline, {
+        shell:luacommand " ",
+        stage,
+        capture = true,
+    })
+    lt.assertEquals(ok, false)
+    lt.assertEquals(err:find("stderr = true", 1, true) ~= nil, true)
+    local file <close> = assert(io.open("temp_pipeline_stderr.txt", "wb"))
+    stage.stderr = file
+    local _, output, statuses = subprocess.pipeline {
+        stage,
+        capture = true,
+    }
+    lt.assertEquals(output, "ok")
+    lt.assertEquals(statuses, { 0 })
+    file:close()
+    lt.assertEquals(fs.file_size "temp_pipeline_stderr.txt", 1 << 20)
+    fs.remove "temp_pipeline_stderr.txt"
+end
+
+function test_subprocess:test_template()
+    local tpl = subprocess.template {
+        shell:luacommand([[io.write(os.getenv "BEE_TEMPLATE" or "nil", ":", table.concat(arg, ","))]], "_"),
+        env = { BEE_TEMPLATE = "ok" },
+    }
+    lt.assertIsUserdata(tpl)
+    for i = 1, 3 do
+        local process = tpl:spawn { "a", { "b", tostring(i) }, stdout = true }
+        lt.assertIsUserdata(process.stdout)
+        lt.assertEquals(process.stdout:read "a", "ok:a,b,"..i)
+        safe_exit(process)
+    end
+    local process = tpl:spawn { stdout = true }
+    lt.assertEquals(process.stdout:read "a", "ok:")
+    safe_exit(process)
+
+    -- the environment is captured when the template is created
+    lt.assertEquals(os.getenv "BEE_TEMPLATE_LATE", nil)
+    local tpl = subprocess.template {
+        shell:luacommand [[io.write(os.getenv "BEE_TEMPLATE_LATE" or "nil")]],
+    }
+    subprocess.setenv("BEE_TEMPLATE_LATE", "late")
+    local process = tpl:spawn { stdout = true }
+    lt.assertEquals(process.stdout:read "a", "nil")
+    safe_exit(process)
+
+    local ok, err = subprocess.template {
+        shell:luacommand " ",
+        cwd = "bee-template-no-such-directory",
+    }
+    lt.assertEquals(ok, nil)
+    lt.assertIsString(err)
+
+    if platform.os ~= "windows" then
+        local ok, err = subprocess.template { "bee-template-no-such-command" }
+        lt.assertEquals(ok, nil)
+        lt.assertIsString(err)
+    end
+end
+
+function test_subprocess:test_sample()
+    if platform.os ~= "linux" and platform.os ~= "windows" and platform.os ~= "macos" then
+        return
+    end
+    local process = shell:runlua('io.write "ok" io.stdout:flush() io.read "a"', { stdin = true, stdout = true })
+    lt.assertEquals(process.stdout:read(2), "ok")
+    local s = process:sample()
+    lt.assertIsTable(s)
+    lt.assertEquals(s.processes, 1)
+    lt.assertEquals(s.threads >= 1, true)
+    lt.assertEquals(s.rss > 0, true)
+    lt.assertIsNumber(s.cpu_user)
+    lt.assertIsNumber(s.cpu_system)
+    lt.assertIsNumber(s.read_bytes)
+    lt.assertIsNumber(s.write_bytes)
+
+    local tree = process:sample(true)
+    lt.assertEquals(tree.processes >= 1, true)
+
+    local r = subprocess.sample({ process, process:get_id() }, true)
+    lt.assertEquals(#r, 2)
+    lt.assertIsTable(r[1])
+    lt.assertEquals(r[1].processes, r[2].processes)
+
+    process.stdin:close()
+    safe_exit(process)
+end
+
+function test_subprocess:test_stdio_log()
+    local function readfile(path)
+        local f <close> = assert(io.open(path, "rb"))
+        return f:read "a"
+    end
+    for _, name in ipairs { "temp.log", "temp.log.1", "temp.log.2" } do
+        fs.remove(name)
+    end
+    local process = shell:runlua([[
+        for i = 1, 50 do
+            io.write(("%04d\n"):format(i))
+            io.stdout:flush()
+        end
+        io.stderr:write "fail\n"
+    ]], { stdout = { file = "temp.log", rotate_bytes = 60, keep_tail = 13, rotate_files = 2 }, stderr = "stdout" })
+    local out = process.stdout
+    lt.assertIsUserdata(out)
+    safe_exit(process)
+    lt.assertEquals(out:wait(), true)
+    lt.assertEquals(out:bytes(), 50 * 5 + 5)
+    local expected = {}
+    for i = 1, 50 do
+        expected[#expected+1] = ("%04d\n"):format(i)
+    end
+    expected[#expected+1] = "fail\n"
+    expected = table.concat(expected)
+    lt.assertEquals(out:tail(), expected:sub(-13))
+    lt.assertEquals(out:rotations() >= 2, true)
+    local current = readfile "temp.log"
+    local kept = readfile "temp.log.2" .. readfile "temp.log.1" .. current
+    lt.assertEquals(#current <= 60, true)
+    lt.assertEquals(expected:sub(-#kept), kept)
+    for _, name in ipairs { "temp.log", "temp.log.1", "temp.log.2" } do
+        fs.remove(name)
+    end
+
+    local process = shell:runlua([[io.write "ok"]], { stdout = { file = "temp.log", keep_tail = 100 } })
+    local out = process.stdout
+    safe_exit(process)
+    lt.assertEquals(out:wait(), true)
+    lt.assertEquals(out:tail(), "ok")
+    lt.assertEquals(out:rotations(), 0)
+    lt.assertEquals(readfile "temp.log", "ok")
+    fs.remove "temp.log"
+end
+
+function test_subprocess:test_startup_trace()
+    local f <close> = assert(io.open("trace_mod.lua", "wb"))
+    f:write "return 42"
+    f:close()
+    local script = [[assert(require "trace_mod" == 42) require "bee.filesystem"]]
+
+    local process = shell:runlua(script, { stderr = true, env = { BEE_STARTUP_TRACE = "1" } })
+    local report = process.stderr:read "a"
+    safe_exit(process)
+    lt.assertEquals(report:match "^startup trace: [%d.]+ ms, %d+ events\n" ~= nil, true)
+    local events = {
+        "luaL_newstate", "pmain", "luaL_openlibs", "run main.lua",
+        "require trace_mod", "lookup trace_mod", "read trace_mod", "parse trace_mod", "execute trace_mod",
+        "require bee.filesystem",
+    }
+    for _, event in ipairs(events) do
+        lt.assertEquals(report:match("\n +[%d.]+ +[%d.]+  "..event:gsub("%.", "%%.").."\n") ~= nil, true)
+    end
+    lt.assertEquals(report:match "\nmodule loads: lookup [%d.]+ ms, read [%d.]+ ms, parse [%d.]+ ms, execute [%d.]+ ms\n$" ~= nil, true)
+
+    local tracefile = fs.absolute "trace.json":string()
+    fs.remove(tracefile)
+    local process = shell:runlua(script, { stderr = true, env = { BEE_STARTUP_TRACE = tracefile } })
+    lt.assertEquals(process.stderr:read "a", "")
+    safe_exit(process)
+    local json; do
+        local f <close> = assert(io.open(tracefile, "rb"))
+        json = f:read "a"
+    end
+    lt.assertEquals(json:match '^{"traceEvents":%[\n' ~= nil, true)
+    lt.assertEquals(json:match '\n%],"displayTimeUnit":"ms"}\n$' ~= nil, true)
+    local names = {}
+    for line in json:gmatch "\n({[^\n]*})" do
+        local name, cat = line:match '^{"name":"([^"]*)","cat":"(%a+)","ph":"X","ts":[%d.]+,"dur":[%d.]+,"pid":1,"tid":1}$'
+        lt.assertIsString(name, line)
+        names[name] = cat
+    end
+    lt.assertEquals(names["pmain"], "bootstrap")
+    lt.assertEquals(names["parse trace_mod"], "parse")
+    lt.assertEquals(names["require bee.filesystem"], "require")
+    fs.remove(tracefile)
+    fs.remove "trace_mod.lua"
+
+    local f <close> = assert(io.open("trace_err.lua", "wb"))
+    f:write "local function boom() error 'boom' end\nboom()\n"
+    f:close()
+    local process = shell:runlua([[require "trace_err"]], { stderr = true, env = { BEE_STARTUP_TRACE = "1" } })
+    local report = process.stderr:read "a"
+    safe_exit(process, 1)
+    lt.assertEquals(report:match "trace_err%.lua:1: boom\n" ~= nil, true)
+    lt.assertEquals(report:match "\n%s*[^\n]*trace_err%.lua:1: in [^\n]*'boom'\n" ~= nil, true)
+    lt.assertEquals(report:match "\n +[%d.]+ +[%d.]+  execute trace_err\n" ~= nil, true)
+    fs.remove "trace_err.lua"
+end
@@ -0,0 +1,46 @@
+local lt = require "ltest"
+
+local test_table = lt.test "table"
+
+function test_table:test_table_new()
+    local t = table.new(100, 8)
+    lt.assertEquals(next(t), nil)
+    lt.assertEquals(#t, 0)
+    for i = 1, 100 do
+        t[i] = i
+    end
+    t.a = 1
+    lt.assertEquals(#t, 100)
+    lt.assertEquals(t.a, 1)
+    lt.assertEquals(next(table.new(0)), nil)
+    lt.assertError(table.new, -1)
+    lt.assertError(table.new, 0, -1)
+    lt.assertError(table.new)
+end
+
+function test_table:test_table_clear()
+    local t = { 1, 2, 3, a = 1, b = 2 }
+    table.clear(t)
+    lt.assertEquals(next(t), nil)
+    lt.assertEquals(#t, 0)
+    for _ = 1, 3 do
+        for i = 1, 64 do
+            t[i] = i
+            t["k"..i] = i
+        end
+        lt.assertEquals(#t, 64)
+        lt.assertEquals(t.k64, 64)
+        table.clear(t)
+        lt.assertEquals(next(t), nil)
+        lt.assertEquals(#t, 0)
+        lt.assertEquals(t.k1, nil)
+    end
+    local mt = { __index = function () return "mt" end }
+    local obj = setmetatable({}, mt)
+    lt.assertEquals(obj.x, "mt")
+    table.clear(mt)
+    lt.assertEquals(obj.x, nil)
+    mt.__index = { x = "again" }
+    lt.assertEquals(obj.x, "again")
+    lt.assertError(table.clear, 1)
+end
@@ -95,6 +95,16 @@ function test_thread:test_channel_2()
     thread.reset()
 end
 
+function test_thread:test_channel_spinlock()
+    thread.reset()
+    thread.newchannel("test", "spinlock")
+    local c = thread.channel "test"
+    c:push(1, "a")
+    lt.assertEquals({ c:pop() }, { true, 1, "a" })
+    lt.assertError(thread.newchannel, "test2", "mutex")
+    thread.reset()
+end
+
 function test_thread:test_id_1()
     assertNotThreadError()
     lt.assertEquals(thread.id, 0)
@@ -292,6 +302,101 @@ function test_thread:test_thread_pop()
     assertNotThreadError()
 end
 
+function test_thread:test_channel_contention()
+    assertNotThreadError()
+    thread.reset()
+    thread.newchannel "testContention"
+    local N <const> = 8
+    local M <const> = 1000
+    local thds = {}
+    for i = 1, N do
+        thds[i] = createThread([[
+            local id, n = ...
+            local thread = require "bee.thread"
+            local c = thread.channel "testContention"
+            for j = 1, n do
+                c:push(id, j)
+            end
+        ]], i, M)
+    end
+    local c = thread.channel "testContention"
+    local last = {}
+    for i = 1, N do
+        last[i] = 0
+    end
+    for _ = 1, N * M do
+        local id, j = c:bpop()
+        lt.assertEquals(j, last[id] + 1)
+        last[id] = j
+    end
+    for i = 1, N do
+        thread.wait(thds[i])
+    end
+    lt.assertEquals(c:pop(), false)
+    assertNotThreadError()
+    thread.reset()
+end
+
+function test_thread:test_lockstats()
+    assertNotThreadError()
+    thread.reset()
+    thread.newchannel "testLockstats"
+    thread.lockstats(true)
+    local thd = createThread [[
+        local thread = require "bee.thread"
+        thread.sleep(0.05)
+        thread.channel "testLockstats":push "ok"
+    ]]
+    local c = thread.channel "testLockstats"
+    lt.assertEquals(c:bpop(), "ok")
+    thread.wait(thd)
+    thread.lockstats(false)
+    local stats = thread.lockstats()
+    lt.assertEquals(stats.enabled, false)
+    lt.assertIsTable(stats.channelmgr)
+    lt.assertIsTable(stats.rpc)
+    local s = stats.channels.testLockstats
+    lt.assertEquals(s.waits, 1)
+    lt.assertEquals(s.wait_ns > 0, true)
+    lt.assertEquals(s.acquires >= 2, true)
+    local n = 0
+    for where, count in pairs(s.callers) do
+        lt.assertEquals(where:match "test_thread%.lua:%d+:" ~= nil, true)
+        n = n + count
+    end
+    lt.assertEquals(n, 1)
+    lt.assertEquals(c:pop(), false)
+    lt.assertEquals(thread.lockstats().channels.testLockstats.acquires, s.acquires)
+    assertNotThreadError()
+    thread.reset()
+end
+
+function test_thread:test_lockstats_rpc()
+    assertNotThreadError()
+    thread.reset()
+    thread.newchannel "testLockstats"
+    local before = thread.lockstats().rpc
+    thread.lockstats(true)
+    local thd = createThread [[
+        local thread = require "bee.thread"
+        local r = thread.channel "testLockstats":bpop()
+        thread.sleep(0.05)
+        thread.rpc_return(r, "ok")
+    ]]
+    local r, _ = thread.rpc_create()
+    thread.channel "testLockstats":push(r)
+    lt.assertEquals(thread.rpc_wait(r), "ok")
+    thread.wait(thd)
+    thread.lockstats(false)
+    local s = thread.lockstats().rpc
+    lt.assertEquals(s.acquires - before.acquires, 1)
+    lt.assertEquals(s.contended - before.contended, 1)
+    lt.assertEquals(s.parks > before.parks, true)
+    lt.assertEquals(s.lock_wait_ns > before.lock_wait_ns, true)
+    assertNotThreadError()
+    thread.reset()
+end
+
 function test_thread:test_rpc()
     thread.reset()
     thread.newchannel "test"